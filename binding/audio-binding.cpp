@@ -155,6 +155,29 @@ RB_METHOD(audio_bgmFade)
 DEF_FADE( bgs )
 DEF_FADE( me )
 
+#define DEF_PREFETCH(entity) \
+RB_METHOD(audio_##entity##Prefetch) \
+{ \
+    RB_UNUSED_PARAM; \
+    const char *filename; \
+    rb_get_args(argc, argv, "z", &filename RB_ARG_END); \
+    GUARD_EXC( shState->audio().entity##Prefetch(filename); ) \
+    return Qnil; \
+}
+
+RB_METHOD(audio_bgmPrefetch)
+{
+    RB_UNUSED_PARAM;
+    const char *filename;
+    VALUE track = Qnil;
+    rb_get_args(argc, argv, "z|o", &filename, &track RB_ARG_END);
+    GUARD_EXC( shState->audio().bgmPrefetch(filename, MAYBE_NIL_TRACK(track)); )
+    return Qnil;
+}
+
+DEF_PREFETCH( bgs )
+DEF_PREFETCH( me )
+
 DEF_PLAY_STOP( se )
 
 RB_METHOD(audio_sePlayPan)
@@ -187,6 +210,33 @@ RB_METHOD(audioSetupMidi)
 	return Qnil;
 }
 
+RB_METHOD(audioStreamStats)
+{
+	RB_UNUSED_PARAM;
+
+	std::vector<AudioStreamStats> stats;
+	shState->audio().streamStats(stats);
+
+	VALUE ret = rb_hash_new();
+
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		const AudioStreamStats &st = stats[i];
+		VALUE entry = rb_hash_new();
+
+		rb_hash_aset(entry, ID2SYM(rb_intern("underruns")), UINT2NUM(st.underruns));
+		rb_hash_aset(entry, ID2SYM(rb_intern("buffers")), UINT2NUM(st.bufferCount));
+		rb_hash_aset(entry, ID2SYM(rb_intern("fill_ms")), UINT2NUM(st.fillMs));
+		rb_hash_aset(entry, ID2SYM(rb_intern("decoded_buffers")), ULL2NUM(st.decodedBuffers));
+		rb_hash_aset(entry, ID2SYM(rb_intern("decode_avg_us")), UINT2NUM(st.decodeAvgUs));
+		rb_hash_aset(entry, ID2SYM(rb_intern("decode_max_us")), UINT2NUM(st.decodeMaxUs));
+
+		rb_hash_aset(ret, rb_str_new_cstr(st.name.c_str()), entry);
+	}
+
+	return ret;
+}
+
 RB_METHOD(audioReset)
 {
 	RB_UNUSED_PARAM;
@@ -211,6 +261,9 @@ RB_METHOD(audioReset)
 #define BIND_POS(entity) \
 	_rb_define_module_function(module, #entity "_pos", audio_##entity##Pos);
 
+#define BIND_PREFETCH(entity) \
+	_rb_define_module_function(module, #entity "_prefetch", audio_##entity##Prefetch);
+
 
 void
 audioBindingInit()
@@ -226,6 +279,10 @@ audioBindingInit()
 	BIND_POS( bgm );
 	BIND_POS( bgs );
 
+	BIND_PREFETCH( bgm );
+	BIND_PREFETCH( bgs );
+	BIND_PREFETCH( me  );
+
 	_rb_define_module_function(module, "setup_midi", audioSetupMidi);
 
 	BIND_PLAY_STOP( se )
@@ -233,5 +290,7 @@ audioBindingInit()
 
 	_rb_define_module_function(module, "se_change_pan_all", audio_seChangePanAll);
 
+	_rb_define_module_function(module, "stream_stats", audioStreamStats);
+
 	_rb_define_module_function(module, "__reset__", audioReset);
 }
@@ -36,6 +36,7 @@
 
 #include "binding-util.h"
 #include "binding.h"
+#include "profiler.h"
 
 #include "sharedstate.h"
 #include "eventthread.h"
@@ -83,6 +84,7 @@ void bitmapBindingInit();
 void spriteBindingInit();
 void viewportBindingInit();
 void planeBindingInit();
+void particleEmitterBindingInit();
 void windowBindingInit();
 void tilemapBindingInit();
 void windowVXBindingInit();
@@ -91,6 +93,7 @@ void tilemapVXBindingInit();
 void inputBindingInit();
 void audioBindingInit();
 void graphicsBindingInit();
+void tweenBindingInit();
 
 void fileIntBindingInit();
 
@@ -136,6 +139,10 @@ RB_METHOD(mkxpRemovePath);
 RB_METHOD(mkxpFileExists);
 RB_METHOD(mkxpLaunch);
 
+RB_METHOD(mkxpProfileStart);
+RB_METHOD(mkxpProfileStop);
+RB_METHOD(mkxpIsProfiling);
+
 RB_METHOD(mkxpGetJSONSetting);
 RB_METHOD(mkxpSetJSONSetting);
 RB_METHOD(mkxpGetAllJSONSettings);
@@ -153,13 +160,22 @@ VALUE json2rb(json5pp::value const &v);
 json5pp::value rb2json(VALUE v);
 
 static void mriBindingInit() {
+#if RAPI_FULL >= 300
+    /* Table, Color, Tone and Rect touch no shared state,
+     * so game logic running in other Ractors may use them */
+    rb_ext_ractor_safe(true);
+#endif
     tableBindingInit();
     etcBindingInit();
+#if RAPI_FULL >= 300
+    rb_ext_ractor_safe(false);
+#endif
     fontBindingInit();
     bitmapBindingInit();
     spriteBindingInit();
     viewportBindingInit();
     planeBindingInit();
+    particleEmitterBindingInit();
     
     if (rgssVer == 1) {
         windowBindingInit();
@@ -172,6 +188,7 @@ static void mriBindingInit() {
     inputBindingInit();
     audioBindingInit();
     graphicsBindingInit();
+    tweenBindingInit();
     
     fileIntBindingInit();
     
@@ -247,6 +264,10 @@ static void mriBindingInit() {
     _rb_define_module_function(mod, "file_exist?", mkxpFileExists);
     _rb_define_module_function(mod, "launch", mkxpLaunch);
     
+    _rb_define_module_function(mod, "profile_start", mkxpProfileStart);
+    _rb_define_module_function(mod, "profile_stop", mkxpProfileStop);
+    _rb_define_module_function(mod, "profiling?", mkxpIsProfiling);
+    
     _rb_define_module_function(mod, "default_font_family=", mkxpSetDefaultFontFamily);
     
     _rb_define_method(rb_cString, "to_utf8", mkxpStringToUTF8);
@@ -680,6 +701,35 @@ RB_METHOD(mkxpLaunch) {
     return RUBY_Qnil;
 }
 
+RB_METHOD(mkxpProfileStart) {
+    RB_UNUSED_PARAM;
+    
+    int interval = shState->config().profiler.interval;
+    rb_get_args(argc, argv, "|i", &interval RB_ARG_END);
+    
+    if (!ScriptProfiler::isSupported())
+        rb_raise(rb_eNotImpError, "Script profiling is not supported by this build");
+    
+    return rb_bool_new(ScriptProfiler::start(interval));
+}
+
+RB_METHOD(mkxpProfileStop) {
+    RB_UNUSED_PARAM;
+    
+    std::string path = ScriptProfiler::stop();
+    
+    if (path.empty())
+        return Qnil;
+    
+    return rb_utf8_str_new_cstr(path.c_str());
+}
+
+RB_METHOD(mkxpIsProfiling) {
+    RB_UNUSED_PARAM;
+    
+    return rb_bool_new(ScriptProfiler::isRunning());
+}
+
 json5pp::value loadUserSettings() {
     json5pp::value ret;
     VALUE cpath = rb_utf8_str_new_cstr(shState->config().userConfPath.c_str());
@@ -756,7 +806,15 @@ static VALUE rgssMainRescue(VALUE arg, VALUE exc) {
     return Qnil;
 }
 
+void bitmapResetBackgroundLoads();
+void tweenResetAll();
+void httpResetAsync();
+
 static void processReset() {
+    getRbData()->clearKlassCache();
+    bitmapResetBackgroundLoads();
+    tweenResetAll();
+    httpResetAsync();
     shState->graphics().reset();
     shState->audio().reset();
     
@@ -1217,9 +1275,13 @@ static void mriBindingExecute() {
     RbData rbData;
     shState->setBindingData(&rbData);
     BacktraceData btData;
+    ScriptProfiler::setScriptNames(&btData.scriptNames);
     
     mriBindingInit();
     
+    if (conf.profiler.enabled && !ScriptProfiler::start(conf.profiler.interval))
+        Debug() << "Script profiling is not supported by this build";
+    
     std::string &customScript = conf.customScript;
     if (!customScript.empty())
         runCustomScript(customScript);
@@ -1234,6 +1296,13 @@ static void mriBindingExecute() {
     if (!NIL_P(exc) && !rb_obj_is_kind_of(exc, rb_eSystemExit))
         showExc(exc, btData);
     
+    if (ScriptProfiler::isRunning()) {
+        std::string profilePath = ScriptProfiler::stop();
+        
+        if (!profilePath.empty())
+            Debug() << "Script profile written to" << profilePath;
+    }
+    
     ruby_cleanup(0);
     
     shState->rtData().rqTermAck.set();
@@ -50,10 +50,33 @@ RbData::RbData() {
   exc[IOError] = rb_eIOError;
   exc[TypeError] = rb_eTypeError;
   exc[ArgumentError] = rb_eArgError;
+
+  klassCacheAnchor = rb_ary_new();
+  rb_iv_set(rb_cObject, "mkxp_klass_cache", klassCacheAnchor);
 }
 
 RbData::~RbData() {}
 
+VALUE RbData::wrapKlass(const void *key, const char *name) {
+  std::unordered_map<const void *, VALUE>::const_iterator iter =
+      klassCache.find(key);
+
+  if (iter != klassCache.end())
+    return iter->second;
+
+  VALUE klass = rb_const_get(rb_cObject, rb_intern(name));
+
+  rb_ary_push(klassCacheAnchor, klass);
+  klassCache[key] = klass;
+
+  return klass;
+}
+
+void RbData::clearKlassCache() {
+  klassCache.clear();
+  rb_ary_clear(klassCacheAnchor);
+}
+
 /* Indexed with Exception::Type */
 static const RbException excToRbExc[] = {
     RGSS,        /* RGSSError   */
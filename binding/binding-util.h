@@ -31,6 +31,8 @@
 
 #include "exception.h"
 
+#include <unordered_map>
+
 #ifdef RUBY_API_VERSION_MAJOR
 #define RAPI_MAJOR RUBY_API_VERSION_MAJOR
 #define RAPI_MINOR RUBY_API_VERSION_MINOR
@@ -65,6 +67,16 @@ struct RbData {
     /* Input module (RGSS3) */
     VALUE buttoncodeHash;
     
+    /* Toplevel classes of wrapped types, keyed by their
+     * rb_data_type_t (or name on 1.8). Resolved on first use,
+     * kept reachable through 'klassCacheAnchor' and dropped
+     * on reset in case scripts redefined any of them */
+    std::unordered_map<const void *, VALUE> klassCache;
+    VALUE klassCacheAnchor;
+    
+    VALUE wrapKlass(const void *key, const char *name);
+    void clearKlassCache();
+    
     RbData();
     ~RbData();
 };
@@ -75,6 +87,11 @@ struct Exception;
 
 void raiseRbExc(const Exception &exc);
 
+/* Interns the literal 'name' only once per use site, as
+ * rb_intern() hashes the whole string on every call */
+#define RB_CACHED_ID(name)                                                     \
+([]() -> ID { static const ID id = rb_intern(name); return id; }())
+
 #if RAPI_FULL > 187
 #define DECL_TYPE(Klass) extern rb_data_type_t Klass##Type
 
@@ -85,18 +102,29 @@ void raiseRbExc(const Exception &exc);
 #else
 #define DEF_TYPE_FLAGS
 #endif
+
+/* Frozen instances of plain value types hold
+ * nothing but their data, so Ractors can share them */
+#if RAPI_FULL >= 300
+#define DEF_VALUE_TYPE_FLAGS RUBY_TYPED_FROZEN_SHAREABLE
+#else
+#define DEF_VALUE_TYPE_FLAGS DEF_TYPE_FLAGS
+#endif
 #endif
 
 #if RAPI_MAJOR > 1 || RAPI_MINOR <= 9
 #if RAPI_FULL < 270
-#define DEF_TYPE_CUSTOMNAME_AND_FREE(Klass, Name, Free)                        \
+#define DEF_TYPE_CUSTOMNAME_FREE_AND_FLAGS(Klass, Name, Free, Flags)           \
 rb_data_type_t Klass##Type = {                                               \
-Name, {0, Free, 0, {0, 0}}, 0, 0, DEF_TYPE_FLAGS}
+Name, {0, Free, 0, {0, 0}}, 0, 0, Flags}
 #else
-#define DEF_TYPE_CUSTOMNAME_AND_FREE(Klass, Name, Free)                        \
-rb_data_type_t Klass##Type = {Name, {0, Free, 0, 0, 0}, 0, 0, DEF_TYPE_FLAGS}
+#define DEF_TYPE_CUSTOMNAME_FREE_AND_FLAGS(Klass, Name, Free, Flags)           \
+rb_data_type_t Klass##Type = {Name, {0, Free, 0, 0, 0}, 0, 0, Flags}
 #endif
 
+#define DEF_TYPE_CUSTOMNAME_AND_FREE(Klass, Name, Free)                        \
+DEF_TYPE_CUSTOMNAME_FREE_AND_FLAGS(Klass, Name, Free, DEF_TYPE_FLAGS)
+
 #define DEF_TYPE_CUSTOMFREE(Klass, Free)                                       \
 DEF_TYPE_CUSTOMNAME_AND_FREE(Klass, #Klass, Free)
 
@@ -104,6 +132,10 @@ DEF_TYPE_CUSTOMNAME_AND_FREE(Klass, #Klass, Free)
 DEF_TYPE_CUSTOMNAME_AND_FREE(Klass, Name, freeInstance<Klass>)
 
 #define DEF_TYPE(Klass) DEF_TYPE_CUSTOMNAME(Klass, #Klass)
+
+#define DEF_VALUE_TYPE(Klass)                                                  \
+DEF_TYPE_CUSTOMNAME_FREE_AND_FLAGS(Klass, #Klass, freeInstance<Klass>,       \
+                                   DEF_VALUE_TYPE_FLAGS)
 #endif
 
 // Ruby 1.8 helper stuff
@@ -161,6 +193,14 @@ BUILTIN_TYPE(obj) == (type)))
 
 #define OBJ_INIT_COPY(a, b) rb_obj_init_copy(a, b)
 
+#ifndef rb_check_frozen
+#define rb_check_frozen(obj)                                                   \
+do {                                                                         \
+if (OBJ_FROZEN(obj))                                                       \
+rb_error_frozen(rb_obj_classname(obj));                                  \
+} while (0)
+#endif
+
 #define DEF_ALLOCFUNC_CUSTOMFREE(type, free)                                   \
 static VALUE type##Allocate(VALUE klass) {                                   \
 return Data_Wrap_Struct(klass, 0, free, 0);                                \
@@ -218,7 +258,7 @@ getPrivateDataCheck(VALUE self, const char *type)
 {
 #if RAPI_FULL <= 187
     rb_check_type(self, T_DATA);
-    VALUE otherObj = rb_const_get(rb_cObject, rb_intern(type));
+    VALUE otherObj = getRbData()->wrapKlass(type, type);
     const char *ownname, *othername;
     if (!rb_obj_is_kind_of(self, otherObj)) {
         ownname = rb_obj_classname(self);
@@ -227,10 +267,9 @@ getPrivateDataCheck(VALUE self, const char *type)
     }
     void *obj = DATA_PTR(self);
 #else
-    const char *ownname = rb_obj_classname(self);
     if (!rb_typeddata_is_kind_of(self, &type))
-        rb_raise(rb_eTypeError, "Can't convert %s into %s", ownname,
-                 type.wrap_struct_name);
+        rb_raise(rb_eTypeError, "Can't convert %s into %s",
+                 rb_obj_classname(self), type.wrap_struct_name);
     
     void *obj = RTYPEDDATA_DATA(self);
 #endif
@@ -252,10 +291,18 @@ wrapObject(void *p, const rb_data_type_t &type, VALUE underKlass = rb_cObject)
 wrapObject(void *p, const char *type, VALUE underKlass = rb_cObject)
 #endif
 {
+    VALUE klass;
+    
 #if RAPI_FULL > 187
-    VALUE klass = rb_const_get(underKlass, rb_intern(type.wrap_struct_name));
+    if (underKlass == rb_cObject)
+        klass = getRbData()->wrapKlass(&type, type.wrap_struct_name);
+    else
+        klass = rb_const_get(underKlass, rb_intern(type.wrap_struct_name));
 #else
-    VALUE klass = rb_const_get(underKlass, rb_intern(type));
+    if (underKlass == rb_cObject)
+        klass = getRbData()->wrapKlass(type, type);
+    else
+        klass = rb_const_get(underKlass, rb_intern(type));
 #endif
     VALUE obj = rb_obj_alloc(klass);
     
@@ -327,6 +374,19 @@ raiseRbExc(exc);                                                         \
 GFX_UNLOCK;\
 }
 
+/* For setters that only touch CPU side state */
+#define GFX_STATE_GUARD_EXC(exp)                                               \
+{\
+GFX_STATE_LOCK; \
+try {\
+exp                                                                      \
+} catch (const Exception &exc) {\
+GFX_STATE_UNLOCK; \
+raiseRbExc(exc);                                                         \
+}\
+GFX_STATE_UNLOCK;\
+}
+
 
 template <class C>
 static inline VALUE objectLoad(int argc, VALUE *argv, VALUE self) {
@@ -400,6 +460,105 @@ inline void rb_check_argc(int actual, int expected) {
                  expected);
 }
 
+/* Per type argument conversions for 'rb_get_typed_args',
+ * with the common immediate cases checked first */
+template<typename T>
+struct RbArg;
+
+template<>
+struct RbArg<int> {
+    static inline void get(VALUE arg, int *out, int argPos) {
+        if (FIXNUM_P(arg))
+            *out = FIX2INT(arg);
+        else
+            rb_int_arg(arg, out, argPos);
+    }
+};
+
+template<>
+struct RbArg<double> {
+    static inline void get(VALUE arg, double *out, int argPos) {
+        if (FIXNUM_P(arg))
+            *out = FIX2INT(arg);
+        else
+            rb_float_arg(arg, out, argPos);
+    }
+};
+
+template<>
+struct RbArg<bool> {
+    static inline void get(VALUE arg, bool *out, int argPos) {
+        if (arg == Qtrue)
+            *out = true;
+        else if (arg == Qfalse || arg == Qnil)
+            *out = false;
+        else
+            rb_bool_arg(arg, out, argPos);
+    }
+};
+
+/* 'o' */
+template<>
+struct RbArg<VALUE> {
+    static inline void get(VALUE arg, VALUE *out, int) {
+        *out = arg;
+    }
+};
+
+/* 'z' */
+template<>
+struct RbArg<char *> {
+    static inline void get(VALUE arg, char **out, int argPos) {
+        if (!RB_TYPE_P(arg, RUBY_T_STRING))
+            rb_raise(rb_eTypeError, "Argument %d: Expected string", argPos);
+        
+        *out = RSTRING_PTR(arg);
+    }
+};
+
+template<>
+struct RbArg<const char *> {
+    static inline void get(VALUE arg, const char **out, int argPos) {
+        char *str;
+        RbArg<char *>::get(arg, &str, argPos);
+        *out = str;
+    }
+};
+
+inline void rb_get_typed_args_at(int, VALUE *, int) {}
+
+template<typename T, typename... Rest>
+inline void rb_get_typed_args_at(int argc, VALUE *argv, int argPos,
+                                 T *out, Rest *...rest) {
+    if (argPos >= argc)
+        return;
+    
+    RbArg<T>::get(argv[argPos], out, argPos);
+    rb_get_typed_args_at(argc, argv, argPos + 1, rest...);
+}
+
+/* Typed variant of 'rb_get_args': the conversions are picked from
+ * the types of the out pointers at compile time instead of parsing
+ * a format string. The first 'Req' arguments are required, the
+ * rest optional (as if preceded by '|'). Raises the same errors */
+template<int Req, typename... Args>
+inline int rb_get_typed_args(int argc, VALUE *argv, Args *...out) {
+    static_assert(Req <= (int)sizeof...(Args), "More required arguments than outputs");
+    
+    // FIXME print num of needed args vs provided
+    if (argc < Req)
+        rb_raise(rb_eArgError, "wrong number of arguments");
+    
+#ifndef NDEBUG
+    if (argc > (int)sizeof...(Args))
+        rb_raise(rb_eArgError, "wrong number of arguments");
+#endif
+    
+    rb_get_typed_args_at(argc, argv, 0, out...);
+    
+    return argc < (int)sizeof...(Args) ? argc : (int)sizeof...(Args);
+}
+
 #if RAPI_MAJOR < 2
 static inline void rb_error_arity(int argc, int min, int max) {
     if (argc > max || argc < min)
@@ -459,7 +618,7 @@ return self;                                                               \
 #define DEF_PROP_OBJ_REF(Klass, PropKlass, PropName, prop_iv)                  \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
-return rb_iv_get(self, prop_iv);                                           \
+return rb_ivar_get(self, RB_CACHED_ID(prop_iv));                             \
 }                                                                            \
 RB_METHOD(Klass##Set##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
@@ -472,14 +631,14 @@ prop = 0;                                                                \
 else                                                                       \
 prop = getPrivateDataCheck<PropKlass>(propObj, PropKlass##Type);         \
 GUARD_EXC(k->set##PropName(prop);)                                         \
-rb_iv_set(self, prop_iv, propObj);                                         \
+rb_ivar_set(self, RB_CACHED_ID(prop_iv), propObj);                           \
 return propObj;                                                            \
 }
 #else
 #define DEF_PROP_OBJ_REF(Klass, PropKlass, PropName, prop_iv)                  \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
-return rb_iv_get(self, prop_iv);                                           \
+return rb_ivar_get(self, RB_CACHED_ID(prop_iv));                             \
 }                                                                            \
 RB_METHOD(Klass##Set##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
@@ -492,18 +651,25 @@ prop = 0;                                                                \
 else                                                                       \
 prop = getPrivateDataCheck<PropKlass>(propObj, #PropKlass);              \
 GUARD_EXC(k->set##PropName(prop);)                                         \
-rb_iv_set(self, prop_iv, propObj);                                         \
+rb_ivar_set(self, RB_CACHED_ID(prop_iv), propObj);                           \
 return propObj;                                                            \
 }
 #endif
 
+/* Value property objects alias their owner's state, so
+ * a frozen one mustn't change through the owner either */
+inline void checkPropFrozen(VALUE propObj) {
+    if (!NIL_P(propObj))
+        rb_check_frozen(propObj);
+}
+
 /* Object property which is copied by value, not reference */
 #if RAPI_FULL > 187
 #define DEF_PROP_OBJ_VAL(Klass, PropKlass, PropName, prop_iv)                  \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
 checkDisposed<Klass>(self);                                                \
-return rb_iv_get(self, prop_iv);                                           \
+return rb_ivar_get(self, RB_CACHED_ID(prop_iv));                             \
 }                                                                            \
 RB_METHOD(Klass##Set##PropName) {                                            \
 rb_check_argc(argc, 1);                                                    \
@@ -511,6 +677,7 @@ Klass *k = getPrivateData<Klass>(self);                                    \
 VALUE propObj = *argv;                                                     \
 PropKlass *prop;                                                           \
 prop = getPrivateDataCheck<PropKlass>(propObj, PropKlass##Type);           \
+checkPropFrozen(rb_ivar_get(self, RB_CACHED_ID(prop_iv)));                 \
 GUARD_EXC(k->set##PropName(*prop);)                                        \
 return propObj;                                                            \
 }
@@ -519,7 +686,7 @@ return propObj;                                                            \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
 checkDisposed<Klass>(self);                                                \
-return rb_iv_get(self, prop_iv);                                           \
+return rb_ivar_get(self, RB_CACHED_ID(prop_iv));                             \
 }                                                                            \
 RB_METHOD(Klass##Set##PropName) {                                            \
 rb_check_argc(argc, 1);                                                    \
@@ -527,12 +694,13 @@ Klass *k = getPrivateData<Klass>(self);                                    \
 VALUE propObj = *argv;                                                     \
 PropKlass *prop;                                                           \
 prop = getPrivateDataCheck<PropKlass>(propObj, #PropKlass);                \
+checkPropFrozen(rb_ivar_get(self, RB_CACHED_ID(prop_iv)));                 \
 GUARD_EXC(k->set##PropName(*prop);)                                        \
 return propObj;                                                            \
 }
 #endif
 
-#define DEF_PROP(Klass, type, PropName, arg_fun, value_fun)                    \
+#define DEF_PROP(Klass, type, PropName, value_fun)                             \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
 Klass *k = getPrivateData<Klass>(self);                                    \
@@ -544,19 +712,19 @@ RB_METHOD(Klass##Set##PropName) {                                            \
 rb_check_argc(argc, 1);                                                    \
 Klass *k = getPrivateData<Klass>(self);                                    \
 type value;                                                                \
-rb_##arg_fun##_arg(*argv, &value);                                         \
+RbArg<type>::get(*argv, &value, 0);                                        \
 GUARD_EXC(k->set##PropName(value);)                                        \
 return *argv;                                                              \
 }
 
 #define DEF_PROP_I(Klass, PropName)                                            \
-DEF_PROP(Klass, int, PropName, int, rb_fix_new)
+DEF_PROP(Klass, int, PropName, rb_fix_new)
 
 #define DEF_PROP_F(Klass, PropName)                                            \
-DEF_PROP(Klass, double, PropName, float, rb_float_new)
+DEF_PROP(Klass, double, PropName, rb_float_new)
 
 #define DEF_PROP_B(Klass, PropName)                                            \
-DEF_PROP(Klass, bool, PropName, bool, rb_bool_new)
+DEF_PROP(Klass, bool, PropName, rb_bool_new)
 
 #define INIT_PROP_BIND(Klass, PropName, prop_name_s)                           \
 {                                                                            \
@@ -571,7 +739,7 @@ _rb_define_method(klass, prop_name_s "=", Klass##Set##PropName);           \
 #define DEF_GFX_PROP_OBJ_REF(Klass, PropKlass, PropName, prop_iv)                  \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
-return rb_iv_get(self, prop_iv);                                           \
+return rb_ivar_get(self, RB_CACHED_ID(prop_iv));                             \
 }                                                                            \
 RB_METHOD(Klass##Set##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
@@ -584,7 +752,7 @@ prop = 0;                                                                \
 else                                                                       \
 prop = getPrivateDataCheck<PropKlass>(propObj, PropKlass##Type);         \
 GFX_GUARD_EXC(k->set##PropName(prop);)                                         \
-rb_iv_set(self, prop_iv, propObj);                                         \
+rb_ivar_set(self, RB_CACHED_ID(prop_iv), propObj);                           \
 return propObj;                                                            \
 }
 #else
@@ -598,7 +766,7 @@ DEF_PROP_OBJ_REF(Klass, PropKlass, PropName, prop_iv)
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
 checkDisposed<Klass>(self);                                                \
-return rb_iv_get(self, prop_iv);                                           \
+return rb_ivar_get(self, RB_CACHED_ID(prop_iv));                             \
 }                                                                            \
 RB_METHOD(Klass##Set##PropName) {                                            \
 rb_check_argc(argc, 1);                                                    \
@@ -606,6 +774,7 @@ Klass *k = getPrivateData<Klass>(self);                                    \
 VALUE propObj = *argv;                                                     \
 PropKlass *prop;                                                           \
 prop = getPrivateDataCheck<PropKlass>(propObj, PropKlass##Type);           \
+checkPropFrozen(rb_ivar_get(self, RB_CACHED_ID(prop_iv)));                 \
 GFX_GUARD_EXC(k->set##PropName(*prop);)                                        \
 return propObj;                                                            \
 }
@@ -614,7 +783,34 @@ return propObj;                                                            \
 DEF_PROP_OBJ_VAL(Klass, PropKlass, PropName, prop_iv)
 #endif
 
-#define DEF_GFX_PROP(Klass, type, PropName, arg_fun, value_fun)                    \
+/* Like DEF_GFX_PROP_OBJ_VAL, but the property object is only
+ * allocated and wrapped once the getter is first called,
+ * through 'Klass::init##PropName()'. Until then, the setter
+ * writes to the neutral default the object holds itself */
+#define DEF_GFX_PROP_OBJ_LAZY(Klass, PropKlass, PropName, prop_iv)                 \
+RB_METHOD(Klass##Get##PropName) {                                            \
+RB_UNUSED_PARAM;                                                           \
+checkDisposed<Klass>(self);                                                \
+VALUE propObj = rb_ivar_get(self, RB_CACHED_ID(prop_iv));                    \
+if (!NIL_P(propObj))                                                       \
+return propObj;                                                          \
+Klass *k = getPrivateData<Klass>(self);                                    \
+PropKlass *prop = 0;                                                       \
+GFX_GUARD_EXC(prop = &k->init##PropName();)                                \
+return wrapProperty(self, prop, prop_iv, PropKlass##Type);                 \
+}                                                                            \
+RB_METHOD(Klass##Set##PropName) {                                            \
+rb_check_argc(argc, 1);                                                    \
+Klass *k = getPrivateData<Klass>(self);                                    \
+VALUE propObj = *argv;                                                     \
+PropKlass *prop;                                                           \
+prop = getPrivateDataCheck<PropKlass>(propObj, PropKlass##Type);           \
+checkPropFrozen(rb_ivar_get(self, RB_CACHED_ID(prop_iv)));                 \
+GFX_GUARD_EXC(k->set##PropName(*prop);)                                    \
+return propObj;                                                            \
+}
+
+#define DEF_GFX_PROP(Klass, type, PropName, value_fun)                             \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
 Klass *k = getPrivateData<Klass>(self);                                    \
@@ -626,18 +822,18 @@ RB_METHOD(Klass##Set##PropName) {                                            \
 rb_check_argc(argc, 1);                                                    \
 Klass *k = getPrivateData<Klass>(self);                                    \
 type value;                                                                \
-rb_##arg_fun##_arg(*argv, &value);                                         \
-GFX_GUARD_EXC(k->set##PropName(value);)                                        \
+RbArg<type>::get(*argv, &value, 0);                                        \
+GFX_STATE_GUARD_EXC(k->set##PropName(value);)                                  \
 return *argv;                                                              \
 }
 
 #define DEF_GFX_PROP_I(Klass, PropName)                                            \
-DEF_GFX_PROP(Klass, int, PropName, int, rb_fix_new)
+DEF_GFX_PROP(Klass, int, PropName, rb_fix_new)
 
 #define DEF_GFX_PROP_F(Klass, PropName)                                            \
-DEF_GFX_PROP(Klass, double, PropName, float, rb_float_new)
+DEF_GFX_PROP(Klass, double, PropName, rb_float_new)
 
 #define DEF_GFX_PROP_B(Klass, PropName)                                            \
-DEF_GFX_PROP(Klass, bool, PropName, bool, rb_bool_new)
+DEF_GFX_PROP(Klass, bool, PropName, rb_bool_new)
 
 #endif // BINDING_UTIL_H
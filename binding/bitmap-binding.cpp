@@ -22,6 +22,7 @@
 #include "binding-types.h"
 #include "binding-util.h"
 #include "bitmap.h"
+#include "bitmaploader.h"
 #include "disposable-binding.h"
 #include "exception.h"
 #include "font.h"
@@ -61,13 +62,13 @@ RB_METHOD(bitmapInitialize) {
     Bitmap *b = 0;
     
     if (argc == 1) {
-        char *filename;
-        rb_get_args(argc, argv, "z", &filename RB_ARG_END);
+        const char *filename;
+        rb_get_typed_args<1>(argc, argv, &filename);
         
         GFX_GUARD_EXC(b = new Bitmap(filename);)
     } else {
         int width, height;
-        rb_get_args(argc, argv, "ii", &width, &height RB_ARG_END);
+        rb_get_typed_args<2>(argc, argv, &width, &height);
         
         GFX_GUARD_EXC(b = new Bitmap(width, height);)
     }
@@ -78,6 +79,80 @@ RB_METHOD(bitmapInitialize) {
     return self;
 }
 
+/* Blocks of background loads, keyed by load id.
+ * Kept in a class ivar so the GC leaves them alone */
+static VALUE backgroundLoads() {
+    static VALUE klass = rb_const_get(rb_cObject, rb_intern("Bitmap"));
+    return rb_iv_get(klass, "background_loads");
+}
+
+RB_METHOD(bitmapLoadInBackground) {
+    RB_UNUSED_PARAM;
+    
+    const char *filename;
+    rb_get_typed_args<1>(argc, argv, &filename);
+    
+    if (!rb_block_given_p())
+        rb_raise(rb_eArgError, "no block given");
+    
+    VALUE block = rb_block_proc();
+    int id = shState->bitmapLoader().load(filename);
+    
+    rb_hash_aset(backgroundLoads(), INT2FIX(id), block);
+    
+    return Qnil;
+}
+
+/* Called from Graphics.update. Successful loads pass the new
+ * Bitmap to their block, failed ones pass nil and the error
+ * message. The Ruby side of a reset drops outstanding loads,
+ * so results without a block are thrown away */
+void bitmapDeliverBackgroundLoads() {
+    while (true) {
+        VALUE block, obj = Qnil, error = Qnil;
+        
+        {
+            BitmapLoader::Result result;
+            
+            if (!shState->bitmapLoader().takeFinished(result))
+                return;
+            
+            block = rb_hash_delete(backgroundLoads(), INT2FIX(result.id));
+            
+            if (NIL_P(block)) {
+                BitmapLoader::discard(result);
+                continue;
+            }
+            
+            Bitmap *b = 0;
+            
+            GFX_LOCK;
+            try {
+                b = BitmapLoader::createBitmap(result);
+            } catch (const Exception &exc) {
+                BitmapLoader::discard(result);
+                error = rb_str_new_cstr(exc.msg.c_str());
+            }
+            GFX_UNLOCK;
+            
+            if (b) {
+                obj = wrapObject(b, BitmapType);
+                bitmapInitProps(b, obj);
+            }
+        }
+        
+        if (NIL_P(error))
+            rb_funcall(block, rb_intern("call"), 1, obj);
+        else
+            rb_funcall(block, rb_intern("call"), 2, Qnil, error);
+    }
+}
+
+void bitmapResetBackgroundLoads() {
+    shState->bitmapLoader().clear();
+    rb_funcall(backgroundLoads(), rb_intern("clear"), 0);
+}
+
 RB_METHOD(bitmapWidth) {
     RB_UNUSED_PARAM;
     
@@ -126,8 +201,8 @@ RB_METHOD(bitmapBlt) {
     Bitmap *src;
     Rect *srcRect;
     
-    rb_get_args(argc, argv, "iioo|i", &x, &y, &srcObj, &srcRectObj,
-                &opacity RB_ARG_END);
+    rb_get_typed_args<4>(argc, argv, &x, &y, &srcObj, &srcRectObj,
+                         &opacity);
     
     src = getPrivateDataCheck<Bitmap>(srcObj, BitmapType);
     srcRect = getPrivateDataCheck<Rect>(srcRectObj, RectType);
@@ -148,8 +223,8 @@ RB_METHOD(bitmapStretchBlt) {
     Bitmap *src;
     Rect *destRect, *srcRect;
     
-    rb_get_args(argc, argv, "ooo|i", &destRectObj, &srcObj, &srcRectObj,
-                &opacity RB_ARG_END);
+    rb_get_typed_args<3>(argc, argv, &destRectObj, &srcObj, &srcRectObj,
+                         &opacity);
     
     src = getPrivateDataCheck<Bitmap>(srcObj, BitmapType);
     destRect = getPrivateDataCheck<Rect>(destRectObj, RectType);
@@ -171,7 +246,7 @@ RB_METHOD(bitmapFillRect) {
         VALUE rectObj;
         Rect *rect;
         
-        rb_get_args(argc, argv, "oo", &rectObj, &colorObj RB_ARG_END);
+        rb_get_typed_args<2>(argc, argv, &rectObj, &colorObj);
         
         rect = getPrivateDataCheck<Rect>(rectObj, RectType);
         color = getPrivateDataCheck<Color>(colorObj, ColorType);
@@ -180,8 +255,8 @@ RB_METHOD(bitmapFillRect) {
     } else {
         int x, y, width, height;
         
-        rb_get_args(argc, argv, "iiiio", &x, &y, &width, &height,
-                    &colorObj RB_ARG_END);
+        rb_get_typed_args<5>(argc, argv, &x, &y, &width, &height,
+                             &colorObj);
         
         color = getPrivateDataCheck<Color>(colorObj, ColorType);
         
@@ -206,7 +281,7 @@ RB_METHOD(bitmapSwapColor) {
 
   VALUE vOC, vNC;
 
-  rb_get_args(argc, argv, "oo", &vOC, &vNC RB_ARG_END);
+  rb_get_typed_args<2>(argc, argv, &vOC, &vNC);
 
   Color *oc, *nc;
   oc = getPrivateDataCheck<Color>(vOC, ColorType);
@@ -222,7 +297,7 @@ RB_METHOD(bitmapSwapPalette){
 
   char* pOC;
   char* pNC;
-  rb_get_args(argc, argv, "zz", &pOC, &pNC RB_ARG_END);
+  rb_get_typed_args<2>(argc, argv, &pOC, &pNC);
 
   GUARD_EXC(b->swapPalette(pOC, pNC););
   return self;
@@ -234,7 +309,7 @@ RB_METHOD(bitmapGetPixel) {
     
     int x, y;
     
-    rb_get_args(argc, argv, "ii", &x, &y RB_ARG_END);
+    rb_get_typed_args<2>(argc, argv, &x, &y);
     
     Color value;
     GUARD_EXC(value = b->getPixel(x, y););
@@ -252,7 +327,7 @@ RB_METHOD(bitmapSetPixel) {
     
     Color *color;
     
-    rb_get_args(argc, argv, "iio", &x, &y, &colorObj RB_ARG_END);
+    rb_get_typed_args<3>(argc, argv, &x, &y, &colorObj);
     
     color = getPrivateDataCheck<Color>(colorObj, ColorType);
     
@@ -266,7 +341,7 @@ RB_METHOD(bitmapHueChange) {
     
     int hue;
     
-    rb_get_args(argc, argv, "i", &hue RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &hue);
     
     GFX_GUARD_EXC(b->hueChange(hue););
     
@@ -285,11 +360,11 @@ RB_METHOD(bitmapDrawText) {
         
         if (rgssVer >= 2) {
             VALUE strObj;
-            rb_get_args(argc, argv, "oo|i", &rectObj, &strObj, &align RB_ARG_END);
+            rb_get_typed_args<2>(argc, argv, &rectObj, &strObj, &align);
             
             str = objAsStringPtr(strObj);
         } else {
-            rb_get_args(argc, argv, "oz|i", &rectObj, &str, &align RB_ARG_END);
+            rb_get_typed_args<2>(argc, argv, &rectObj, &str, &align);
         }
         
         rect = getPrivateDataCheck<Rect>(rectObj, RectType);
@@ -300,13 +375,13 @@ RB_METHOD(bitmapDrawText) {
         
         if (rgssVer >= 2) {
             VALUE strObj;
-            rb_get_args(argc, argv, "iiiio|i", &x, &y, &width, &height, &strObj,
-                        &align RB_ARG_END);
+            rb_get_typed_args<5>(argc, argv, &x, &y, &width, &height, &strObj,
+                                 &align);
             
             str = objAsStringPtr(strObj);
         } else {
-            rb_get_args(argc, argv, "iiiiz|i", &x, &y, &width, &height, &str,
-                        &align RB_ARG_END);
+            rb_get_typed_args<5>(argc, argv, &x, &y, &width, &height, &str,
+                                 &align);
         }
         
         GFX_GUARD_EXC(b->drawText(x, y, width, height, str, align););
@@ -322,11 +397,11 @@ RB_METHOD(bitmapTextSize) {
     
     if (rgssVer >= 2) {
         VALUE strObj;
-        rb_get_args(argc, argv, "o", &strObj RB_ARG_END);
+        rb_get_typed_args<1>(argc, argv, &strObj);
         
         str = objAsStringPtr(strObj);
     } else {
-        rb_get_args(argc, argv, "z", &str RB_ARG_END);
+        rb_get_typed_args<1>(argc, argv, &str);
     }
     
     IntRect value;
@@ -350,8 +425,8 @@ RB_METHOD(bitmapGradientFillRect) {
         VALUE rectObj;
         Rect *rect;
         
-        rb_get_args(argc, argv, "ooo|b", &rectObj, &color1Obj, &color2Obj,
-                    &vertical RB_ARG_END);
+        rb_get_typed_args<3>(argc, argv, &rectObj, &color1Obj, &color2Obj,
+                             &vertical);
         
         rect = getPrivateDataCheck<Rect>(rectObj, RectType);
         color1 = getPrivateDataCheck<Color>(color1Obj, ColorType);
@@ -362,8 +437,8 @@ RB_METHOD(bitmapGradientFillRect) {
     } else {
         int x, y, width, height;
         
-        rb_get_args(argc, argv, "iiiioo|b", &x, &y, &width, &height, &color1Obj,
-                    &color2Obj, &vertical RB_ARG_END);
+        rb_get_typed_args<6>(argc, argv, &x, &y, &width, &height, &color1Obj,
+                             &color2Obj, &vertical);
         
         color1 = getPrivateDataCheck<Color>(color1Obj, ColorType);
         color2 = getPrivateDataCheck<Color>(color2Obj, ColorType);
@@ -382,7 +457,7 @@ RB_METHOD(bitmapClearRect) {
         VALUE rectObj;
         Rect *rect;
         
-        rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+        rb_get_typed_args<1>(argc, argv, &rectObj);
         
         rect = getPrivateDataCheck<Rect>(rectObj, RectType);
         
@@ -390,7 +465,7 @@ RB_METHOD(bitmapClearRect) {
     } else {
         int x, y, width, height;
         
-        rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+        rb_get_typed_args<4>(argc, argv, &x, &y, &width, &height);
         
         GFX_GUARD_EXC(b->clearRect(x, y, width, height););
     }
@@ -414,7 +489,7 @@ RB_METHOD(bitmapRadialBlur) {
     Bitmap *b = getPrivateData<Bitmap>(self);
     
     int angle, divisions;
-    rb_get_args(argc, argv, "ii", &angle, &divisions RB_ARG_END);
+    rb_get_typed_args<2>(argc, argv, &angle, &divisions);
     
     GFX_LOCK;
     b->radialBlur(angle, divisions);
@@ -506,7 +581,7 @@ RB_METHOD(bitmapSetPlaying){
     
     bool play;
     
-    rb_get_args(argc, argv, "b", &play RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &play);
     
     Bitmap *b = getPrivateData<Bitmap>(self);
     
@@ -542,7 +617,7 @@ RB_METHOD(bitmapGotoStop){
     
     int frame;
     
-    rb_get_args(argc, argv, "i", &frame RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &frame);
     
     Bitmap *b = getPrivateData<Bitmap>(self);
     
@@ -556,7 +631,7 @@ RB_METHOD(bitmapGotoPlay){
     
     int frame;
     
-    rb_get_args(argc, argv, "i", &frame RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &frame);
     
     Bitmap *b = getPrivateData<Bitmap>(self);
     
@@ -692,7 +767,7 @@ RB_METHOD(bitmapSetLooping){
     RB_UNUSED_PARAM;
     
     bool loop;
-    rb_get_args(argc, argv, "b", &loop RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &loop);
     
     Bitmap *b = getPrivateData<Bitmap>(self);
     
@@ -805,6 +880,9 @@ void bitmapBindingInit() {
     _rb_define_method(klass, "mega?", bitmapGetMega);
     rb_define_singleton_method(klass, "max_size", RUBY_METHOD_FUNC(bitmapGetMaxSize), -1);
     
+    rb_iv_set(klass, "background_loads", rb_hash_new());
+    rb_define_class_method(klass, "load_in_background", bitmapLoadInBackground);
+    
     _rb_define_method(klass, "animated?", bitmapGetAnimated);
     _rb_define_method(klass, "playing", bitmapGetPlaying);
     _rb_define_method(klass, "playing=", bitmapSetPlaying);
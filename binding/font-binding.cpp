@@ -186,6 +186,7 @@ RB_METHOD(FontSetDefaultOutColor) {
   rb_get_args(argc, argv, "o", &colorObj RB_ARG_END);
 
   Color *c = getPrivateDataCheck<Color>(colorObj, ColorType);
+  checkPropFrozen(rb_iv_get(self, "default_out_color"));
 
   Font::setDefaultOutColor(*c);
 
@@ -224,6 +225,7 @@ RB_METHOD(FontSetDefaultColor) {
   rb_get_args(argc, argv, "o", &colorObj RB_ARG_END);
 
   Color *c = getPrivateDataCheck<Color>(colorObj, ColorType);
+  checkPropFrozen(rb_iv_get(self, "default_color"));
 
   Font::setDefaultColor(*c);
 
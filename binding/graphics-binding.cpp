@@ -38,9 +38,119 @@ RB_METHOD(graphicsDelta) {
     return ret;
 }
 
+/* Milliseconds spent in scheduled collections
+ * by the last Graphics.update or freeze */
+static double gcTime = 0;
+
+#if RAPI_FULL >= 210
+/* Minimum slack, in milliseconds, a frame needs
+ * before a collection is started in it */
+#define GC_MIN_SLACK 2.0
+
+/* Allocations worth collecting for when there's time */
+#define GC_MIN_PENDING 10000
+
+static size_t gcLastAllocated = 0;
+
+static size_t gcAllocatedObjects() {
+    return rb_gc_stat(ID2SYM(RB_CACHED_ID("total_allocated_objects")));
+}
+
+/* A script that turned GC off knows what it's doing.
+ * There's no call to only query the state */
+static bool gcDisabledByScript() {
+    if (rb_gc_enable() == Qfalse)
+        return false;
+    
+    rb_gc_disable();
+    return true;
+}
+
+static void gcCollect(bool full) {
+    if (gcDisabledByScript())
+        return;
+    
+    VALUE opts = rb_hash_new();
+    rb_hash_aset(opts, ID2SYM(RB_CACHED_ID("full_mark")), rb_bool_new(full));
+    rb_hash_aset(opts, ID2SYM(RB_CACHED_ID("immediate_sweep")), rb_bool_new(full));
+    
+    double start = shState->runTime();
+    
+#if RAPI_FULL >= 270
+    rb_funcallv_kw(rb_mGC, RB_CACHED_ID("start"), 1, &opts, RB_PASS_KEYWORDS);
+#else
+    rb_funcall(rb_mGC, RB_CACHED_ID("start"), 1, opts);
+#endif
+    
+    gcTime += (shState->runTime() - start) / 1000;
+    gcLastAllocated = gcAllocatedObjects();
+}
+
+/* Minor collections don't move the limits that make Ruby start
+ * a major one on its own, which then lands wherever the frame
+ * happens to be. Being within 10% of either limit is the cue
+ * to run the major collection ahead of time instead */
+static bool gcMajorDue() {
+#if RAPI_FULL >= 220
+    size_t old = rb_gc_stat(ID2SYM(RB_CACHED_ID("old_objects")));
+    size_t oldLimit = rb_gc_stat(ID2SYM(RB_CACHED_ID("old_objects_limit")));
+    
+    if (old >= oldLimit / 10 * 9)
+        return true;
+    
+    size_t malloced = rb_gc_stat(ID2SYM(RB_CACHED_ID("oldmalloc_increase_bytes")));
+    size_t mallocLimit = rb_gc_stat(ID2SYM(RB_CACHED_ID("oldmalloc_increase_bytes_limit")));
+    
+    return malloced >= mallocLimit / 10 * 9;
+#else
+    return false;
+#endif
+}
+
+/* Runs a collection if the coming frame leaves enough time for
+ * one, or if too much was allocated to wait longer. It's a full
+ * one when Ruby's next major collection is close, and a minor
+ * one otherwise. Ruby's own collections stay enabled as the
+ * backstop for scripts that don't call Graphics.update for a
+ * while, and can still hit a frame that allocates heavily */
+static void gcScheduleFrame() {
+    const Config &conf = shState->config();
+    
+    if (!conf.gcScheduler.enabled)
+        return;
+    
+    size_t pending = gcAllocatedObjects() - gcLastAllocated;
+    bool major = gcMajorDue();
+    
+    if (!major && pending < GC_MIN_PENDING)
+        return;
+    
+    if (pending < (size_t)conf.gcScheduler.safetyLimit) {
+        GFX_LOCK;
+        double slack = shState->graphics().frameSlack();
+        GFX_UNLOCK;
+        
+        if (slack < GC_MIN_SLACK)
+            return;
+    }
+    
+    gcCollect(major);
+}
+#endif
+
+void bitmapDeliverBackgroundLoads();
+void tweenDeliverFinished();
+void httpDeliverAsync();
+
 RB_METHOD(graphicsUpdate)
 {
     RB_UNUSED_PARAM;
+    
+    gcTime = 0;
+#if RAPI_FULL >= 210
+    gcScheduleFrame();
+#endif
+    
 #if RAPI_MAJOR >= 2
     rb_thread_call_without_gvl([](void*) -> void* {
         GFX_LOCK;
@@ -51,9 +161,42 @@ RB_METHOD(graphicsUpdate)
 #else
     shState->graphics().update();
 #endif
+    
+    double latency;
+    if (shState->graphics().takeInputLatency(latency)) {
+        VALUE hook = rb_iv_get(self, "input_latency_hook");
+        
+        if (!NIL_P(hook))
+            rb_funcall(hook, rb_intern("call"), 1, rb_float_new(latency));
+    }
+    
+    bitmapDeliverBackgroundLoads();
+    tweenDeliverFinished();
+    httpDeliverAsync();
+    
     return Qnil;
 }
 
+RB_METHOD(graphicsGetInputLatencyHook)
+{
+    RB_UNUSED_PARAM;
+    return rb_iv_get(self, "input_latency_hook");
+}
+
+RB_METHOD(graphicsSetInputLatencyHook)
+{
+    RB_UNUSED_PARAM;
+    
+    VALUE hook;
+    rb_scan_args(argc, argv, "1", &hook);
+    
+    if (!NIL_P(hook) && !rb_respond_to(hook, rb_intern("call")))
+        rb_raise(rb_eTypeError, "input latency hook must respond to 'call'");
+    
+    rb_iv_set(self, "input_latency_hook", hook);
+    return hook;
+}
+
 RB_METHOD(graphicsAverageFrameRate)
 {
     RB_UNUSED_PARAM;
@@ -71,9 +214,25 @@ RB_METHOD(graphicsFreeze)
     shState->graphics().freeze();
     GFX_UNLOCK;
     
+#if RAPI_FULL >= 210
+    /* The screen stays still until the transition,
+     * so a full collection goes unnoticed here */
+    if (shState->config().gcScheduler.enabled) {
+        gcTime = 0;
+        gcCollect(true);
+    }
+#endif
+    
     return Qnil;
 }
 
+RB_METHOD(graphicsGCTime)
+{
+    RB_UNUSED_PARAM;
+    
+    return rb_float_new(gcTime);
+}
+
 RB_METHOD(graphicsTransition)
 {
     RB_UNUSED_PARAM;
@@ -395,6 +554,7 @@ void graphicsBindingInit()
     INIT_GRA_PROP_BIND( FrameRate,  "frame_rate"  );
     INIT_GRA_PROP_BIND( FrameCount, "frame_count" );
     _rb_define_module_function(module, "average_frame_rate", graphicsAverageFrameRate);
+    _rb_define_module_function(module, "gc_time", graphicsGCTime);
 
     _rb_define_module_function(module, "width", graphicsWidth);
     _rb_define_module_function(module, "height", graphicsHeight);
@@ -426,4 +586,12 @@ void graphicsBindingInit()
     INIT_GRA_PROP_BIND( IntegerScaling,   "integer_scaling"    );
     INIT_GRA_PROP_BIND( LastMileScaling,  "last_mile_scaling"  );
     INIT_GRA_PROP_BIND( Threadsafe,       "thread_safe"        );
+    
+    rb_iv_set(module, "input_latency_hook", Qnil);
+    INIT_GRA_PROP_BIND( InputLatencyHook, "input_latency_hook" );
+    
+#if RAPI_FULL >= 210
+    if (shState->config().gcScheduler.enabled)
+        gcLastAllocated = gcAllocatedObjects();
+#endif
 }
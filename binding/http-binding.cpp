@@ -15,6 +15,8 @@
 #endif
 
 #include "net/net.h"
+#include "sharedstate.h"
+#include "config.h"
 
 VALUE stringMap2hash(mkxp_net::StringMap &map) {
     VALUE ret = rb_hash_new();
@@ -201,6 +203,295 @@ RB_METHOD(httpPostBody) {
 #endif
 }
 
+// Progress blocks are called at most once per this many bytes,
+// as every call has to reacquire the GVL
+#define DOWNLOAD_PROGRESS_STEP (256 * 1024)
+
+typedef struct {
+    mkxp_net::HTTPRequest *req;
+    const char *path;
+    const char *hash;
+    VALUE block;
+    
+    uint64_t current, total, reported;
+    int jumpState;
+    
+    mkxp_net::HTTPResponse res;
+    bool failed;
+    Exception::Type errorType;
+    std::string error;
+} httpDownloadArgs;
+
+static VALUE httpDownloadCallBlock(VALUE args) {
+    httpDownloadArgs *a = (httpDownloadArgs*)args;
+    
+    return rb_funcall(a->block, rb_intern("call"), 2,
+                      ULL2NUM(a->current), a->total ? ULL2NUM(a->total) : Qnil);
+}
+
+static void *httpDownloadProgressCb(void *args) {
+    httpDownloadArgs *a = (httpDownloadArgs*)args;
+    
+    // Whatever leaves the block (an exception, break, throw) is
+    // held here until the transfer has unwound, then rethrown
+    rb_protect(httpDownloadCallBlock, (VALUE)a, &a->jumpState);
+    
+    return 0;
+}
+
+static bool httpDownloadProgress(httpDownloadArgs *a, uint64_t current, uint64_t total) {
+    if (NIL_P(a->block))
+        return true;
+    
+    if (current - a->reported < DOWNLOAD_PROGRESS_STEP && current != total)
+        return true;
+    
+    a->current = a->reported = current;
+    a->total = total;
+    
+#if RAPI_MAJOR >= 2
+    rb_thread_call_with_gvl(httpDownloadProgressCb, a);
+#else
+    httpDownloadProgressCb(a);
+#endif
+    
+    return a->jumpState == 0;
+}
+
+static void *httpDownloadInternal(void *args) {
+    httpDownloadArgs *a = (httpDownloadArgs*)args;
+    
+    try {
+        a->res = a->req->download(a->path, a->hash, [a](uint64_t current, uint64_t total) {
+            return httpDownloadProgress(a, current, total);
+        });
+    }
+    catch (const Exception &e) {
+        a->failed = true;
+        a->errorType = e.type;
+        a->error = e.msg;
+    }
+    
+    return 0;
+}
+
+static bool isAbsolutePath(const char *path) {
+    if (path[0] == '/' || path[0] == '\\')
+        return true;
+    
+    // Windows drive letter
+    return isalpha(path[0]) && path[1] == ':';
+}
+
+// HTTPLite.download(url, path[, headers[, redirect]][, hash: "sha256:..."]) { |current, total| }
+//
+// Relative paths are resolved against System.data_directory. Returns
+// a hash with the status, headers and full path; :body is left out
+RB_METHOD(httpDownload) {
+    RB_UNUSED_PARAM;
+    
+    VALUE url, path, rheaders, redirect, opts = Qnil;
+#if RAPI_MAJOR >= 2
+    rb_scan_args(argc, argv, "22:", &url, &path, &rheaders, &redirect, &opts);
+#else
+    rb_scan_args(argc, argv, "22", &url, &path, &rheaders, &redirect);
+#endif
+    SafeStringValue(url);
+    SafeStringValue(path);
+    
+    VALUE hash = Qnil;
+    if (!NIL_P(opts)) {
+        hash = rb_hash_lookup2(opts, ID2SYM(rb_intern("hash")), Qnil);
+        if (!NIL_P(hash))
+            SafeStringValue(hash);
+    }
+    
+    std::string fullPath = RSTRING_PTR(path);
+    if (!isAbsolutePath(fullPath.c_str()))
+        fullPath = shState->config().customDataPath + "/" + fullPath;
+    
+    bool rd;
+    rb_bool_arg(redirect, &rd);
+    mkxp_net::HTTPRequest req(RSTRING_PTR(url), rd);
+    if (rheaders != Qnil) {
+        auto headers = hash2StringMap(rheaders);
+        req.headers().insert(headers.begin(), headers.end());
+    }
+    
+    httpDownloadArgs args;
+    args.req = &req;
+    args.path = fullPath.c_str();
+    args.hash = NIL_P(hash) ? 0 : RSTRING_PTR(hash);
+    args.block = rb_block_given_p() ? rb_block_proc() : Qnil;
+    args.current = args.total = args.reported = 0;
+    args.jumpState = 0;
+    args.failed = false;
+    
+#if RAPI_MAJOR >= 2
+    rb_thread_call_without_gvl(httpDownloadInternal, &args, 0, 0);
+#else
+    httpDownloadInternal(&args);
+#endif
+    
+    if (args.jumpState)
+        rb_jump_tag(args.jumpState);
+    
+    if (args.failed)
+        raiseRbExc(Exception(args.errorType, "%s", args.error.c_str()));
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("status")), INT2NUM(args.res.status()));
+    rb_hash_aset(ret, ID2SYM(rb_intern("headers")), stringMap2hash(args.res.headers()));
+    rb_hash_aset(ret, ID2SYM(rb_intern("path")), rb_utf8_str_new_cstr(fullPath.c_str()));
+    
+    return ret;
+}
+
+static VALUE asyncRequests() {
+    static VALUE mod = rb_const_get(rb_cObject, rb_intern("HTTPLite"));
+    return rb_iv_get(mod, "async_requests");
+}
+
+static int asyncTimeout(VALUE opts) {
+    if (NIL_P(opts))
+        return 0;
+    
+    VALUE timeout = rb_hash_lookup2(opts, ID2SYM(rb_intern("timeout")), Qnil);
+    return NIL_P(timeout) ? 0 : NUM2INT(timeout);
+}
+
+static VALUE asyncBlock() {
+    if (!rb_block_given_p())
+        rb_raise(rb_eArgError, "no block given");
+    
+    return rb_block_proc();
+}
+
+#if RAPI_MAJOR >= 2
+#define ASYNC_SCAN_ARGS(fmt, ...) rb_scan_args(argc, argv, fmt ":", __VA_ARGS__, &opts)
+#else
+#define ASYNC_SCAN_ARGS(fmt, ...) rb_scan_args(argc, argv, fmt, __VA_ARGS__)
+#endif
+
+// HTTPLite.get_async(url[, headers[, redirect]][, timeout: secs]) { |res, error| }
+RB_METHOD(httpGetAsync) {
+    RB_UNUSED_PARAM;
+    
+    VALUE path, rheaders, redirect, opts = Qnil;
+    ASYNC_SCAN_ARGS("12", &path, &rheaders, &redirect);
+    SafeStringValue(path);
+    VALUE block = asyncBlock();
+    
+    bool rd;
+    rb_bool_arg(redirect, &rd);
+    mkxp_net::HTTPRequest req(RSTRING_PTR(path), rd);
+    if (rheaders != Qnil) {
+        auto headers = hash2StringMap(rheaders);
+        req.headers().insert(headers.begin(), headers.end());
+    }
+    
+    int id = shState->httpPool().get(req, asyncTimeout(opts));
+    rb_hash_aset(asyncRequests(), INT2FIX(id), block);
+    
+    return INT2FIX(id);
+}
+
+// HTTPLite.post_async(url, data[, headers[, redirect]][, timeout: secs]) { |res, error| }
+RB_METHOD(httpPostAsync) {
+    RB_UNUSED_PARAM;
+    
+    VALUE path, postDataHash, rheaders, redirect, opts = Qnil;
+    ASYNC_SCAN_ARGS("22", &path, &postDataHash, &rheaders, &redirect);
+    SafeStringValue(path);
+    VALUE block = asyncBlock();
+    
+    bool rd;
+    rb_bool_arg(redirect, &rd);
+    mkxp_net::HTTPRequest req(RSTRING_PTR(path), rd);
+    if (rheaders != Qnil) {
+        auto headers = hash2StringMap(rheaders);
+        req.headers().insert(headers.begin(), headers.end());
+    }
+    
+    mkxp_net::StringMap postData = hash2StringMap(postDataHash);
+    int id = shState->httpPool().post(req, postData, asyncTimeout(opts));
+    rb_hash_aset(asyncRequests(), INT2FIX(id), block);
+    
+    return INT2FIX(id);
+}
+
+// HTTPLite.post_body_async(url, body, content_type[, headers][, timeout: secs]) { |res, error| }
+RB_METHOD(httpPostBodyAsync) {
+    RB_UNUSED_PARAM;
+    
+    VALUE path, body, ctype, rheaders, opts = Qnil;
+    ASYNC_SCAN_ARGS("31", &path, &body, &ctype, &rheaders);
+    SafeStringValue(path);
+    SafeStringValue(body);
+    SafeStringValue(ctype);
+    VALUE block = asyncBlock();
+    
+    mkxp_net::HTTPRequest req(RSTRING_PTR(path));
+    if (rheaders != Qnil) {
+        auto headers = hash2StringMap(rheaders);
+        req.headers().insert(headers.begin(), headers.end());
+    }
+    
+    int id = shState->httpPool().post(req, RSTRING_PTR(body), RSTRING_PTR(ctype), asyncTimeout(opts));
+    rb_hash_aset(asyncRequests(), INT2FIX(id), block);
+    
+    return INT2FIX(id);
+}
+
+// Returns true if the request was still pending,
+// in which case its block will never be called
+RB_METHOD(httpCancel) {
+    RB_UNUSED_PARAM;
+    
+    int id;
+    rb_get_args(argc, argv, "i", &id RB_ARG_END);
+    
+    shState->httpPool().cancel(id);
+    
+    return rb_bool_new(!NIL_P(rb_hash_delete(asyncRequests(), INT2FIX(id))));
+}
+
+/* Called from Graphics.update. Successful requests pass their
+ * response to the block, failed ones pass nil and the error
+ * message. Canceled requests have no block and are skipped */
+void httpDeliverAsync() {
+    while (true) {
+        VALUE block, res = Qnil, error = Qnil;
+        
+        {
+            mkxp_net::HTTPAsyncPool::Result result;
+            
+            if (!shState->httpPool().takeFinished(result))
+                return;
+            
+            block = rb_hash_delete(asyncRequests(), INT2FIX(result.id));
+            
+            if (NIL_P(block))
+                continue;
+            
+            if (result.error.empty())
+                res = formResponse(result.response);
+            else
+                error = rb_str_new_cstr(result.error.c_str());
+        }
+        
+        if (NIL_P(error))
+            rb_funcall(block, rb_intern("call"), 1, res);
+        else
+            rb_funcall(block, rb_intern("call"), 2, Qnil, error);
+    }
+}
+
+void httpResetAsync() {
+    shState->httpPool().clear();
+    rb_funcall(asyncRequests(), rb_intern("clear"), 0);
+}
+
 VALUE json2rb(json5pp::value const &v) {
     if (v.is_null())
         return Qnil;
@@ -319,6 +610,12 @@ void httpBindingInit() {
     _rb_define_module_function(mNet, "get", httpGet);
     _rb_define_module_function(mNet, "post", httpPost);
     _rb_define_module_function(mNet, "post_body", httpPostBody);
+    _rb_define_module_function(mNet, "download", httpDownload);
+    _rb_define_module_function(mNet, "get_async", httpGetAsync);
+    _rb_define_module_function(mNet, "post_async", httpPostAsync);
+    _rb_define_module_function(mNet, "post_body_async", httpPostBodyAsync);
+    _rb_define_module_function(mNet, "cancel", httpCancel);
+    rb_iv_set(mNet, "async_requests", rb_hash_new());
     
     VALUE mNetJSON = rb_define_module_under(mNet, "JSON");
     _rb_define_module_function(mNetJSON, "stringify", httpJsonStringify);
@@ -99,10 +99,7 @@ RB_METHOD(inputPress) {
     
     rb_check_argc(argc, 1);
     
-    VALUE button;
-    rb_scan_args(argc, argv, "1", &button);
-    
-    int num = getButtonArg(&button);
+    int num = getButtonArg(argv);
     
     return rb_bool_new(shState->input().isPressed(num));
 }
@@ -112,10 +109,7 @@ RB_METHOD(inputTrigger) {
     
     rb_check_argc(argc, 1);
     
-    VALUE button;
-    rb_scan_args(argc, argv, "1", &button);
-    
-    int num = getButtonArg(&button);
+    int num = getButtonArg(argv);
     
     return rb_bool_new(shState->input().isTriggered(num));
 }
@@ -125,10 +119,7 @@ RB_METHOD(inputRepeat) {
     
     rb_check_argc(argc, 1);
     
-    VALUE button;
-    rb_scan_args(argc, argv, "1", &button);
-    
-    int num = getButtonArg(&button);
+    int num = getButtonArg(argv);
     
     return rb_bool_new(shState->input().isRepeated(num));
 }
@@ -138,10 +129,7 @@ RB_METHOD(inputRelease) {
     
     rb_check_argc(argc, 1);
     
-    VALUE button;
-    rb_scan_args(argc, argv, "1", &button);
-    
-    int num = getButtonArg(&button);
+    int num = getButtonArg(argv);
     
     return rb_bool_new(shState->input().isReleased(num));
 }
@@ -151,10 +139,7 @@ RB_METHOD(inputCount) {
     
     rb_check_argc(argc, 1);
     
-    VALUE button;
-    rb_scan_args(argc, argv, "1", &button);
-    
-    int num = getButtonArg(&button);
+    int num = getButtonArg(argv);
     
     return UINT2NUM(shState->input().count(num));
 }
@@ -164,10 +149,7 @@ RB_METHOD(inputRepeatTime) {
     
     rb_check_argc(argc, 1);
     
-    VALUE button;
-    rb_scan_args(argc, argv, "1", &button);
-    
-    int num = getButtonArg(&button);
+    int num = getButtonArg(argv);
     
     return rb_float_new(shState->input().repeatTime(num));
 }
@@ -31,10 +31,32 @@
 #define _T_INTEGER 3
 #define _T_BOOL 4
 
+/* Everything a call needs, resolved once in initialize */
+struct MiniFFI {
+    void *lib;
+    MINIFFI_FUNC func;
+    
+    int nimports;
+    uint8_t imports[MINIFFI_MAX_ARGS];
+    uint8_t exports;
+    
+    /* Release the GVL for the duration of the call */
+    bool nogvl;
+};
+
+static void MiniFFI_free(void *p) {
+    MiniFFI *f = (MiniFFI*)p;
+    if (!f)
+        return;
+    if (f->lib)
+        SDL_UnloadObject(f->lib);
+    delete f;
+}
+
 #if RAPI_FULL > 187
-DEF_TYPE_CUSTOMFREE(MiniFFI, SDL_UnloadObject);
+DEF_TYPE_CUSTOMFREE(MiniFFI, MiniFFI_free);
 #else
-DEF_ALLOCFUNC_CUSTOMFREE(MiniFFI, SDL_UnloadObject);
+DEF_ALLOCFUNC_CUSTOMFREE(MiniFFI, MiniFFI_free);
 #endif
 
 static void *MiniFFI_GetFunctionHandle(void *libhandle, const char *func) {
@@ -43,36 +65,91 @@ static void *MiniFFI_GetFunctionHandle(void *libhandle, const char *func) {
     return SDL_LoadFunction(libhandle, func);
 }
 
-// MiniFFI.new(library, function[, imports[, exports]])
+static bool MiniFFI_typeCode(char c, uint8_t &type) {
+    switch (c) {
+        case 'V':
+        case 'v':
+            type = _T_VOID;
+            return true;
+        
+        case 'N':
+        case 'n':
+        case 'L':
+        case 'l':
+            type = _T_NUMBER;
+            return true;
+        
+        case 'P':
+        case 'p':
+            type = _T_POINTER;
+            return true;
+        
+        case 'I':
+        case 'i':
+            type = _T_INTEGER;
+            return true;
+        
+        case 'B':
+        case 'b':
+            type = _T_BOOL;
+            return true;
+    }
+    
+    return false;
+}
+
+static void MiniFFI_addImport(MiniFFI *f, long &count, char c) {
+    uint8_t type;
+    
+    // Unknown codes are skipped, as in Win32API
+    if (!MiniFFI_typeCode(c, type) || type == _T_VOID)
+        return;
+    
+    if (count < MINIFFI_MAX_ARGS)
+        f->imports[count] = type;
+    count++;
+}
+
+// MiniFFI.new(library, function[, imports[, exports]][, nogvl: true])
 // Yields itself in blocks
+//
+// Calls release the GVL so other Ruby threads keep running while
+// they block. Pass nogvl: false for short calls like key state
+// polling, where handing the lock over costs more than the call
 
 RB_METHOD(MiniFFI_initialize) {
-    VALUE libname, func, imports, exports;
+    VALUE libname, func, imports, exports, opts = Qnil;
+#if RAPI_MAJOR >= 2
+    rb_scan_args(argc, argv, "22:", &libname, &func, &imports, &exports, &opts);
+#else
     rb_scan_args(argc, argv, "22", &libname, &func, &imports, &exports);
+#endif
     SafeStringValue(libname);
     SafeStringValue(func);
+    
+    MiniFFI *f = new MiniFFI();
 #ifdef __APPLE__
-    void *hlib = SDL_LoadObject(mkxp_fs::normalizePath(RSTRING_PTR(libname), 1, 1).c_str());
+    f->lib = SDL_LoadObject(mkxp_fs::normalizePath(RSTRING_PTR(libname), 1, 1).c_str());
 #else
-    void *hlib = SDL_LoadObject(RSTRING_PTR(libname));
+    f->lib = SDL_LoadObject(RSTRING_PTR(libname));
 #endif
-    setPrivateData(self, hlib);
-    void *hfunc = MiniFFI_GetFunctionHandle(hlib, RSTRING_PTR(func));
+    setPrivateData(self, f);
+    void *hfunc = MiniFFI_GetFunctionHandle(f->lib, RSTRING_PTR(func));
 #ifdef __WIN32__
-    if (hlib && !hfunc) {
+    if (f->lib && !hfunc) {
         VALUE func_a = rb_str_new3(func);
         func_a = rb_str_cat(func_a, "A", 1);
-        hfunc = SDL_LoadFunction(hlib, RSTRING_PTR(func_a));
+        hfunc = SDL_LoadFunction(f->lib, RSTRING_PTR(func_a));
     }
 #endif
     if (!hfunc)
         rb_raise(rb_eRuntimeError, "%s", SDL_GetError());
     
-    rb_iv_set(self, "_func", MVAL2RB((mffi_value)hfunc));
+    f->func = (MINIFFI_FUNC)hfunc;
     rb_iv_set(self, "_funcname", func);
     rb_iv_set(self, "_libname", libname);
     
-    VALUE ary_imports = rb_ary_new();
+    long nimports = 0;
     VALUE *entry;
     switch (TYPE(imports)) {
         case T_NIL:
@@ -81,102 +158,33 @@ RB_METHOD(MiniFFI_initialize) {
             entry = RARRAY_PTR(imports);
             for (int i = 0; i < RARRAY_LEN(imports); i++) {
                 SafeStringValue(entry[i]);
-                switch (*(char *)RSTRING_PTR(entry[i])) {
-                    case 'N':
-                    case 'n':
-                    case 'L':
-                    case 'l':
-                        rb_ary_push(ary_imports, INT2FIX(_T_NUMBER));
-                        break;
-                        
-                    case 'P':
-                    case 'p':
-                        rb_ary_push(ary_imports, INT2FIX(_T_POINTER));
-                        break;
-                        
-                    case 'I':
-                    case 'i':
-                        rb_ary_push(ary_imports, INT2FIX(_T_INTEGER));
-                        break;
-                        
-                    case 'B':
-                    case 'b':
-                        rb_ary_push(ary_imports, INT2FIX(_T_BOOL));
-                        break;
-                }
+                MiniFFI_addImport(f, nimports, *(char *)RSTRING_PTR(entry[i]));
             }
             break;
         default:
             SafeStringValue(imports);
             const char *s = RSTRING_PTR(imports);
-            for (int i = 0; i < RSTRING_LEN(imports); i++) {
-                switch (*s++) {
-                    case 'N':
-                    case 'n':
-                    case 'L':
-                    case 'l':
-                        rb_ary_push(ary_imports, INT2FIX(_T_NUMBER));
-                        break;
-                        
-                    case 'P':
-                    case 'p':
-                        rb_ary_push(ary_imports, INT2FIX(_T_POINTER));
-                        break;
-                        
-                    case 'I':
-                    case 'i':
-                        rb_ary_push(ary_imports, INT2FIX(_T_INTEGER));
-                        break;
-                        
-                    case 'B':
-                    case 'b':
-                        rb_ary_push(ary_imports, INT2FIX(_T_BOOL));
-                        break;
-                }
-            }
+            for (int i = 0; i < RSTRING_LEN(imports); i++)
+                MiniFFI_addImport(f, nimports, *s++);
             break;
     }
     
-    if (MINIFFI_MAX_ARGS < RARRAY_LEN(ary_imports))
+    if (MINIFFI_MAX_ARGS < nimports)
         rb_raise(rb_eRuntimeError, "too many parameters: %ld/%ld\n",
-                 RARRAY_LEN(ary_imports), MINIFFI_MAX_ARGS);
+                 nimports, MINIFFI_MAX_ARGS);
     
-    rb_iv_set(self, "_imports", ary_imports);
-    int ex;
-    if (NIL_P(exports)) {
-        ex = _T_VOID;
-    } else {
+    f->nimports = (int)nimports;
+    
+    f->exports = _T_VOID;
+    if (!NIL_P(exports)) {
         SafeStringValue(exports);
-        switch (*RSTRING_PTR(exports)) {
-            case 'V':
-            case 'v':
-                ex = _T_VOID;
-                break;
-                
-            case 'N':
-            case 'n':
-            case 'L':
-            case 'l':
-                ex = _T_NUMBER;
-                break;
-                
-            case 'P':
-            case 'p':
-                ex = _T_POINTER;
-                break;
-                
-            case 'I':
-            case 'i':
-                ex = _T_INTEGER;
-                break;
-                
-            case 'B':
-            case 'b':
-                ex = _T_BOOL;
-                break;
-        }
+        MiniFFI_typeCode(*RSTRING_PTR(exports), f->exports);
     }
-    rb_iv_set(self, "_exports", INT2FIX(ex));
+    
+    f->nogvl = true;
+    if (!NIL_P(opts))
+        f->nogvl = RTEST(rb_hash_lookup2(opts, ID2SYM(rb_intern("nogvl")), Qtrue));
+    
     if (rb_block_given_p())
         rb_yield(self);
     return Qnil;
@@ -196,23 +204,18 @@ void* miniffi_call_cb(void *args) {
 #endif
 
 RB_METHOD(MiniFFI_call) {
+    MiniFFI *f = getPrivateData<MiniFFI>(self);
     MiniFFIFuncArgs param;
 #define params param.params
-    VALUE func = rb_iv_get(self, "_func");
-    VALUE own_imports = rb_iv_get(self, "_imports");
-    VALUE own_exports = rb_iv_get(self, "_exports");
-    MINIFFI_FUNC ApiFunction = (MINIFFI_FUNC)RB2MVAL(func);
-    VALUE args;
-    int items = rb_scan_args(argc, argv, "0*", &args);
-    int nimport = RARRAY_LEN(own_imports);
-    if (items != nimport)
+    int nimport = f->nimports;
+    if (argc != nimport)
         rb_raise(rb_eRuntimeError,
-                 "wrong number of parameters: expected %d, got %d", nimport, items);
+                 "wrong number of parameters: expected %d, got %d", nimport, argc);
     
     for (int i = 0; i < nimport; i++) {
-        VALUE str = rb_ary_entry(args, i);
+        VALUE str = argv[i];
         mffi_value lParam = 0;
-        switch (FIX2INT(rb_ary_entry(own_imports, i))) {
+        switch (f->imports[i]) {
             case _T_POINTER:
                 if (NIL_P(str)) {
                     lParam = 0;
@@ -224,31 +227,36 @@ RB_METHOD(MiniFFI_call) {
                     lParam = (mffi_value)RSTRING_PTR(str);
                 }
                 break;
-                
+            
             case _T_BOOL:
-                rb_bool_arg(rb_ary_entry(args, i), (bool*)&lParam);
+                rb_bool_arg(str, (bool*)&lParam);
                 break;
-                
+            
             case _T_INTEGER:
 #if INTPTR_MAX == INT64_MAX
-                lParam = RB2MVAL(rb_ary_entry(args, i)) & UINT32_MAX;
+                lParam = RB2MVAL(str) & UINT32_MAX;
                 break;
 #endif
             case _T_NUMBER:
             default:
-                lParam = RB2MVAL(rb_ary_entry(args, i));
+                lParam = RB2MVAL(str);
                 break;
         }
         params[i] = lParam;
     }
 #if RAPI_MAJOR >= 2
-    MFFICallCBArgs cb_args {ApiFunction, &param, nimport};
-    mffi_value ret = (mffi_value)rb_thread_call_without_gvl(miniffi_call_cb, &cb_args, 0, 0);
+    mffi_value ret;
+    if (f->nogvl) {
+        MFFICallCBArgs cb_args {f->func, &param, nimport};
+        ret = (mffi_value)rb_thread_call_without_gvl(miniffi_call_cb, &cb_args, 0, 0);
+    } else {
+        ret = miniffi_call_intern(f->func, &param, nimport);
+    }
 #else
-    mffi_value ret = miniffi_call_intern(ApiFunction, &param, nimport);
+    mffi_value ret = miniffi_call_intern(f->func, &param, nimport);
 #endif
     
-    switch (FIX2INT(own_exports)) {
+    switch (f->exports) {
         case _T_NUMBER:
         case _T_INTEGER:
             return MVAL2RB(ret);
@@ -0,0 +1,148 @@
+/*
+** particleemitter-binding.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binding-types.h"
+#include "binding-util.h"
+#include "disposable-binding.h"
+#include "particleemitter.h"
+#include "sharedstate.h"
+#include "viewportelement-binding.h"
+
+#if RAPI_FULL > 187
+DEF_TYPE(ParticleEmitter);
+#else
+DEF_ALLOCFUNC(ParticleEmitter);
+#endif
+
+RB_METHOD(particleEmitterInitialize) {
+    GFX_LOCK;
+    ParticleEmitter *e = viewportElementInitialize<ParticleEmitter>(argc, argv, self);
+
+    /* Property objects are wrapped on first access */
+    setPrivateData(self, e);
+
+    GFX_UNLOCK;
+    return self;
+}
+
+RB_METHOD(particleEmitterUpdate) {
+    RB_UNUSED_PARAM;
+
+    ParticleEmitter *e = getPrivateData<ParticleEmitter>(self);
+
+    GFX_STATE_GUARD_EXC(e->update(););
+
+    return Qnil;
+}
+
+RB_METHOD(particleEmitterEmit) {
+    ParticleEmitter *e = getPrivateData<ParticleEmitter>(self);
+
+    int count;
+    rb_get_typed_args<1>(argc, argv, &count);
+
+    GFX_STATE_GUARD_EXC(e->emit(count););
+
+    return Qnil;
+}
+
+RB_METHOD(particleEmitterClear) {
+    RB_UNUSED_PARAM;
+
+    ParticleEmitter *e = getPrivateData<ParticleEmitter>(self);
+
+    GFX_STATE_GUARD_EXC(e->clear(););
+
+    return Qnil;
+}
+
+RB_METHOD(particleEmitterCount) {
+    RB_UNUSED_PARAM;
+
+    ParticleEmitter *e = getPrivateData<ParticleEmitter>(self);
+
+    int value = 0;
+    GUARD_EXC(value = e->getCount();)
+
+    return rb_fix_new(value);
+}
+
+DEF_GFX_PROP_OBJ_REF(ParticleEmitter, Bitmap, Bitmap, "bitmap")
+DEF_GFX_PROP_OBJ_LAZY(ParticleEmitter, Rect, SrcRect, "src_rect")
+DEF_GFX_PROP_OBJ_LAZY(ParticleEmitter, Color, ColorStart, "color_start")
+DEF_GFX_PROP_OBJ_LAZY(ParticleEmitter, Color, ColorEnd, "color_end")
+
+DEF_GFX_PROP_I(ParticleEmitter, X)
+DEF_GFX_PROP_I(ParticleEmitter, Y)
+DEF_GFX_PROP_I(ParticleEmitter, EmitWidth)
+DEF_GFX_PROP_I(ParticleEmitter, EmitHeight)
+DEF_GFX_PROP_I(ParticleEmitter, MaxParticles)
+DEF_GFX_PROP_I(ParticleEmitter, LifeMin)
+DEF_GFX_PROP_I(ParticleEmitter, LifeMax)
+DEF_GFX_PROP_I(ParticleEmitter, BlendType)
+
+DEF_GFX_PROP_F(ParticleEmitter, Rate)
+DEF_GFX_PROP_F(ParticleEmitter, VelocityX)
+DEF_GFX_PROP_F(ParticleEmitter, VelocityY)
+DEF_GFX_PROP_F(ParticleEmitter, SpreadX)
+DEF_GFX_PROP_F(ParticleEmitter, SpreadY)
+DEF_GFX_PROP_F(ParticleEmitter, GravityX)
+DEF_GFX_PROP_F(ParticleEmitter, GravityY)
+DEF_GFX_PROP_F(ParticleEmitter, ZoomStart)
+DEF_GFX_PROP_F(ParticleEmitter, ZoomEnd)
+
+void particleEmitterBindingInit() {
+    VALUE klass = rb_define_class("ParticleEmitter", rb_cObject);
+#if RAPI_FULL > 187
+    rb_define_alloc_func(klass, classAllocate<&ParticleEmitterType>);
+#else
+    rb_define_alloc_func(klass, ParticleEmitterAllocate);
+#endif
+
+    disposableBindingInit<ParticleEmitter>(klass);
+    viewportElementBindingInit<ParticleEmitter>(klass);
+
+    _rb_define_method(klass, "initialize", particleEmitterInitialize);
+    _rb_define_method(klass, "update", particleEmitterUpdate);
+    _rb_define_method(klass, "emit", particleEmitterEmit);
+    _rb_define_method(klass, "clear", particleEmitterClear);
+    _rb_define_method(klass, "count", particleEmitterCount);
+
+    INIT_PROP_BIND(ParticleEmitter, Bitmap, "bitmap");
+    INIT_PROP_BIND(ParticleEmitter, SrcRect, "src_rect");
+    INIT_PROP_BIND(ParticleEmitter, X, "x");
+    INIT_PROP_BIND(ParticleEmitter, Y, "y");
+    INIT_PROP_BIND(ParticleEmitter, EmitWidth, "emit_width");
+    INIT_PROP_BIND(ParticleEmitter, EmitHeight, "emit_height");
+    INIT_PROP_BIND(ParticleEmitter, Rate, "rate");
+    INIT_PROP_BIND(ParticleEmitter, MaxParticles, "max_particles");
+    INIT_PROP_BIND(ParticleEmitter, LifeMin, "life_min");
+    INIT_PROP_BIND(ParticleEmitter, LifeMax, "life_max");
+    INIT_PROP_BIND(ParticleEmitter, VelocityX, "velocity_x");
+    INIT_PROP_BIND(ParticleEmitter, VelocityY, "velocity_y");
+    INIT_PROP_BIND(ParticleEmitter, SpreadX, "spread_x");
+    INIT_PROP_BIND(ParticleEmitter, SpreadY, "spread_y");
+    INIT_PROP_BIND(ParticleEmitter, GravityX, "gravity_x");
+    INIT_PROP_BIND(ParticleEmitter, GravityY, "gravity_y");
+    INIT_PROP_BIND(ParticleEmitter, ZoomStart, "zoom_start");
+    INIT_PROP_BIND(ParticleEmitter, ZoomEnd, "zoom_end");
+    INIT_PROP_BIND(ParticleEmitter, ColorStart, "color_start");
+    INIT_PROP_BIND(ParticleEmitter, ColorEnd, "color_end");
+    INIT_PROP_BIND(ParticleEmitter, BlendType, "blend_type");
+}
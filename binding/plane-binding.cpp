@@ -23,6 +23,7 @@
 #include "binding-util.h"
 #include "disposable-binding.h"
 #include "plane.h"
+#include "tween-binding.h"
 #include "viewportelement-binding.h"
 
 #if RAPI_FULL > 187
@@ -68,6 +69,7 @@ void planeBindingInit() {
 
   disposableBindingInit<Plane>(klass);
   viewportElementBindingInit<Plane>(klass);
+  tweenableBindingInit<Plane, TweenPlane>(klass);
 
   _rb_define_method(klass, "initialize", planeInitialize);
 
@@ -0,0 +1,355 @@
+/*
+** profiler.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "profiler.h"
+
+#include "binding-util.h"
+#include "config.h"
+#include "debugwriter.h"
+#include "sdl-util.h"
+#include "sharedstate.h"
+
+#include <SDL_timer.h>
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if RAPI_FULL >= 210
+#include <ruby/debug.h>
+
+#if RAPI_FULL >= 330
+/* Samples can be requested from any thread */
+#define PROFILER_TRIGGER_JOB
+#define PROFILER_AVAILABLE
+#elif !defined(__WIN32__)
+/* Samples have to be requested from the Ruby thread,
+ * so the timer thread interrupts it with a signal */
+#include <pthread.h>
+#include <signal.h>
+#define PROFILER_SIGNAL
+#define PROFILER_AVAILABLE
+#endif
+#endif
+
+#ifdef PROFILER_AVAILABLE
+
+#define MAX_DEPTH 256
+
+static std::string rbString(VALUE str)
+{
+    if (NIL_P(str))
+        return std::string();
+    
+    return std::string(RSTRING_PTR(str), RSTRING_LEN(str));
+}
+
+struct Profiler
+{
+    const BoostHash<std::string, std::string> *scriptNames;
+    
+    SDL_Thread *thread;
+    AtomicFlag termReq;
+    int interval;
+    
+    /* Timer ticks since the last sample. A sample delayed by
+     * a long running C function (eg. Graphics.update) counts
+     * for all the ticks it covers */
+    SDL_atomic_t pendingTicks;
+    
+#ifdef PROFILER_TRIGGER_JOB
+    rb_postponed_job_handle_t job;
+#else
+    pthread_t rubyThread;
+    struct sigaction oldAction;
+#endif
+    
+    /* Holds on to every sampled frame, so that no frame
+     * address gets reused for another while profiling */
+    VALUE frameKeeper;
+    
+    std::unordered_map<VALUE, int> frameIds;
+    std::vector<std::string> frameNames;
+    
+    /* Frame ids, root first => ticks */
+    std::map<std::vector<int>, unsigned long> stacks;
+    
+    Profiler()
+        : scriptNames(0),
+          thread(0),
+          interval(10),
+          frameKeeper(Qnil)
+    {
+        SDL_AtomicSet(&pendingTicks, 0);
+        
+#ifdef PROFILER_TRIGGER_JOB
+        job = POSTPONED_JOB_HANDLE_INVALID;
+#endif
+    }
+    
+    std::string describe(VALUE frame)
+    {
+        std::string name = rbString(rb_profile_frame_full_label(frame));
+        std::string file = rbString(rb_profile_frame_path(frame));
+        
+        if (name.empty())
+            name = "(unknown)";
+        
+        if (!file.empty())
+        {
+            if (scriptNames)
+                file = scriptNames->value(file, file);
+            
+            name += " [" + file + "]";
+        }
+        
+        /* ';' separates frames in the output, and
+         * each stack has to stay on one line */
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            if (name[i] == ';')
+                name[i] = ':';
+            else if (name[i] == '\n' || name[i] == '\r')
+                name[i] = ' ';
+        }
+        
+        return name;
+    }
+    
+    int frameId(VALUE frame)
+    {
+        std::unordered_map<VALUE, int>::const_iterator iter = frameIds.find(frame);
+        
+        if (iter != frameIds.end())
+            return iter->second;
+        
+        rb_ary_push(frameKeeper, frame);
+        
+        int id = frameNames.size();
+        frameIds[frame] = id;
+        frameNames.push_back(describe(frame));
+        
+        return id;
+    }
+    
+    std::string write()
+    {
+        const std::string &dataPath = shState->config().customDataPath;
+        std::string path = dataPath.empty() ? "." : dataPath;
+        
+        char stamp[32];
+        time_t now = time(0);
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+        
+        path += "/profile-";
+        path += stamp;
+        path += ".folded";
+        
+        FILE *f = fopen(path.c_str(), "wb");
+        
+        if (!f)
+        {
+            Debug() << "Could not write profile to" << path;
+            return std::string();
+        }
+        
+        std::map<std::vector<int>, unsigned long>::const_iterator iter;
+        
+        for (iter = stacks.begin(); iter != stacks.end(); ++iter)
+        {
+            const std::vector<int> &stack = iter->first;
+            
+            for (size_t i = 0; i < stack.size(); ++i)
+            {
+                if (i > 0)
+                    fputc(';', f);
+                
+                fputs(frameNames[stack[i]].c_str(), f);
+            }
+            
+            fprintf(f, " %lu\n", iter->second);
+        }
+        
+        fclose(f);
+        
+        return path;
+    }
+    
+    /* thread func */
+    void run()
+    {
+        while (!termReq)
+        {
+            SDL_Delay(interval);
+            
+            /* A request is already pending */
+            if (SDL_AtomicAdd(&pendingTicks, 1) != 0)
+                continue;
+            
+#ifdef PROFILER_TRIGGER_JOB
+            rb_postponed_job_trigger(job);
+#else
+            pthread_kill(rubyThread, SIGPROF);
+#endif
+        }
+    }
+};
+
+static Profiler profiler;
+
+/* Runs on the Ruby thread with the GVL held */
+static void takeSample(void *)
+{
+    int ticks = SDL_AtomicSet(&profiler.pendingTicks, 0);
+    
+    /* May still run once after stop() */
+    if (ticks <= 0 || !profiler.thread)
+        return;
+    
+    VALUE frames[MAX_DEPTH];
+    int lines[MAX_DEPTH];
+    int depth = rb_profile_frames(0, MAX_DEPTH, frames, lines);
+    
+    std::vector<int> stack(depth);
+    
+    for (int i = 0; i < depth; ++i)
+        stack[i] = profiler.frameId(frames[depth - 1 - i]);
+    
+    profiler.stacks[stack] += ticks;
+}
+
+#ifdef PROFILER_SIGNAL
+static void onProfSignal(int)
+{
+    rb_postponed_job_register_one(0, takeSample, 0);
+}
+#endif
+
+bool ScriptProfiler::isSupported()
+{
+    return true;
+}
+
+void ScriptProfiler::setScriptNames(const BoostHash<std::string, std::string> *scriptNames)
+{
+    profiler.scriptNames = scriptNames;
+}
+
+bool ScriptProfiler::start(int intervalMs)
+{
+    if (profiler.thread)
+        return false;
+    
+    static bool keeperRegistered = false;
+    
+    if (!keeperRegistered)
+    {
+        rb_gc_register_address(&profiler.frameKeeper);
+        keeperRegistered = true;
+    }
+    
+#ifdef PROFILER_TRIGGER_JOB
+    if (profiler.job == POSTPONED_JOB_HANDLE_INVALID)
+        profiler.job = rb_postponed_job_preregister(0, takeSample, 0);
+    
+    if (profiler.job == POSTPONED_JOB_HANDLE_INVALID)
+    {
+        Debug() << "Could not register the profiler's sample job";
+        return false;
+    }
+#else
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onProfSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    
+    sigaction(SIGPROF, &action, &profiler.oldAction);
+    
+    profiler.rubyThread = pthread_self();
+#endif
+    
+    profiler.frameKeeper = rb_ary_new();
+    profiler.interval = intervalMs > 0 ? intervalMs : 1;
+    SDL_AtomicSet(&profiler.pendingTicks, 0);
+    
+    profiler.termReq.clear();
+    profiler.thread = createSDLThread
+        <Profiler, &Profiler::run>(&profiler, "profiler");
+    
+    return true;
+}
+
+std::string ScriptProfiler::stop()
+{
+    if (!profiler.thread)
+        return std::string();
+    
+    profiler.termReq.set();
+    SDL_WaitThread(profiler.thread, 0);
+    profiler.thread = 0;
+    
+#ifdef PROFILER_SIGNAL
+    sigaction(SIGPROF, &profiler.oldAction, 0);
+#endif
+    
+    std::string path = profiler.write();
+    
+    profiler.stacks.clear();
+    profiler.frameIds.clear();
+    profiler.frameNames.clear();
+    profiler.frameKeeper = Qnil;
+    
+    return path;
+}
+
+bool ScriptProfiler::isRunning()
+{
+    return profiler.thread != 0;
+}
+
+#else
+
+bool ScriptProfiler::isSupported()
+{
+    return false;
+}
+
+void ScriptProfiler::setScriptNames(const BoostHash<std::string, std::string> *)
+{}
+
+bool ScriptProfiler::start(int)
+{
+    return false;
+}
+
+std::string ScriptProfiler::stop()
+{
+    return std::string();
+}
+
+bool ScriptProfiler::isRunning()
+{
+    return false;
+}
+
+#endif // PROFILER_AVAILABLE
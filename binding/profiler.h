@@ -0,0 +1,54 @@
+/*
+** profiler.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "boost-hash.h"
+
+#include <string>
+
+/* Sampling profiler for Ruby script time. A timer thread
+ * requests a sample every few milliseconds, which Ruby then
+ * takes of its own stack at the next safe point. Samples
+ * are written out as collapsed stacks ("a;b;c count" per
+ * line), as read by flamegraph.pl and speedscope */
+namespace ScriptProfiler
+{
+    /* Whether this build's Ruby can be profiled */
+    bool isSupported();
+    
+    /* 'scriptNames' maps the file names script sections are
+     * evaluated under to their titles. It must outlive
+     * the profiler */
+    void setScriptNames(const BoostHash<std::string, std::string> *scriptNames);
+    
+    /* Must be called on the Ruby thread. Returns false
+     * if profiling is unsupported or already running */
+    bool start(int intervalMs);
+    
+    /* Writes the samples taken so far to the data directory
+     * and returns the file's path, or an empty string if not
+     * running or the file couldn't be written */
+    std::string stop();
+    
+    bool isRunning();
+}
+
+#endif // PROFILER_H
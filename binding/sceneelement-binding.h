@@ -45,9 +45,9 @@ RB_METHOD(sceneElementSetZ)
 	SceneElement *se = getPrivateData<C>(self);
 
 	int z;
-	rb_get_args(argc, argv, "i", &z RB_ARG_END);
+	rb_get_typed_args<1>(argc, argv, &z);
 
-	GFX_GUARD_EXC( se->setZ(z); );
+	GFX_STATE_GUARD_EXC( se->setZ(z); );
 
 	return rb_fix_new(z);
 }
@@ -71,9 +71,9 @@ RB_METHOD(sceneElementSetVisible)
 	SceneElement *se = getPrivateData<C>(self);
 
 	bool visible;
-	rb_get_args(argc, argv, "b", &visible RB_ARG_END);
+	rb_get_typed_args<1>(argc, argv, &visible);
 
-	GFX_GUARD_EXC( se->setVisible(visible); );
+	GFX_STATE_GUARD_EXC( se->setVisible(visible); );
 
     return rb_bool_new(visible);
 }
@@ -26,6 +26,7 @@
 #include "sceneelement-binding.h"
 #include "sharedstate.h"
 #include "sprite.h"
+#include "tween-binding.h"
 #include "viewportelement-binding.h"
 
 #if RAPI_FULL > 187
@@ -38,24 +39,18 @@ RB_METHOD(spriteInitialize) {
     GFX_LOCK;
     Sprite *s = viewportElementInitialize<Sprite>(argc, argv, self);
     
+    /* Property objects are wrapped on first access */
     setPrivateData(self, s);
     
-    /* Wrap property objects */
-    s->initDynAttribs();
-    
-    wrapProperty(self, &s->getSrcRect(), "src_rect", RectType);
-    wrapProperty(self, &s->getColor(), "color", ColorType);
-    wrapProperty(self, &s->getTone(), "tone", ToneType);
-    
     GFX_UNLOCK;
     return self;
 }
 
 DEF_GFX_PROP_OBJ_REF(Sprite, Bitmap, Bitmap, "bitmap")
 DEF_GFX_PROP_OBJ_REF(Sprite, Bitmap, Pattern, "pattern")
-DEF_GFX_PROP_OBJ_VAL(Sprite, Rect, SrcRect, "src_rect")
-DEF_GFX_PROP_OBJ_VAL(Sprite, Color, Color, "color")
-DEF_GFX_PROP_OBJ_VAL(Sprite, Tone, Tone, "tone")
+DEF_GFX_PROP_OBJ_LAZY(Sprite, Rect, SrcRect, "src_rect")
+DEF_GFX_PROP_OBJ_LAZY(Sprite, Color, Color, "color")
+DEF_GFX_PROP_OBJ_LAZY(Sprite, Tone, Tone, "tone")
 
 DEF_GFX_PROP_I(Sprite, X)
 DEF_GFX_PROP_I(Sprite, Y)
@@ -72,6 +67,7 @@ DEF_GFX_PROP_I(Sprite, PatternScrollY)
 DEF_GFX_PROP_I(Sprite, WaveAmp)
 DEF_GFX_PROP_I(Sprite, WaveLength)
 DEF_GFX_PROP_I(Sprite, WaveSpeed)
+DEF_GFX_PROP_I(Sprite, AnimationRow)
 
 DEF_GFX_PROP_F(Sprite, ZoomX)
 DEF_GFX_PROP_F(Sprite, ZoomY)
@@ -84,6 +80,78 @@ DEF_GFX_PROP_B(Sprite, Mirror)
 DEF_GFX_PROP_B(Sprite, PatternTile)
 DEF_GFX_PROP_B(Sprite, Invert)
 
+/* Sprite.update_many(sprites, fields, data)
+ * 'fields' names the properties to set (eg. [:x, :y, :opacity]),
+ * 'data' holds one record of packed native floats per sprite
+ * (Array#pack("f*")), one value per field. nil and disposed
+ * entries in 'sprites' are skipped */
+RB_METHOD(spriteUpdateMany) {
+    RB_UNUSED_PARAM;
+    
+    VALUE sprites, fieldsObj, data;
+    rb_get_typed_args<3>(argc, argv, &sprites, &fieldsObj, &data);
+    
+    Check_Type(sprites, T_ARRAY);
+    Check_Type(fieldsObj, T_ARRAY);
+    Check_Type(data, T_STRING);
+    
+    Sprite::Field fields[Sprite::FieldCount];
+    long fieldCount = RARRAY_LEN(fieldsObj);
+    
+    if (fieldCount > Sprite::FieldCount)
+        rb_raise(rb_eArgError, "too many fields (%ld for at most %d)",
+                 fieldCount, (int)Sprite::FieldCount);
+    
+    for (long i = 0; i < fieldCount; ++i) {
+        VALUE field = rb_ary_entry(fieldsObj, i);
+        const char *name = SYMBOL_P(field) ? rb_id2name(SYM2ID(field))
+                                           : StringValueCStr(field);
+        
+        fields[i] = Sprite::fieldFromName(name);
+        
+        if (fields[i] == Sprite::FieldCount)
+            rb_raise(rb_eArgError, "unknown sprite field '%s'", name);
+    }
+    
+    long count = RARRAY_LEN(sprites);
+    long recordSize = fieldCount * (long)sizeof(float);
+    
+    if (RSTRING_LEN(data) < count * recordSize)
+        rb_raise(rb_eArgError, "data holds %ld bytes, %ld needed",
+                 (long)RSTRING_LEN(data), count * recordSize);
+    
+    /* Type check everything up front, so nothing
+     * can raise while the state lock is held */
+    for (long i = 0; i < count; ++i) {
+        VALUE obj = rb_ary_entry(sprites, i);
+        
+        if (!NIL_P(obj))
+            getPrivateDataCheck<Sprite>(obj, SpriteType);
+    }
+    
+    const char *record = RSTRING_PTR(data);
+    float values[Sprite::FieldCount];
+    
+    GFX_STATE_GUARD_EXC(
+        for (long i = 0; i < count; ++i, record += recordSize) {
+            VALUE obj = rb_ary_entry(sprites, i);
+            
+            if (NIL_P(obj))
+                continue;
+            
+            Sprite *s = getPrivateDataCheck<Sprite>(obj, SpriteType);
+            
+            if (!s || s->isDisposed())
+                continue;
+            
+            memcpy(values, record, recordSize);
+            s->setFields(fields, values, fieldCount);
+        }
+    )
+    
+    return Qnil;
+}
+
 RB_METHOD(spriteWidth) {
     RB_UNUSED_PARAM;
     
@@ -106,6 +174,85 @@ RB_METHOD(spriteHeight) {
     return rb_fix_new(value);
 }
 
+/* Changing the bitmap and stepping an animation write src_rect
+ * from the inside. A frozen src_rect, which may be shared with
+ * other Ractors, is left alone: the sprite goes back to a rect of
+ * its own, and the getter wraps a fresh one on its next call */
+static void spriteDetachFrozenSrcRect(VALUE self, Sprite *s) {
+    VALUE rectObj = rb_ivar_get(self, RB_CACHED_ID("src_rect"));
+    
+    if (NIL_P(rectObj) || !OBJ_FROZEN(rectObj))
+        return;
+    
+    GFX_STATE_GUARD_EXC(s->detachSrcRect(););
+    rb_ivar_set(self, RB_CACHED_ID("src_rect"), Qnil);
+}
+
+RB_METHOD(spriteSetBitmap) {
+    spriteDetachFrozenSrcRect(self, getPrivateData<Sprite>(self));
+    
+    return SpriteSetBitmap(argc, argv, self);
+}
+
+RB_METHOD(spriteSetAnimationRow) {
+    spriteDetachFrozenSrcRect(self, getPrivateData<Sprite>(self));
+    
+    return SpriteSetAnimationRow(argc, argv, self);
+}
+
+RB_METHOD(spriteUpdate) {
+    spriteDetachFrozenSrcRect(self, getPrivateData<Sprite>(self));
+    
+    return flashableUpdate<Sprite>(argc, argv, self);
+}
+
+RB_METHOD(spriteAnimate) {
+    Sprite *s = getPrivateData<Sprite>(self);
+    spriteDetachFrozenSrcRect(self, s);
+    
+    int frameW, frameH, frames, frameDuration;
+    bool loop = true;
+    
+    rb_get_args(argc, argv, "iiii|b", &frameW, &frameH, &frames, &frameDuration,
+                &loop RB_ARG_END);
+    
+    GFX_STATE_GUARD_EXC(s->animate(frameW, frameH, frames, frameDuration, loop););
+    
+    return Qnil;
+}
+
+RB_METHOD(spriteStopAnimation) {
+    RB_UNUSED_PARAM;
+    
+    Sprite *s = getPrivateData<Sprite>(self);
+    
+    GUARD_EXC(s->stopAnimation();)
+    
+    return Qnil;
+}
+
+RB_METHOD(spriteIsAnimating) {
+    RB_UNUSED_PARAM;
+    
+    Sprite *s = getPrivateData<Sprite>(self);
+    
+    bool value = false;
+    GUARD_EXC(value = s->isAnimating();)
+    
+    return rb_bool_new(value);
+}
+
+RB_METHOD(spriteAnimationFrame) {
+    RB_UNUSED_PARAM;
+    
+    Sprite *s = getPrivateData<Sprite>(self);
+    
+    int value = 0;
+    GUARD_EXC(value = s->getAnimationFrame();)
+    
+    return rb_fix_new(value);
+}
+
 void spriteBindingInit() {
     VALUE klass = rb_define_class("Sprite", rb_cObject);
 #if RAPI_FULL > 187
@@ -117,10 +264,13 @@ void spriteBindingInit() {
     disposableBindingInit<Sprite>(klass);
     flashableBindingInit<Sprite>(klass);
     viewportElementBindingInit<Sprite>(klass);
+    tweenableBindingInit<Sprite, TweenSprite>(klass);
     
     _rb_define_method(klass, "initialize", spriteInitialize);
+    _rb_define_method(klass, "update", spriteUpdate);
     
-    INIT_PROP_BIND(Sprite, Bitmap, "bitmap");
+    _rb_define_method(klass, "bitmap", SpriteGetBitmap);
+    _rb_define_method(klass, "bitmap=", spriteSetBitmap);
     INIT_PROP_BIND(Sprite, SrcRect, "src_rect");
     INIT_PROP_BIND(Sprite, X, "x");
     INIT_PROP_BIND(Sprite, Y, "y");
@@ -136,6 +286,8 @@ void spriteBindingInit() {
     INIT_PROP_BIND(Sprite, Color, "color");
     INIT_PROP_BIND(Sprite, Tone, "tone");
     
+    rb_define_class_method(klass, "update_many", spriteUpdateMany);
+    
     _rb_define_method(klass, "width", spriteWidth);
     _rb_define_method(klass, "height", spriteHeight);
     
@@ -155,4 +307,11 @@ void spriteBindingInit() {
     INIT_PROP_BIND(Sprite, WaveLength, "wave_length");
     INIT_PROP_BIND(Sprite, WaveSpeed, "wave_speed");
     INIT_PROP_BIND(Sprite, WavePhase, "wave_phase");
+    
+    _rb_define_method(klass, "animate", spriteAnimate);
+    _rb_define_method(klass, "stop_animation", spriteStopAnimation);
+    _rb_define_method(klass, "animating?", spriteIsAnimating);
+    _rb_define_method(klass, "animation_frame", spriteAnimationFrame);
+    _rb_define_method(klass, "animation_row", SpriteGetAnimationRow);
+    _rb_define_method(klass, "animation_row=", spriteSetAnimationRow);
 }
@@ -47,7 +47,7 @@ static void parseArgsTableSizes(int argc, VALUE *argv, int *x, int *y, int *z) {
   }
 }
 #if RAPI_FULL > 187
-DEF_TYPE(Table);
+DEF_VALUE_TYPE(Table);
 #else
 DEF_ALLOCFUNC(Table);
 #endif
@@ -65,6 +65,8 @@ RB_METHOD(tableInitialize) {
 }
 
 RB_METHOD(tableResize) {
+  rb_check_frozen(self);
+
   Table *t = getPrivateData<Table>(self);
 
   int x, y, z;
@@ -112,6 +114,8 @@ RB_METHOD(tableGetAt) {
 }
 
 RB_METHOD(tableSetAt) {
+  rb_check_frozen(self);
+
   Table *t = getPrivateData<Table>(self);
 
   int x, y, z, value;
@@ -40,7 +40,7 @@ RB_METHOD(tilemapAutotilesSet) {
     int i;
     VALUE bitmapObj;
     
-    rb_get_args(argc, argv, "io", &i, &bitmapObj RB_ARG_END);
+    rb_get_typed_args<2>(argc, argv, &i, &bitmapObj);
     
     Bitmap *bitmap = getPrivateDataCheck<Bitmap>(bitmapObj, BitmapType);
     
@@ -55,7 +55,7 @@ RB_METHOD(tilemapAutotilesSet) {
 
 RB_METHOD(tilemapAutotilesGet) {
     int i;
-    rb_get_args(argc, argv, "i", &i RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &i);
     
     if (i < 0 || i > 6)
         return Qnil;
@@ -78,7 +78,7 @@ RB_METHOD(tilemapInitialize) {
     VALUE viewportObj = Qnil;
     Viewport *viewport = 0;
     
-    rb_get_args(argc, argv, "|o", &viewportObj RB_ARG_END);
+    rb_get_typed_args<0>(argc, argv, &viewportObj);
     
     if (!NIL_P(viewportObj))
         viewport = getPrivateDataCheck<Viewport>(viewportObj, ViewportType);
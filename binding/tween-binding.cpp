@@ -0,0 +1,145 @@
+/*
+** tween-binding.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tween-binding.h"
+#include "graphics.h"
+#include "etc.h"
+#include "sharedstate.h"
+
+#include <vector>
+
+static VALUE tweenModule = Qnil;
+
+/* id => [target, block]. Also keeps the
+ * targets alive while they're being tweened */
+static VALUE tweenRegistry() {
+    return rb_iv_get(tweenModule, "tweens");
+}
+
+VALUE tweenStart(int argc, VALUE *argv, VALUE self,
+                 void *target, Disposable *disp, TweenTarget kind) {
+    ID fieldId, easingId = 0;
+    double to;
+    int frames;
+    
+    rb_get_args(argc, argv, "nfi|n", &fieldId, &to, &frames, &easingId RB_ARG_END);
+    
+    const char *fieldName = rb_id2name(fieldId);
+    const TweenField *field = TweenScheduler::findField(kind, fieldName);
+    
+    if (!field)
+        rb_raise(rb_eArgError, "unknown tween field '%s'", fieldName);
+    
+    TweenScheduler::Easing easing = TweenScheduler::Linear;
+    
+    if (easingId) {
+        const char *easingName = rb_id2name(easingId);
+        easing = TweenScheduler::easingFromName(easingName);
+        
+        if (easing == TweenScheduler::EasingCount)
+            rb_raise(rb_eArgError, "unknown easing '%s'", easingName);
+    }
+    
+    if (disp && disp->isDisposed())
+        raiseDisposedAccess(self);
+    
+    VALUE block = rb_block_given_p() ? rb_block_proc() : Qnil;
+    
+    int id = 0;
+    GFX_STATE_GUARD_EXC(id = shState->tweens().add(target, (uintptr_t)self, disp, field, to, frames, easing););
+    
+    rb_hash_aset(tweenRegistry(), INT2FIX(id), rb_ary_new3(2, self, block));
+    
+    return INT2FIX(id);
+}
+
+void tweenDeliverFinished() {
+    VALUE callbacks = Qnil;
+    
+    {
+        std::vector<TweenScheduler::Finished> done;
+        
+        GFX_LOCK;
+        bool any = shState->tweens().takeFinished(done);
+        GFX_UNLOCK;
+        
+        if (!any)
+            return;
+        
+        VALUE registry = tweenRegistry();
+        callbacks = rb_ary_new();
+        
+        for (size_t i = 0; i < done.size(); ++i) {
+            VALUE entry = rb_hash_delete(registry, INT2FIX(done[i].id));
+            
+            if (NIL_P(entry) || !done[i].completed)
+                continue;
+            
+            if (!NIL_P(rb_ary_entry(entry, 1)))
+                rb_ary_push(callbacks, entry);
+        }
+    }
+    
+    /* Callbacks run after all bookkeeping is done,
+     * as they may raise or start new tweens */
+    for (long i = 0; i < RARRAY_LEN(callbacks); ++i) {
+        VALUE entry = rb_ary_entry(callbacks, i);
+        rb_funcall(rb_ary_entry(entry, 1), rb_intern("call"), 1, rb_ary_entry(entry, 0));
+    }
+}
+
+void tweenResetAll() {
+    GFX_LOCK;
+    shState->tweens().clear();
+    GFX_UNLOCK;
+    
+    rb_funcall(tweenRegistry(), rb_intern("clear"), 0);
+}
+
+RB_METHOD(graphicsCancelTween) {
+    RB_UNUSED_PARAM;
+    
+    int id;
+    rb_get_args(argc, argv, "i", &id RB_ARG_END);
+    
+    GFX_LOCK;
+    bool running = shState->tweens().cancel(id);
+    GFX_UNLOCK;
+    
+    rb_hash_delete(tweenRegistry(), INT2FIX(id));
+    
+    return rb_bool_new(running);
+}
+
+void tweenBindingInit() {
+    tweenModule = rb_define_module("Graphics");
+    rb_iv_set(tweenModule, "tweens", rb_hash_new());
+    
+    /* Frozen targets may be shared with other Ractors */
+    shState->tweens().setReadOnlyCheck([](uintptr_t owner) {
+        return OBJ_FROZEN((VALUE)owner) != 0;
+    });
+    
+    _rb_define_module_function(tweenModule, "cancel_tween", graphicsCancelTween);
+    
+    /* Defined here rather than in etcBindingInit, which
+     * marks its methods as safe to call from any Ractor */
+    tweenableBindingInit<Color, TweenColor>(rb_path2class("Color"));
+    tweenableBindingInit<Tone, TweenTone>(rb_path2class("Tone"));
+}
@@ -0,0 +1,53 @@
+/*
+** tween-binding.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TWEENBINDING_H
+#define TWEENBINDING_H
+
+#include "tween.h"
+#include "disposable.h"
+#include "binding-util.h"
+
+/* Parses (field, to, frames, easing = :linear) and
+ * starts the tween, returning its id */
+VALUE tweenStart(int argc, VALUE *argv, VALUE self,
+                 void *target, Disposable *disp, TweenTarget kind);
+
+/* Disposable targets are dropped once disposed,
+ * plain values like Color and Tone never are */
+inline Disposable *tweenDisposable(Disposable *d) { return d; }
+inline Disposable *tweenDisposable(void *) { return 0; }
+
+template<class C, TweenTarget kind>
+RB_METHOD(tweenableTween)
+{
+	rb_check_frozen(self);
+
+	C *c = getPrivateData<C>(self);
+
+	return tweenStart(argc, argv, self, c, tweenDisposable(c), kind);
+}
+
+template<class C, TweenTarget kind>
+static void tweenableBindingInit(VALUE klass)
+{
+	_rb_define_method(klass, "tween", tweenableTween<C, kind>);
+}
+
+#endif // TWEENBINDING_H
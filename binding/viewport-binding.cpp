@@ -25,6 +25,7 @@
 #include "flashable-binding.h"
 #include "sceneelement-binding.h"
 #include "sharedstate.h"
+#include "tween-binding.h"
 #include "viewport.h"
 
 #if RAPI_FULL > 187
@@ -45,7 +46,7 @@ RB_METHOD(viewportInitialize) {
         VALUE rectObj;
         Rect *rect;
         
-        rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+        rb_get_typed_args<1>(argc, argv, &rectObj);
         
         rect = getPrivateDataCheck<Rect>(rectObj, RectType);
         
@@ -54,20 +55,14 @@ RB_METHOD(viewportInitialize) {
     } else {
         int x, y, width, height;
         
-        rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+        rb_get_typed_args<4>(argc, argv, &x, &y, &width, &height);
         GFX_LOCK;
         v = new Viewport(x, y, width, height);
     }
     
+    /* Property objects are wrapped on first access */
     setPrivateData(self, v);
     
-    /* Wrap property objects */
-    v->initDynAttribs();
-    
-    wrapProperty(self, &v->getRect(), "rect", RectType);
-    wrapProperty(self, &v->getColor(), "color", ColorType);
-    wrapProperty(self, &v->getTone(), "tone", ToneType);
-    
     /* 'elements' holds all SceneElements that become children
      * of this viewport, so we can dispose them when the viewport
      * is disposed */
@@ -82,7 +77,7 @@ RB_METHOD(viewportSpriteFinalize)
     
     VALUE objectid;
     
-    rb_get_args(argc, argv, "o", &objectid RB_ARG_END);
+    rb_get_typed_args<1>(argc, argv, &objectid);
     
     if (rgssVer == 1) {
         disposableForgetChild(self, objectid);
@@ -91,9 +86,9 @@ RB_METHOD(viewportSpriteFinalize)
     return Qnil;
 }
 
-DEF_GFX_PROP_OBJ_VAL(Viewport, Rect, Rect, "rect")
-DEF_GFX_PROP_OBJ_VAL(Viewport, Color, Color, "color")
-DEF_GFX_PROP_OBJ_VAL(Viewport, Tone, Tone, "tone")
+DEF_GFX_PROP_OBJ_LAZY(Viewport, Rect, Rect, "rect")
+DEF_GFX_PROP_OBJ_LAZY(Viewport, Color, Color, "color")
+DEF_GFX_PROP_OBJ_LAZY(Viewport, Tone, Tone, "tone")
 
 DEF_GFX_PROP_I(Viewport, OX)
 DEF_GFX_PROP_I(Viewport, OY)
@@ -109,6 +104,7 @@ void viewportBindingInit() {
     disposableBindingInit<Viewport>(klass);
     flashableBindingInit<Viewport>(klass);
     sceneElementBindingInit<Viewport>(klass);
+    tweenableBindingInit<Viewport, TweenViewport>(klass);
     
     _rb_define_method(klass, "initialize", viewportInitialize);
     _rb_define_method(klass, "_sprite_finalizer", viewportSpriteFinalize);
@@ -51,7 +51,7 @@ RB_METHOD(viewportElementSetViewport)
 	VALUE viewportObj = Qnil;
 	Viewport *viewport = 0;
 
-	rb_get_args(argc, argv, "o", &viewportObj RB_ARG_END);
+	rb_get_typed_args<1>(argc, argv, &viewportObj);
 
 	if (!NIL_P(viewportObj))
 		viewport = getPrivateDataCheck<Viewport>(viewportObj, ViewportType);
@@ -77,7 +77,7 @@ viewportElementInitialize(int argc, VALUE *argv, VALUE self)
 	VALUE viewportObj = Qnil;
 	Viewport *viewport = 0;
 
-	rb_get_args(argc, argv, "|o", &viewportObj RB_ARG_END);
+	rb_get_typed_args<0>(argc, argv, &viewportObj);
 
 	if (!NIL_P(viewportObj))
 	{
@@ -21,6 +21,7 @@
 
 #include "binding-util.h"
 #include "disposable-binding.h"
+#include "tween-binding.h"
 #include "viewportelement-binding.h"
 #include "window.h"
 
@@ -34,12 +35,9 @@ RB_METHOD(windowInitialize) {
     GFX_LOCK;
     Window *w = viewportElementInitialize<Window>(argc, argv, self);
     
+    /* 'cursor_rect' is wrapped on first access */
     setPrivateData(self, w);
     
-    w->initDynAttribs();
-    
-    wrapProperty(self, &w->getCursorRect(), "cursor_rect", RectType);
-    
     GFX_UNLOCK;
     return self;
 }
@@ -56,7 +54,7 @@ RB_METHOD(windowUpdate) {
 
 DEF_GFX_PROP_OBJ_REF(Window, Bitmap, Windowskin, "windowskin")
 DEF_GFX_PROP_OBJ_REF(Window, Bitmap, Contents, "contents")
-DEF_GFX_PROP_OBJ_VAL(Window, Rect, CursorRect, "cursor_rect")
+DEF_GFX_PROP_OBJ_LAZY(Window, Rect, CursorRect, "cursor_rect")
 
 DEF_GFX_PROP_B(Window, Stretch)
 DEF_GFX_PROP_B(Window, Active)
@@ -82,6 +80,7 @@ void windowBindingInit() {
     
     disposableBindingInit<Window>(klass);
     viewportElementBindingInit<Window>(klass);
+    tweenableBindingInit<Window, TweenWindow>(klass);
     
     _rb_define_method(klass, "initialize", windowInitialize);
     _rb_define_method(klass, "update", windowUpdate);
@@ -21,6 +21,7 @@
 
 #include "binding-util.h"
 #include "disposable-binding.h"
+#include "tween-binding.h"
 #include "viewportelement-binding.h"
 #include "windowvx.h"
 
@@ -44,7 +45,7 @@ RB_METHOD(windowVXInitialize) {
     x = y = width = height = 0;
 
     if (argc == 4)
-      rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+      rb_get_typed_args<4>(argc, argv, &x, &y, &width, &height);
 
     w = new WindowVX(x, y, width, height);
   } else {
@@ -85,7 +86,7 @@ RB_METHOD(windowVXMove) {
   WindowVX *w = getPrivateData<WindowVX>(self);
 
   int x, y, width, height;
-  rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+  rb_get_typed_args<4>(argc, argv, &x, &y, &width, &height);
 
     GFX_LOCK;
   w->move(x, y, width, height);
@@ -143,6 +144,7 @@ void windowVXBindingInit() {
 
   disposableBindingInit<WindowVX>(klass);
   viewportElementBindingInit<WindowVX>(klass);
+  tweenableBindingInit<WindowVX, TweenWindowVX>(klass);
 
   _rb_define_method(klass, "initialize", windowVXInitialize);
   _rb_define_method(klass, "update", windowVXUpdate);
@@ -0,0 +1,21 @@
+
+uniform sampler2D texture;
+uniform sampler2D texU;
+uniform sampler2D texV;
+
+varying vec2 v_texCoord;
+
+/* BT.601 limited range, which is what Theora encodes */
+const vec3 yuvOffset = vec3(-0.0625, -0.5, -0.5);
+const vec3 rCoeff = vec3(1.164,  0.000,  1.596);
+const vec3 gCoeff = vec3(1.164, -0.391, -0.813);
+const vec3 bCoeff = vec3(1.164,  2.018,  0.000);
+
+void main()
+{
+	vec3 yuv = vec3(texture2D(texture, v_texCoord).r,
+	                texture2D(texU, v_texCoord).r,
+	                texture2D(texV, v_texCoord).r) + yuvOffset;
+
+	gl_FragColor = vec4(dot(yuv, rCoeff), dot(yuv, gCoeff), dot(yuv, bCoeff), 1.0);
+}
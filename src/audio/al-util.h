@@ -158,6 +158,11 @@ namespace Source
 		return getInteger(id, AL_SOURCE_STATE);
 	}
 
+	inline ALint getSampleOffset(Source::ID id)
+	{
+		return getInteger(id, AL_SAMPLE_OFFSET);
+	}
+
 	inline ALfloat getSecOffset(Source::ID id)
 	{
 		ALfloat value;
@@ -23,6 +23,9 @@
 #define ALDATASOURCE_H
 
 #include "al-util.h"
+#include "gainramp.h"
+
+#include <string.h>
 
 struct ALDataSource
 {
@@ -51,6 +54,39 @@ struct ALDataSource
 
 	/* Returns false if not supported */
 	virtual bool setPitch(float value) = 0;
+
+	/* Fade applied to all decoded output. Only
+	 * touched from the stream's servicing task */
+	GainRamp gainRamp;
+
+protected:
+	/* Runs 'gainRamp' over freshly decoded data. Returns the
+	 * byte size that should be uploaded, and turns 'status' into
+	 * EndOfStream once a terminating fade has run its course */
+	uint32_t applyGainRamp(void *data, uint32_t size, int channels,
+	                       SDL_AudioFormat format, Status &status)
+	{
+		if (!gainRamp.active())
+			return size;
+
+		uint32_t frameSize = SDL_AUDIO_BITSIZE(format) / 8 * channels;
+		uint32_t frames = size / frameSize;
+		uint32_t kept = gainRamp.apply(data, frames, channels, format);
+
+		if (!gainRamp.finished())
+			return size;
+
+		status = EndOfStream;
+
+		/* Never hand out an empty buffer */
+		if (kept == 0)
+		{
+			memset(data, (format == AUDIO_U8) ? 0x80 : 0, frameSize);
+			kept = 1;
+		}
+
+		return kept * frameSize;
+	}
 };
 
 ALDataSource *createSDLSource(SDL_RWops &ops,
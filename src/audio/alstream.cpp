@@ -30,19 +30,32 @@
 #include "fluid-fun.h"
 #include "sdl-util.h"
 #include "debugwriter.h"
+#include "audio.h"
 
 #include <SDL_mutex.h>
-#include <SDL_thread.h>
 #include <SDL_timer.h>
 
+#include <algorithm>
+#include <assert.h>
+
 ALStream::ALStream(LoopMode loopMode,
-		           const std::string &threadId)
+		           const std::string &id,
+		           AudioScheduler &scheduler)
 	: looped(loopMode == Looped),
 	  state(Closed),
 	  source(0),
-	  thread(0),
+	  scheduler(scheduler),
+	  name(id),
 	  preemptPause(false),
-      pitch(1.0f)
+      pitch(1.0f),
+	  curOps(0),
+	  streamTask(this),
+	  prefetchTask(this),
+	  lastBufMs(0),
+	  queuedFrames(0),
+	  queueDepth(STREAM_BUFS),
+	  lastUnderrun(0),
+	  sourcePitch(1.0f)
 {
 	alSrc = AL::Source::gen();
 
@@ -51,25 +64,53 @@ ALStream::ALStream(LoopMode loopMode,
 	AL::Source::detachBuffer(alSrc);
 	AL::Source::initializePanMode(alSrc); // Initialize pan mode
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	for (int i = 0; i < STREAM_BUF_POOL; ++i)
 		alBuf[i] = AL::Buffer::gen();
 
+	freeBufs.assign(alBuf, alBuf + STREAM_BUF_POOL);
+	bufMut = SDL_CreateMutex();
+
 	pauseMut = SDL_CreateMutex();
 
-	threadName = std::string("al_stream (") + threadId + ")";
+	fadeReq.mut = SDL_CreateMutex();
+	fadeReq.type = NoFade;
+	fadeReq.volume = 1.0f;
+	fadeReq.gainMul = 1.0f;
+
+	queuedFade.active = false;
+	playedFrames = 0;
+
+	stats.mut = SDL_CreateMutex();
+	stats.underruns = 0;
+	stats.fillMs = 0;
+	stats.decodedBufs = 0;
+	stats.decodeTotalUs = 0;
+	stats.decodeMaxUs = 0;
+
+	pf.mut = SDL_CreateMutex();
+	pf.opsSlot = 1;
+	pf.done = false;
+	pf.source = 0;
 }
 
 ALStream::~ALStream()
 {
+	scheduler.cancel(prefetchTask);
+	discardPrefetch();
+
 	close();
 
 	AL::Source::clearQueue(alSrc);
 	AL::Source::del(alSrc);
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	for (int i = 0; i < STREAM_BUF_POOL; ++i)
 		AL::Buffer::del(alBuf[i]);
 
 	SDL_DestroyMutex(pauseMut);
+	SDL_DestroyMutex(fadeReq.mut);
+	SDL_DestroyMutex(stats.mut);
+	SDL_DestroyMutex(bufMut);
+	SDL_DestroyMutex(pf.mut);
 }
 
 void ALStream::close()
@@ -101,12 +142,27 @@ void ALStream::open(const std::string &filename)
 	case Stopped:
 		closeSource();
 	case Closed:
-		openSource(filename);
+		if (!adoptPrefetch(filename))
+			openSource(filename);
 	}
 
 	state = Stopped;
 }
 
+void ALStream::prefetch(const std::string &filename)
+{
+	/* Waits out a prefetch that's still running */
+	scheduler.cancel(prefetchTask);
+	discardPrefetch();
+
+	SDL_LockMutex(pf.mut);
+	pf.filename = filename;
+	pf.opsSlot = 1 - curOps;
+	SDL_UnlockMutex(pf.mut);
+
+	scheduler.post(prefetchTask);
+}
+
 void ALStream::stop()
 {
 	checkStopped();
@@ -163,9 +219,43 @@ void ALStream::pause()
 	state = Paused;
 }
 
+void ALStream::fadeOut(uint32_t duration)
+{
+	SDL_LockMutex(fadeReq.mut);
+
+	fadeReq.type = FadeOutReq;
+	fadeReq.duration = duration;
+	fadeReq.ticks = SDL_GetTicks();
+
+	SDL_UnlockMutex(fadeReq.mut);
+}
+
+void ALStream::fadeIn(uint32_t duration)
+{
+	SDL_LockMutex(fadeReq.mut);
+
+	fadeReq.type = FadeInReq;
+	fadeReq.duration = duration;
+	fadeReq.ticks = SDL_GetTicks();
+
+	SDL_UnlockMutex(fadeReq.mut);
+}
+
+void ALStream::cancelFade()
+{
+	SDL_LockMutex(fadeReq.mut);
+	fadeReq.type = CancelFadeReq;
+	SDL_UnlockMutex(fadeReq.mut);
+}
+
 void ALStream::setVolume(float value)
 {
-	AL::Source::setVolume(alSrc, value);
+	SDL_LockMutex(fadeReq.mut);
+
+	fadeReq.volume = value;
+	AL::Source::setVolume(alSrc, value * fadeReq.gainMul);
+
+	SDL_UnlockMutex(fadeReq.mut);
 }
 
 void ALStream::setPitch(float value)
@@ -173,9 +263,17 @@ void ALStream::setPitch(float value)
 	/* If the source supports setting pitch natively,
 	 * we don't have to do it via OpenAL */
 	if (source && source->setPitch(value))
-		AL::Source::setPitch(alSrc, 1.0f);
+	{
+		pitch = 1.0f;
+		sourcePitch = value;
+	}
 	else
-		AL::Source::setPitch(alSrc, value);
+	{
+		pitch = value;
+		sourcePitch = 1.0f;
+	}
+
+	AL::Source::setPitch(alSrc, pitch);
 }
 
 void ALStream::setPan(float value)
@@ -203,6 +301,11 @@ float ALStream::queryOffset()
 void ALStream::closeSource()
 {
 	delete source;
+
+	for (size_t i = 0; i < preparedBufs.size(); ++i)
+		returnBuffer(preparedBufs[i].buf);
+
+	preparedBufs.clear();
 }
 
 struct ALStreamOpenHandler : FileSystem::OpenHandler
@@ -262,7 +365,7 @@ struct ALStreamOpenHandler : FileSystem::OpenHandler
 
 void ALStream::openSource(const std::string &filename)
 {
-	ALStreamOpenHandler handler(srcOps, looped);
+	ALStreamOpenHandler handler(srcOps[curOps], looped);
 	shState->fileSystem().openRead(handler, filename.c_str());
 	source = handler.source;
 	needsRewind.clear();
@@ -277,23 +380,87 @@ void ALStream::openSource(const std::string &filename)
 	}
 }
 
-void ALStream::stopStream()
+/* Takes over the prefetched source if it is for 'filename' */
+bool ALStream::adoptPrefetch(const std::string &filename)
 {
-	threadTermReq.set();
+	SDL_LockMutex(pf.mut);
+	bool match = !pf.filename.empty() && pf.filename == filename;
+	SDL_UnlockMutex(pf.mut);
+
+	if (!match)
+		return false;
+
+	/* If it's still running, waiting for it is no
+	 * slower than opening the file all over again */
+	scheduler.cancel(prefetchTask);
+
+	SDL_LockMutex(pf.mut);
 
-	if (thread)
+	bool ready = pf.done && pf.source;
+
+	if (ready)
 	{
-		SDL_WaitThread(thread, 0);
-		thread = 0;
-		needsRewind.set();
+		source = pf.source;
+		curOps = pf.opsSlot;
+		preparedBufs.swap(pf.bufs);
+
+		pf.source = 0;
+		pf.filename.clear();
+		pf.done = false;
+	}
+
+	SDL_UnlockMutex(pf.mut);
+
+	if (!ready)
+	{
+		discardPrefetch();
+		return false;
 	}
 
-	/* Need to stop the source _after_ the thread has terminated,
-	 * because it might have accidentally started it again before
-	 * seeing the term request */
+	needsRewind.clear();
+
+	return true;
+}
+
+/* Must not be called while the prefetch task is scheduled */
+void ALStream::discardPrefetch()
+{
+	SDL_LockMutex(pf.mut);
+
+	delete pf.source;
+	pf.source = 0;
+
+	for (size_t i = 0; i < pf.bufs.size(); ++i)
+		returnBuffer(pf.bufs[i].buf);
+
+	pf.bufs.clear();
+	pf.filename.clear();
+	pf.done = false;
+
+	SDL_UnlockMutex(pf.mut);
+}
+
+void ALStream::stopStream()
+{
+	if (scheduler.isScheduled(streamTask))
+		needsRewind.set();
+
+	scheduler.cancel(streamTask);
+
+	/* Need to stop the source _after_ the task has been cancelled,
+	 * because a running refill might have accidentally started it
+	 * again */
 	AL::Source::stop(alSrc);
 
 	procFrames = 0;
+
+	/* Any fade dies with the stream */
+	source->gainRamp.clear();
+	resetQueuedFade();
+
+	SDL_LockMutex(fadeReq.mut);
+	fadeReq.type = NoFade;
+	SDL_UnlockMutex(fadeReq.mut);
 }
 
 void ALStream::startStream(float offset)
@@ -303,13 +470,20 @@ void ALStream::startStream(float offset)
 	preemptPause = false;
 	streamInited.clear();
 	sourceExhausted.clear();
-	threadTermReq.clear();
 
 	startOffset = offset;
 	procFrames = offset * source->sampleRate();
+	lastBufMs = 0;
+	queuedFrames = 0;
+	playedFrames = 0;
+
+	/* Everything that was queued is free again */
+	for (size_t i = 0; i < queuedBufs.size(); ++i)
+		returnBuffer(queuedBufs[i]);
+
+	queuedBufs.clear();
 
-	thread = createSDLThread
-		<ALStream, &ALStream::streamData>(this, threadName);
+	scheduler.schedule(streamTask);
 }
 
 void ALStream::pauseStream()
@@ -344,7 +518,7 @@ void ALStream::checkStopped()
 	if (state != Playing)
 		return;
 
-	/* If streaming thread hasn't queued up
+	/* If stream task hasn't queued up
 	 * buffers yet there's not point in querying
 	 * the AL source */
 	if (!streamInited)
@@ -363,121 +537,428 @@ void ALStream::checkStopped()
 	state = Stopped;
 }
 
-/* thread func */
-void ALStream::streamData()
+static uint32_t bufferFrames(AL::Buffer::ID buf)
 {
-	/* Fill up queue */
-	bool firstBuffer = true;
-	ALDataSource::Status status;
+	ALint bits = AL::Buffer::getBits(buf);
+	ALint size = AL::Buffer::getSize(buf);
+	ALint chan = AL::Buffer::getChannels(buf);
+
+	if (bits == 0 || chan == 0)
+		return 0;
+
+	return (size / (bits / 8)) / chan;
+}
+
+uint32_t ALStream::msToFrames(uint32_t ms)
+{
+	/* OpenAL side pitch changes the playback speed */
+	return static_cast<uint64_t>(ms) * source->sampleRate() * pitch / 1000;
+}
+
+void ALStream::applyFadeRequest()
+{
+	SDL_LockMutex(fadeReq.mut);
+
+	FadeRequest type = fadeReq.type;
+	uint32_t duration = fadeReq.duration;
+	uint32_t elapsed = SDL_GetTicks() - fadeReq.ticks;
+	float gainMul = fadeReq.gainMul;
+	fadeReq.type = NoFade;
+
+	SDL_UnlockMutex(fadeReq.mut);
+
+	GainRamp &ramp = source->gainRamp;
+
+	switch (type)
+	{
+	case NoFade :
+		return;
+
+	case CancelFadeReq :
+		ramp.clear();
+		resetQueuedFade();
+		return;
+
+	case FadeInReq :
+		resetQueuedFade();
+		ramp.start(GainRamp::Quadratic, 0.0f, 1.0f, msToFrames(duration), false);
+		return;
+
+	case FadeOutReq :
+	{
+		/* Audio that is already queued can't be altered anymore,
+		 * so the first part of the fade ramps the source gain over
+		 * it. The rest is rendered into the audio decoded after it,
+		 * on top of the gain that first part left off at, so the
+		 * combined curve is a straight line down to silence */
+		uint32_t played = AL::Source::getSampleOffset(alSrc);
+		uint32_t queued = (queuedFrames > played) ? queuedFrames - played : 0;
+		uint32_t aheadMs = static_cast<uint64_t>(queued) * 1000 / (source->sampleRate() * pitch);
+		uint32_t remaining = (duration > elapsed) ? duration - elapsed : 0;
+
+		queuedFade.active = true;
+		queuedFade.start = playedFrames + played;
+		queuedFade.from = gainMul;
+
+		if (remaining > aheadMs)
+		{
+			queuedFade.length = queued;
+			queuedFade.to = gainMul * (remaining - aheadMs) / remaining;
+			remaining -= aheadMs;
+		}
+		else
+		{
+			/* Silent before the queued audio even runs out */
+			queuedFade.length = aheadMs ? static_cast<uint64_t>(queued) * remaining / aheadMs : 0;
+			queuedFade.to = 0.0f;
+			remaining = 0;
+		}
+
+		ramp.start(GainRamp::Linear, ramp.currentGain(), 0.0f,
+		           msToFrames(remaining), true);
+		return;
+	}
+	}
+}
 
-	if (threadTermReq)
+/* Advances the source gain ramp of a fade out to the
+ * current playback position */
+void ALStream::updateQueuedFade()
+{
+	if (!queuedFade.active)
 		return;
 
-	//if (needsRewind)
-		source->seekToOffset(startOffset);
+	uint64_t pos = playedFrames + AL::Source::getSampleOffset(alSrc);
+	uint64_t prog = (pos > queuedFade.start) ? pos - queuedFade.start : 0;
+	float mul;
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	if (prog >= queuedFade.length)
+	{
+		mul = queuedFade.to;
+		queuedFade.active = false;
+	}
+	else
 	{
-		if (threadTermReq)
-			return;
+		mul = queuedFade.from + (queuedFade.to - queuedFade.from)
+		    * (static_cast<float>(prog) / queuedFade.length);
+	}
 
-		AL::Buffer::ID buf = alBuf[i];
+	SDL_LockMutex(fadeReq.mut);
 
-		status = source->fillBuffer(buf);
+	fadeReq.gainMul = mul;
+	AL::Source::setVolume(alSrc, fadeReq.volume * mul);
 
-		if (status == ALDataSource::Error)
-			return;
+	SDL_UnlockMutex(fadeReq.mut);
+}
 
-		AL::Source::queueBuffer(alSrc, buf);
+void ALStream::resetQueuedFade()
+{
+	queuedFade.active = false;
 
-		if (firstBuffer)
-		{
-			resumeStream();
+	SDL_LockMutex(fadeReq.mut);
 
-			firstBuffer = false;
-			streamInited.set();
-		}
+	fadeReq.gainMul = 1.0f;
+	AL::Source::setVolume(alSrc, fadeReq.volume);
 
-		if (threadTermReq)
-			return;
+	SDL_UnlockMutex(fadeReq.mut);
+}
 
-		if (status == ALDataSource::EndOfStream)
-		{
-			sourceExhausted.set();
+AL::Buffer::ID ALStream::takeBuffer()
+{
+	SDL_LockMutex(bufMut);
+
+	/* The pool is sized so that this can't run dry */
+	assert(!freeBufs.empty());
+
+	AL::Buffer::ID buf = freeBufs.back();
+	freeBufs.pop_back();
+
+	SDL_UnlockMutex(bufMut);
+
+	return buf;
+}
+
+void ALStream::returnBuffer(AL::Buffer::ID buf)
+{
+	SDL_LockMutex(bufMut);
+	freeBufs.push_back(buf);
+	SDL_UnlockMutex(bufMut);
+}
+
+/* Decode the next chunk into 'buf' and append it to the
+ * queue. Returns false if the data source failed */
+bool ALStream::queueBuffer(AL::Buffer::ID buf)
+{
+	uint64_t start = SDL_GetPerformanceCounter();
+	ALDataSource::Status status = source->fillBuffer(buf);
+	uint64_t end = SDL_GetPerformanceCounter();
+
+	uint32_t decodeUs = (end - start) * 1000000 / SDL_GetPerformanceFrequency();
+
+	SDL_LockMutex(stats.mut);
+	++stats.decodedBufs;
+	stats.decodeTotalUs += decodeUs;
+	stats.decodeMaxUs = std::max(stats.decodeMaxUs, decodeUs);
+	SDL_UnlockMutex(stats.mut);
+
+	if (status == ALDataSource::Error)
+	{
+		returnBuffer(buf);
+		sourceExhausted.set();
+
+		return false;
+	}
+
+	enqueue(buf, status == ALDataSource::WrapAround,
+	        status == ALDataSource::EndOfStream);
+
+	return true;
+}
+
+void ALStream::enqueue(AL::Buffer::ID buf, bool wrapped, bool ended)
+{
+	AL::Source::queueBuffer(alSrc, buf);
+	queuedBufs.push_back(buf);
+	queuedFrames += bufferFrames(buf);
+	lastBufMs = bufferFrames(buf) * 1000 / source->sampleRate();
+
+	/* If this was the last buffer before the data
+	 * source loop wrapped around again, mark it as
+	 * such so we can catch it and reset the processed
+	 * sample count once it gets unqueued */
+	if (wrapped)
+		lastBuf = buf;
+
+	if (ended)
+		sourceExhausted.set();
+
+	if (!streamInited)
+	{
+		resumeStream();
+		streamInited.set();
+	}
+}
+
+/* Fill up queue. Returns false if the stream
+ * shouldn't be serviced anymore */
+bool ALStream::fillQueue()
+{
+	/* Buffers decoded by a prefetch are only good for playback
+	 * from the start, at the pitch they were rendered with */
+	bool usePrepared = !preparedBufs.empty()
+	                && startOffset == 0
+	                && sourcePitch == 1.0f;
+
+	if (usePrepared)
+	{
+		for (size_t i = 0; i < preparedBufs.size(); ++i)
+			enqueue(preparedBufs[i].buf, preparedBufs[i].wrapped,
+			        preparedBufs[i].ended);
+	}
+	else
+	{
+		for (size_t i = 0; i < preparedBufs.size(); ++i)
+			returnBuffer(preparedBufs[i].buf);
+
+		//if (needsRewind)
+			source->seekToOffset(startOffset);
+	}
+
+	preparedBufs.clear();
+
+	applyFadeRequest();
+
+	while (!sourceExhausted && queuedBufs.size() < queueDepth)
+		if (!queueBuffer(takeBuffer()))
+			return false;
+
+	return true;
+}
+
+/* Refill and queue up consumed buffers again. Returns
+ * false if the stream shouldn't be serviced anymore */
+bool ALStream::refillQueue()
+{
+	ALint procBufs = AL::Source::getProcBufferCount(alSrc);
+
+	applyFadeRequest();
+
+	while (procBufs--)
+	{
+		AL::Buffer::ID buf = AL::Source::unqueueBuffer(alSrc);
+
+		/* If something went wrong, try again later */
+		if (buf == AL::Buffer::ID(0))
 			break;
+
+		uint32_t frames = bufferFrames(buf);
+		queuedFrames -= frames;
+		playedFrames += frames;
+		queuedBufs.pop_front();
+
+		if (buf == lastBuf)
+		{
+			/* Reset the processed sample count so
+			 * querying the playback offset returns 0.0 again */
+			procFrames = source->loopStartFrames();
+			lastBuf = AL::Buffer::ID(0);
 		}
+		else
+		{
+			/* Add the frame count contained in this
+			 * buffer to the total count */
+			procFrames += frames;
+		}
+
+		returnBuffer(buf);
+	}
+
+	/* Top the queue back up, to a depth that
+	 * might have changed since the last time */
+	while (!sourceExhausted && queuedBufs.size() < queueDepth)
+		if (!queueBuffer(takeBuffer()))
+			return false;
+
+	/* The queue ran dry before we got to refill it. Start
+	 * playing again, and buffer further ahead from now on */
+	if (!queuedBufs.empty() && AL::Source::getState(alSrc) == AL_STOPPED)
+	{
+		AL::Source::play(alSrc);
+
+		SDL_LockMutex(stats.mut);
+
+		++stats.underruns;
+
+		if (queueDepth < STREAM_BUFS_MAX)
+			++queueDepth;
+
+		SDL_UnlockMutex(stats.mut);
+
+		lastUnderrun = SDL_GetTicks();
 	}
 
-	/* Wait for buffers to be consumed, then
-	 * refill and queue them up again */
-	while (true)
+	return true;
+}
+
+void ALStream::adaptQueueDepth()
+{
+	uint32_t now = SDL_GetTicks();
+
+	/* Excess buffers are dropped from the
+	 * queue as they get unqueued */
+	if (queueDepth > STREAM_BUFS && now - lastUnderrun > STREAM_SHRINK_MS)
 	{
-		shState->rtData().syncPoint.passSecondarySync();
+		SDL_LockMutex(stats.mut);
+		--queueDepth;
+		SDL_UnlockMutex(stats.mut);
 
-		ALint procBufs = AL::Source::getProcBufferCount(alSrc);
+		lastUnderrun = now;
+	}
 
-		while (procBufs--)
-		{
-			if (threadTermReq)
-				break;
+	uint32_t played = AL::Source::getSampleOffset(alSrc);
+	uint32_t ahead = (queuedFrames > played) ? queuedFrames - played : 0;
 
-			AL::Buffer::ID buf = AL::Source::unqueueBuffer(alSrc);
+	SDL_LockMutex(stats.mut);
+	stats.fillMs = static_cast<uint64_t>(ahead) * 1000 / source->sampleRate();
+	SDL_UnlockMutex(stats.mut);
+}
 
-			/* If something went wrong, try again later */
-			if (buf == AL::Buffer::ID(0))
-				break;
+void ALStream::getStats(AudioStreamStats &out)
+{
+	out.name = name;
 
-			if (buf == lastBuf)
-			{
-				/* Reset the processed sample count so
-				 * querying the playback offset returns 0.0 again */
-				procFrames = source->loopStartFrames();
-				lastBuf = AL::Buffer::ID(0);
-			}
-			else
-			{
-				/* Add the frame count contained in this
-				 * buffer to the total count */
-				ALint bits = AL::Buffer::getBits(buf);
-				ALint size = AL::Buffer::getSize(buf);
-				ALint chan = AL::Buffer::getChannels(buf);
-
-				if (bits != 0 && chan != 0)
-					procFrames += ((size / (bits / 8)) / chan);
-			}
+	SDL_LockMutex(stats.mut);
+
+	out.bufferCount = queueDepth;
+
+	out.underruns = stats.underruns;
+	out.fillMs = stats.fillMs;
+	out.decodedBuffers = stats.decodedBufs;
+	out.decodeAvgUs = stats.decodedBufs ? stats.decodeTotalUs / stats.decodedBufs : 0;
+	out.decodeMaxUs = stats.decodeMaxUs;
+
+	SDL_UnlockMutex(stats.mut);
+}
+
+/* Scheduler task func */
+int ALStream::streamData()
+{
+	bool keepGoing = streamInited ? refillQueue() : fillQueue();
+
+	if (!keepGoing)
+		return -1;
+
+	adaptQueueDepth();
+	updateQueuedFade();
+
+	/* Source gain ramps need finer steps to stay smooth */
+	if (queuedFade.active)
+		return AUDIO_SLEEP;
+
+	/* With the queue filled up, waking up a few times
+	 * per buffer period leaves plenty of headroom against
+	 * underruns, even at raised pitch */
+	return std::max<uint32_t>(AUDIO_SLEEP, lastBufMs / 4);
+}
+
+/* Background task func. Opens and decodes on its own thread,
+ * publishing the source and its buffers only once complete */
+int ALStream::prefetchData()
+{
+	SDL_LockMutex(pf.mut);
+	std::string filename = pf.filename;
+	int slot = pf.opsSlot;
+	SDL_UnlockMutex(pf.mut);
 
-			if (sourceExhausted)
-				continue;
+	ALStreamOpenHandler handler(srcOps[slot], looped);
 
-			status = source->fillBuffer(buf);
+	try
+	{
+		shState->fileSystem().openRead(handler, filename.c_str());
+	}
+	catch (const Exception &e)
+	{
+		handler.errorMsg = e.msg;
+	}
+
+	ALDataSource *src = handler.source;
+	std::vector<PreparedBuf> bufs;
+
+	if (src)
+	{
+		src->seekToOffset(0);
+
+		for (int i = 0; i < STREAM_BUFS; ++i)
+		{
+			AL::Buffer::ID buf = takeBuffer();
+			ALDataSource::Status status = src->fillBuffer(buf);
 
 			if (status == ALDataSource::Error)
 			{
-				sourceExhausted.set();
-				return;
+				returnBuffer(buf);
+				break;
 			}
 
-			AL::Source::queueBuffer(alSrc, buf);
+			PreparedBuf pb;
+			pb.buf = buf;
+			pb.wrapped = (status == ALDataSource::WrapAround);
+			pb.ended = (status == ALDataSource::EndOfStream);
+			bufs.push_back(pb);
 
-			/* In case of buffer underrun,
-			 * start playing again */
-			if (AL::Source::getState(alSrc) == AL_STOPPED)
-				AL::Source::play(alSrc);
-
-			/* If this was the last buffer before the data
-			 * source loop wrapped around again, mark it as
-			 * such so we can catch it and reset the processed
-			 * sample count once it gets unqueued */
-			if (status == ALDataSource::WrapAround)
-				lastBuf = buf;
-
-			if (status == ALDataSource::EndOfStream)
-				sourceExhausted.set();
+			if (pb.ended)
+				break;
 		}
+	}
+	else
+	{
+		Debug() << "Unable to prefetch audio stream:" << filename << handler.errorMsg;
+	}
 
-		if (threadTermReq)
-			break;
+	SDL_LockMutex(pf.mut);
+	pf.source = src;
+	pf.bufs.swap(bufs);
+	pf.done = true;
+	SDL_UnlockMutex(pf.mut);
 
-		SDL_Delay(AUDIO_SLEEP);
-	}
+	return -1;
 }
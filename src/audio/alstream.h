@@ -23,15 +23,31 @@
 #define ALSTREAM_H
 
 #include "al-util.h"
+#include "audioscheduler.h"
 #include "sdl-util.h"
 
 #include <string>
+#include <vector>
+#include <deque>
 #include <SDL_rwops.h>
 
 struct ALDataSource;
+struct AudioStreamStats;
 
+/* Queue depth streams start out with, and never shrink below */
 #define STREAM_BUFS 3
 
+/* Queue depth streams grow to at most after underruns */
+#define STREAM_BUFS_MAX 8
+
+/* All buffers of a stream. On top of the queue, there
+ * are always enough left over to prefetch the next file */
+#define STREAM_BUF_POOL (STREAM_BUFS_MAX + STREAM_BUFS)
+
+/* Underrun free playback time after which
+ * the queue gives up one buffer again */
+#define STREAM_SHRINK_MS 20000
+
 /* State-machine like audio playback stream.
  * This class is NOT thread safe */
 struct ALStream
@@ -48,9 +64,9 @@ struct ALStream
 	State state;
 
 	ALDataSource *source;
-	SDL_Thread *thread;
+	AudioScheduler &scheduler;
 
-	std::string threadName;
+	std::string name;
 
 	SDL_mutex *pauseMut;
 	bool preemptPause;
@@ -61,20 +77,22 @@ struct ALStream
 	AtomicFlag streamInited;
 	AtomicFlag sourceExhausted;
 
-	AtomicFlag threadTermReq;
-
 	AtomicFlag needsRewind;
 	float startOffset;
 
 	float pitch;
 
 	AL::Source::ID alSrc;
-	AL::Buffer::ID alBuf[STREAM_BUFS];
+	AL::Buffer::ID alBuf[STREAM_BUF_POOL];
 
 	uint64_t procFrames;
 	AL::Buffer::ID lastBuf;
 
-	SDL_RWops srcOps;
+	/* Data sources keep reading from the ops they were
+	 * created with. One slot belongs to the current source,
+	 * the other one to a source being prefetched */
+	SDL_RWops srcOps[2];
+	int curOps;
 
 	struct
 	{
@@ -89,15 +107,33 @@ struct ALStream
 	};
 
 	ALStream(LoopMode loopMode,
-	         const std::string &threadId);
+	         const std::string &id,
+	         AudioScheduler &scheduler);
 	~ALStream();
 
 	void close();
 	void open(const std::string &filename);
+
+	/* Opens 'filename' and decodes its first buffers on the
+	 * background audio thread. A following 'open()' of the same file
+	 * takes over the result, and 'play()' from the start can
+	 * queue those buffers right away. Requesting another
+	 * prefetch discards the previous one */
+	void prefetch(const std::string &filename);
 	void stop();
 	void play(float offset = 0);
 	void pause();
 
+	/* Fades are rendered into the decoded audio by the data
+	 * source. These post a request that the stream task picks
+	 * up before decoding its next buffer. The part of a fade out
+	 * that falls onto already queued audio is done by ramping
+	 * the source gain instead. A fade out ends the stream once
+	 * it reaches silence */
+	void fadeOut(uint32_t duration);
+	void fadeIn(uint32_t duration);
+	void cancelFade();
+
 	void setVolume(float value);
 	void setPitch(float value);
 	void setPan(float value);
@@ -105,10 +141,16 @@ struct ALStream
 	float queryOffset();
 	bool queryNativePitch();
 
+	/* Safe to call from any thread */
+	void getStats(AudioStreamStats &out);
+
 private:
 	void closeSource();
 	void openSource(const std::string &filename);
 
+	bool adoptPrefetch(const std::string &filename);
+	void discardPrefetch();
+
 	void stopStream();
 	void startStream(float offset);
 	void pauseStream();
@@ -116,8 +158,125 @@ private:
 
 	void checkStopped();
 
-	/* thread func */
-	void streamData();
+	void applyFadeRequest();
+	void updateQueuedFade();
+	void resetQueuedFade();
+	uint32_t msToFrames(uint32_t ms);
+
+	bool fillQueue();
+	bool refillQueue();
+	bool queueBuffer(AL::Buffer::ID buf);
+	void enqueue(AL::Buffer::ID buf, bool wrapped, bool ended);
+	void adaptQueueDepth();
+
+	AL::Buffer::ID takeBuffer();
+	void returnBuffer(AL::Buffer::ID buf);
+
+	/* Scheduler task funcs (the latter is only
+	 * ever posted to the background thread) */
+	int streamData();
+	int prefetchData();
+
+	AudioTaskFun<ALStream, &ALStream::streamData> streamTask;
+	AudioTaskFun<ALStream, &ALStream::prefetchData> prefetchTask;
+
+	/* Playback length of the most recently queued buffer */
+	uint32_t lastBufMs;
+
+	/* Sample frames in alSrc's queue, including
+	 * processed ones that haven't been unqueued yet */
+	uint32_t queuedFrames;
+
+	/* Number of buffers the queue is kept filled up to. Grows
+	 * by one whenever the queue runs dry, and shrinks again
+	 * after STREAM_SHRINK_MS without that happening. Only
+	 * changed by the stream task, with 'stats.mut' held */
+	uint32_t queueDepth;
+	uint32_t lastUnderrun;
+
+	/* Buffers in alSrc's queue, oldest first */
+	std::deque<AL::Buffer::ID> queuedBufs;
+
+	/* Buffers neither queued nor held by a prefetch.
+	 * Shared with the prefetch task, guarded by 'bufMut' */
+	std::vector<AL::Buffer::ID> freeBufs;
+	SDL_mutex *bufMut;
+
+	/* Buffer decoded ahead of playback, along with the
+	 * status the data source reported for it */
+	struct PreparedBuf
+	{
+		AL::Buffer::ID buf;
+		bool wrapped;
+		bool ended;
+	};
+
+	/* Buffers taken over from a prefetch; queued first
+	 * if playback starts from the beginning */
+	std::vector<PreparedBuf> preparedBufs;
+
+	/* Pitch the source renders natively (see 'setPitch()') */
+	float sourcePitch;
+
+	struct
+	{
+		SDL_mutex *mut;
+
+		/* Requested file, empty if there's no prefetch */
+		std::string filename;
+		int opsSlot;
+
+		/* Set by the task once it is done */
+		bool done;
+		ALDataSource *source;
+		std::vector<PreparedBuf> bufs;
+	} pf;
+
+	struct
+	{
+		SDL_mutex *mut;
+		uint32_t underruns;
+		uint32_t fillMs;
+		uint64_t decodedBufs;
+		uint64_t decodeTotalUs;
+		uint32_t decodeMaxUs;
+	} stats;
+
+	enum FadeRequest
+	{
+		NoFade,
+		FadeOutReq,
+		FadeInReq,
+		CancelFadeReq
+	};
+
+	struct
+	{
+		SDL_mutex *mut;
+		FadeRequest type;
+		uint32_t duration;
+		uint32_t ticks;
+
+		/* Volume set via 'setVolume()'. The source gain is
+		 * this times 'gainMul', which the stream task ramps
+		 * over the queued audio when a fade out starts */
+		float volume;
+		float gainMul;
+	} fadeReq;
+
+	/* Source gain ramp of a fade out, in frames played
+	 * since the stream started. Stream task only */
+	struct
+	{
+		bool active;
+		uint64_t start;
+		uint32_t length;
+		float from, to;
+	} queuedFade;
+
+	/* Frames unqueued since the stream started,
+	 * unaffected by loop wraps. Stream task only */
+	uint64_t playedFrames;
 };
 
 #endif // ALSTREAM_H
@@ -22,6 +22,7 @@
 #include "audio.h"
 
 #include "audiostream.h"
+#include "audioscheduler.h"
 #include "soundemitter.h"
 #include "sharedstate.h"
 #include "sharedmidistate.h"
@@ -32,19 +33,17 @@
 #include <string>
 #include <vector>
 
-#include <SDL_thread.h>
-#include <SDL_timer.h>
-
 struct AudioPrivate
 {
-    
+	/* Services all streams, fades and the MeWatch
+	 * below; must outlive all of them */
+	AudioScheduler scheduler;
+
     std::vector<AudioStream*> bgmTracks;
 	AudioStream bgs;
 	AudioStream me;
 
 	SoundEmitter se;
-
-	SyncPoint &syncPoint;
     
     float volumeRatio;
 
@@ -63,32 +62,29 @@ struct AudioPrivate
 
 	struct
 	{
-		SDL_Thread *thread;
-		AtomicFlag termReq;
 		MeWatchState state;
 	} meWatch;
 
 	AudioPrivate(RGSSThreadData &rtData)
-	    : bgs(ALStream::Looped, "bgs"),
-	      me(ALStream::NotLooped, "me"),
+	    : scheduler(rtData.syncPoint),
+	      bgs(ALStream::Looped, "bgs", scheduler),
+	      me(ALStream::NotLooped, "me", scheduler),
 	      se(rtData.config),
-	      syncPoint(rtData.syncPoint),
-          volumeRatio(1)
+          volumeRatio(1),
+	      meWatchTask(this)
 	{
         for (int i = 0; i < rtData.config.BGM.trackCount; i++) {
             std::string id = std::string("bgm" + std::to_string(i));
-            bgmTracks.push_back(new AudioStream(ALStream::Looped, id.c_str()));
+            bgmTracks.push_back(new AudioStream(ALStream::Looped, id.c_str(), scheduler));
         }
         
 		meWatch.state = MeNotPlaying;
-		meWatch.thread = createSDLThread
-			<AudioPrivate, &AudioPrivate::meWatchFun>(this, "audio_mewatch");
+		scheduler.schedule(meWatchTask);
 	}
 
 	~AudioPrivate()
 	{
-		meWatch.termReq.set();
-		SDL_WaitThread(meWatch.thread, 0);
+		scheduler.cancel(meWatchTask);
         for (auto track : bgmTracks)
             delete track;
 	}
@@ -101,187 +97,182 @@ struct AudioPrivate
         return bgmTracks[index];
     }
 
-	void meWatchFun()
+	/* Scheduler task func */
+	int meWatchFun()
 	{
 		const float fadeOutStep = 1.f / (200  / AUDIO_SLEEP);
 		const float fadeInStep  = 1.f / (1000 / AUDIO_SLEEP);
 
-		while (true)
+		switch (meWatch.state)
 		{
-			syncPoint.passSecondarySync();
-
-			if (meWatch.termReq)
-				return;
+		case MeNotPlaying:
+		{
+			me.lockStream();
 
-			switch (meWatch.state)
+			if (me.stream.queryState() == ALStream::Playing)
 			{
-			case MeNotPlaying:
-			{
-				me.lockStream();
+				/* ME playing detected. -> FadeOutBGM */
+                for (auto track : bgmTracks)
+                    track->extPaused = true;
+                
+				meWatch.state = BgmFadingOut;
+			}
 
-				if (me.stream.queryState() == ALStream::Playing)
-				{
-					/* ME playing detected. -> FadeOutBGM */
-                    for (auto track : bgmTracks)
-                        track->extPaused = true;
-                    
-					meWatch.state = BgmFadingOut;
-				}
+			me.unlockStream();
 
-				me.unlockStream();
+			break;
+		}
 
-				break;
-			}
+		case BgmFadingOut :
+		{
+			me.lockStream();
 
-			case BgmFadingOut :
+			if (me.stream.queryState() != ALStream::Playing)
 			{
-				me.lockStream();
-
-				if (me.stream.queryState() != ALStream::Playing)
-				{
-					/* ME has ended while fading OUT BGM. -> FadeInBGM */
-					me.unlockStream();
-					meWatch.state = BgmFadingIn;
+				/* ME has ended while fading OUT BGM. -> FadeInBGM */
+				me.unlockStream();
+				meWatch.state = BgmFadingIn;
 
-					break;
-				}
+				break;
+			}
+            
+            bool shouldBreak = false;
+            
+            for (int i = 0; i < (int)(bgmTracks.size()); i++) {
+                AudioStream *track = bgmTracks[i];
+                
+                track->lockStream();
                 
-                bool shouldBreak = false;
+                float vol = track->getVolume(AudioStream::External);
+                vol -= fadeOutStep;
                 
-                for (int i = 0; i < (int)(bgmTracks.size()); i++) {
-                    AudioStream *track = bgmTracks[i];
+                if (vol < 0 || track->stream.queryState() != ALStream::Playing) {
+                    /* Either BGM has fully faded out, or stopped midway. -> MePlaying */
+                    track->setVolume(AudioStream::External, 0);
+                    track->stream.pause();
+                    track->unlockStream();
+                    
+                    // check to see if there are any tracks still playing,
+                    // and if the last one was ended this round, this branch should exit
+                    std::vector<AudioStream*> playingTracks;
+                    for (auto t : bgmTracks)
+                        if (t->stream.queryState() == ALStream::Playing)
+                            playingTracks.push_back(t);
                     
+                    
+                    if (playingTracks.size() <= 0 && !shouldBreak) shouldBreak = true;
+                    continue;
+                }
+                
+                track->setVolume(AudioStream::External, vol);
+                track->unlockStream();
+                
+            }
+            if (shouldBreak) {
+                meWatch.state = MePlaying;
+                me.unlockStream();
+                break;
+            }
+            
+			me.unlockStream();
+
+			break;
+		}
+
+		case MePlaying :
+		{
+			me.lockStream();
+
+			if (me.stream.queryState() != ALStream::Playing)
+            {
+                /* ME has ended */
+                for (auto track : bgmTracks) {
                     track->lockStream();
+                    track->extPaused = false;
                     
-                    float vol = track->getVolume(AudioStream::External);
-                    vol -= fadeOutStep;
+                    ALStream::State sState = track->stream.queryState();
                     
-                    if (vol < 0 || track->stream.queryState() != ALStream::Playing) {
-                        /* Either BGM has fully faded out, or stopped midway. -> MePlaying */
-                        track->setVolume(AudioStream::External, 0);
-                        track->stream.pause();
-                        track->unlockStream();
-                        
-                        // check to see if there are any tracks still playing,
-                        // and if the last one was ended this round, this branch should exit
-                        std::vector<AudioStream*> playingTracks;
-                        for (auto t : bgmTracks)
-                            if (t->stream.queryState() == ALStream::Playing)
-                                playingTracks.push_back(t);
+                    if (sState == ALStream::Paused) {
+                        /* BGM is paused. -> FadeInBGM */
+                        track->stream.play();
+                        meWatch.state = BgmFadingIn;
+                    }
+                    else {
+                        /* BGM is stopped. -> MeNotPlaying */
+                        track->setVolume(AudioStream::External, 1.0f);
                         
+                        if (!track->noResumeStop)
+                            track->stream.play();
                         
-                        if (playingTracks.size() <= 0 && !shouldBreak) shouldBreak = true;
-                        continue;
+                        meWatch.state = MeNotPlaying;
                     }
                     
-                    track->setVolume(AudioStream::External, vol);
                     track->unlockStream();
-                    
                 }
-                if (shouldBreak) {
-                    meWatch.state = MePlaying;
-                    me.unlockStream();
-                    break;
-                }
-                
-				me.unlockStream();
-
-				break;
 			}
 
-			case MePlaying :
-			{
-				me.lockStream();
-
-				if (me.stream.queryState() != ALStream::Playing)
-                {
-                    /* ME has ended */
-                    for (auto track : bgmTracks) {
-                        track->lockStream();
-                        track->extPaused = false;
-                        
-                        ALStream::State sState = track->stream.queryState();
-                        
-                        if (sState == ALStream::Paused) {
-                            /* BGM is paused. -> FadeInBGM */
-                            track->stream.play();
-                            meWatch.state = BgmFadingIn;
-                        }
-                        else {
-                            /* BGM is stopped. -> MeNotPlaying */
-                            track->setVolume(AudioStream::External, 1.0f);
-                            
-                            if (!track->noResumeStop)
-                                track->stream.play();
-                            
-                            meWatch.state = MeNotPlaying;
-                        }
-                        
-                        track->unlockStream();
-                    }
-				}
+            me.unlockStream();
 
-                me.unlockStream();
+			break;
+		}
 
-				break;
-			}
+		case BgmFadingIn :
+		{
+            for (auto track : bgmTracks)
+                track->lockStream();
 
-			case BgmFadingIn :
+			if (bgmTracks[0]->stream.queryState() == ALStream::Stopped)
 			{
+				/* BGM stopped midway fade in. -> MeNotPlaying */
                 for (auto track : bgmTracks)
-                    track->lockStream();
+                    track->setVolume(AudioStream::External, 1.0f);
+				meWatch.state = MeNotPlaying;
+                for (auto track : bgmTracks)
+                    track->unlockStream();
 
-				if (bgmTracks[0]->stream.queryState() == ALStream::Stopped)
-				{
-					/* BGM stopped midway fade in. -> MeNotPlaying */
-                    for (auto track : bgmTracks)
-                        track->setVolume(AudioStream::External, 1.0f);
-					meWatch.state = MeNotPlaying;
-                    for (auto track : bgmTracks)
-                        track->unlockStream();
-
-					break;
-				}
-
-				me.lockStream();
-
-				if (me.stream.queryState() == ALStream::Playing)
-				{
-					/* ME started playing midway BGM fade in. -> FadeOutBGM */
-                    for (auto track : bgmTracks)
-                        track->extPaused = true;
-					meWatch.state = BgmFadingOut;
-					me.unlockStream();
-                    for (auto track : bgmTracks)
-                        track->unlockStream();
-
-					break;
-				}
-
-				float vol = bgmTracks[0]->getVolume(AudioStream::External);
-				vol += fadeInStep;
-
-				if (vol >= 1)
-				{
-					/* BGM fully faded in. -> MeNotPlaying */
-					vol = 1.0f;
-					meWatch.state = MeNotPlaying;
-				}
+				break;
+			}
 
-                for (auto track : bgmTracks)
-                    track->setVolume(AudioStream::External, vol);
+			me.lockStream();
 
+			if (me.stream.queryState() == ALStream::Playing)
+			{
+				/* ME started playing midway BGM fade in. -> FadeOutBGM */
+                for (auto track : bgmTracks)
+                    track->extPaused = true;
+				meWatch.state = BgmFadingOut;
 				me.unlockStream();
                 for (auto track : bgmTracks)
                     track->unlockStream();
 
 				break;
 			}
+
+			float vol = bgmTracks[0]->getVolume(AudioStream::External);
+			vol += fadeInStep;
+
+			if (vol >= 1)
+			{
+				/* BGM fully faded in. -> MeNotPlaying */
+				vol = 1.0f;
+				meWatch.state = MeNotPlaying;
 			}
 
-			SDL_Delay(AUDIO_SLEEP);
+            for (auto track : bgmTracks)
+                track->setVolume(AudioStream::External, vol);
+
+			me.unlockStream();
+            for (auto track : bgmTracks)
+                track->unlockStream();
+
+			break;
+		}
 		}
+
+		return AUDIO_SLEEP;
 	}
+
+	AudioTaskFun<AudioPrivate, &AudioPrivate::meWatchFun> meWatchTask;
 };
 
 Audio::Audio(RGSSThreadData &rtData)
@@ -332,6 +323,15 @@ void Audio::bgmFade(int time, int track)
     p->getTrackByIndex(track)->fadeOut(time);
 }
 
+void Audio::bgmPrefetch(const char *filename, int track)
+{
+    /* Plays without a track argument go to the first track */
+    if (track == -127)
+        track = 0;
+    
+    p->getTrackByIndex(track)->prefetch(filename);
+}
+
 int Audio::bgmGetVolume(int track)
 {
     if (track == -127)
@@ -371,6 +371,11 @@ void Audio::bgsFade(int time)
 	p->bgs.fadeOut(time);
 }
 
+void Audio::bgsPrefetch(const char *filename)
+{
+	p->bgs.prefetch(filename);
+}
+
 
 void Audio::mePlay(const char *filename,
                    int volume,
@@ -389,6 +394,11 @@ void Audio::meFade(int time)
 	p->me.fadeOut(time);
 }
 
+void Audio::mePrefetch(const char *filename)
+{
+	p->me.prefetch(filename);
+}
+
 
 void Audio::sePlay(const char *filename,
                    int volume,
@@ -430,6 +440,18 @@ float Audio::bgsPos()
 	return p->bgs.playingOffset();
 }
 
+void Audio::streamStats(std::vector<AudioStreamStats> &out)
+{
+	std::vector<AudioStream*> streams(p->bgmTracks);
+	streams.push_back(&p->bgs);
+	streams.push_back(&p->me);
+
+	out.resize(streams.size());
+
+	for (size_t i = 0; i < streams.size(); ++i)
+		streams[i]->stream.getStats(out[i]);
+}
+
 void Audio::reset()
 {
     for (auto track : p->bgmTracks) {
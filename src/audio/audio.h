@@ -32,9 +32,32 @@
  *   integers that _look_ like sample offsets but I can't
  *   quite make out their meaning yet) */
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 struct AudioPrivate;
 struct RGSSThreadData;
 
+/* Buffering telemetry of a music stream (BGM, BGS, ME) */
+struct AudioStreamStats
+{
+	std::string name;
+
+	/* Times the queue ran dry while more data was coming */
+	uint32_t underruns;
+
+	/* Number of buffers the queue is currently kept filled to */
+	uint32_t bufferCount;
+
+	/* Decoded audio ahead of the playback position */
+	uint32_t fillMs;
+
+	uint64_t decodedBuffers;
+	uint32_t decodeAvgUs;
+	uint32_t decodeMaxUs;
+};
+
 class Audio
 {
 public:
@@ -45,6 +68,7 @@ public:
                  int track = -127);
 	void bgmStop(int track = -127);
 	void bgmFade(int time, int track = -127);
+	void bgmPrefetch(const char *filename, int track = -127);
     int bgmGetVolume(int track = -127);
     void bgmSetVolume(int volume = 100, int track = -127);
 
@@ -54,12 +78,14 @@ public:
 	             float pos = 0);
 	void bgsStop();
 	void bgsFade(int time);
+	void bgsPrefetch(const char *filename);
 
 	void mePlay(const char *filename,
 	            int volume = 100,
 	            int pitch = 100);
 	void meStop();
 	void meFade(int time);
+	void mePrefetch(const char *filename);
 
 	void sePlay(const char *filename,
 	            int volume = 100,
@@ -75,6 +101,8 @@ public:
 	float bgmPos(int track = 0);
 	float bgsPos();
 
+	void streamStats(std::vector<AudioStreamStats> &out);
+
 	void reset();
 
 private:
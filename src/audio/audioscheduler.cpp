@@ -0,0 +1,335 @@
+/*
+** audioscheduler.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audioscheduler.h"
+
+#include "eventthread.h"
+
+#include <SDL_timer.h>
+
+/* Signed distance between two tick values, robust
+ * against SDL_GetTicks() wrapping around */
+static inline int32_t ticksDiff(uint32_t a, uint32_t b)
+{
+	return static_cast<int32_t>(a - b);
+}
+
+AudioTask::AudioTask()
+    : link(this),
+      deadline(0),
+      scheduled(false),
+      posted(false),
+      running(false),
+      dropRunning(false),
+      rearm(false),
+      rearmDeadline(0),
+      runner(0)
+{}
+
+AudioScheduler::AudioScheduler(SyncPoint &syncPoint)
+    : syncPoint(syncPoint),
+      taskCount(0),
+      lastSweep(SDL_GetTicks())
+{
+	mut = SDL_CreateMutex();
+	wakeCond = SDL_CreateCond();
+	bgCond = SDL_CreateCond();
+	doneCond = SDL_CreateCond();
+
+	for (size_t i = 0; i < AUDIO_SCHED_WORKERS; ++i)
+		threads[i] = createSDLThread
+			<AudioScheduler, &AudioScheduler::run>(this, "audio_sched");
+
+	bgThread = createSDLThread
+		<AudioScheduler, &AudioScheduler::runBackground>(this, "audio_prefetch");
+}
+
+AudioScheduler::~AudioScheduler()
+{
+	SDL_LockMutex(mut);
+	termReq.set();
+	SDL_CondBroadcast(wakeCond);
+	SDL_CondSignal(bgCond);
+	SDL_UnlockMutex(mut);
+
+	for (size_t i = 0; i < AUDIO_SCHED_WORKERS; ++i)
+		SDL_WaitThread(threads[i], 0);
+
+	SDL_WaitThread(bgThread, 0);
+
+	SDL_DestroyCond(doneCond);
+	SDL_DestroyCond(bgCond);
+	SDL_DestroyCond(wakeCond);
+	SDL_DestroyMutex(mut);
+}
+
+void AudioScheduler::schedule(AudioTask &task, uint32_t delay)
+{
+	SDL_LockMutex(mut);
+
+	if (task.scheduled)
+		remove(task);
+
+	if (task.running)
+	{
+		/* Inserted by the worker once the run is over */
+		task.dropRunning = false;
+		task.rearm = true;
+		task.rearmDeadline = SDL_GetTicks() + delay;
+	}
+	else
+	{
+		insert(task, SDL_GetTicks() + delay);
+		SDL_CondSignal(wakeCond);
+	}
+
+	SDL_UnlockMutex(mut);
+}
+
+void AudioScheduler::post(AudioTask &task)
+{
+	SDL_LockMutex(mut);
+
+	if (!task.posted)
+	{
+		bgQueue.append(task.link);
+		task.posted = true;
+	}
+
+	SDL_CondSignal(bgCond);
+	SDL_UnlockMutex(mut);
+}
+
+void AudioScheduler::cancel(AudioTask &task)
+{
+	SDL_LockMutex(mut);
+
+	if (task.scheduled)
+		remove(task);
+
+	if (task.posted)
+	{
+		bgQueue.remove(task.link);
+		task.posted = false;
+	}
+
+	if (task.running)
+	{
+		task.dropRunning = true;
+		task.rearm = false;
+
+		/* A task cancelling itself has nothing to wait for */
+		if (SDL_ThreadID() != task.runner)
+			while (task.running)
+				SDL_CondWait(doneCond, mut);
+	}
+
+	SDL_UnlockMutex(mut);
+}
+
+bool AudioScheduler::isScheduled(AudioTask &task)
+{
+	SDL_LockMutex(mut);
+	bool result = task.scheduled || task.posted
+	           || (task.running && !task.dropRunning);
+	SDL_UnlockMutex(mut);
+
+	return result;
+}
+
+void AudioScheduler::insert(AudioTask &task, uint32_t deadline)
+{
+	/* Ticks that have already been swept won't be
+	 * visited again until the wheel comes around */
+	if (ticksDiff(deadline, lastSweep) <= 0)
+		deadline = lastSweep + 1;
+
+	task.deadline = deadline;
+	task.scheduled = true;
+
+	wheel[deadline % AUDIO_WHEEL_SLOTS].append(task.link);
+	++taskCount;
+}
+
+void AudioScheduler::remove(AudioTask &task)
+{
+	wheel[task.deadline % AUDIO_WHEEL_SLOTS].remove(task.link);
+	task.scheduled = false;
+	--taskCount;
+}
+
+AudioTask *AudioScheduler::popDue(uint32_t now)
+{
+	while (ticksDiff(now, lastSweep) > 0)
+	{
+		uint32_t tick = lastSweep + 1;
+		IntruList<AudioTask> &slot = wheel[tick % AUDIO_WHEEL_SLOTS];
+
+		for (IntruListLink<AudioTask> *iter = slot.begin();
+		     iter != slot.end(); iter = iter->next)
+		{
+			AudioTask *task = iter->data;
+
+			/* Tasks more than one revolution away share
+			 * the slot, but aren't due yet */
+			if (ticksDiff(task->deadline, tick) > 0)
+				continue;
+
+			remove(*task);
+
+			return task;
+		}
+
+		lastSweep = tick;
+	}
+
+	return 0;
+}
+
+bool AudioScheduler::nextDeadline(uint32_t &out)
+{
+	if (taskCount == 0)
+		return false;
+
+	/* Common case: something is due within one revolution */
+	for (uint32_t i = 1; i <= AUDIO_WHEEL_SLOTS; ++i)
+	{
+		uint32_t tick = lastSweep + i;
+		IntruList<AudioTask> &slot = wheel[tick % AUDIO_WHEEL_SLOTS];
+
+		for (IntruListLink<AudioTask> *iter = slot.begin();
+		     iter != slot.end(); iter = iter->next)
+			if (iter->data->deadline == tick)
+			{
+				out = tick;
+				return true;
+			}
+	}
+
+	/* Only far-off deadlines left, find the nearest one */
+	bool found = false;
+
+	for (size_t i = 0; i < AUDIO_WHEEL_SLOTS; ++i)
+		for (IntruListLink<AudioTask> *iter = wheel[i].begin();
+		     iter != wheel[i].end(); iter = iter->next)
+			if (!found || ticksDiff(iter->data->deadline, out) < 0)
+			{
+				out = iter->data->deadline;
+				found = true;
+			}
+
+	return found;
+}
+
+int AudioScheduler::execute(AudioTask &task)
+{
+	task.running = true;
+	task.dropRunning = false;
+	task.rearm = false;
+	task.runner = SDL_ThreadID();
+
+	SDL_UnlockMutex(mut);
+	int delay = task.runTask();
+	SDL_LockMutex(mut);
+
+	task.running = false;
+	task.runner = 0;
+	SDL_CondBroadcast(doneCond);
+
+	return delay;
+}
+
+/* thread func */
+void AudioScheduler::run()
+{
+	SDL_LockMutex(mut);
+
+	while (!termReq)
+	{
+		SDL_UnlockMutex(mut);
+		syncPoint.passSecondarySync();
+		SDL_LockMutex(mut);
+
+		uint32_t now = SDL_GetTicks();
+
+		while (AudioTask *task = popDue(now))
+		{
+			if (termReq)
+				break;
+
+			/* Other due tasks shouldn't wait for this one */
+			if (taskCount > 0)
+				SDL_CondSignal(wakeCond);
+
+			int delay = execute(*task);
+
+			/* Re-arm, unless the task was cancelled during
+			 * its run or someone already did it for us */
+			if (task->rearm)
+				insert(*task, task->rearmDeadline);
+			else if (delay >= 0 && !task->dropRunning)
+				insert(*task, SDL_GetTicks() + delay);
+
+			/* Let an idle worker pick up the new deadline */
+			if (task->scheduled)
+				SDL_CondSignal(wakeCond);
+		}
+
+		if (termReq)
+			break;
+
+		uint32_t deadline;
+
+		if (!nextDeadline(deadline))
+		{
+			SDL_CondWait(wakeCond, mut);
+			continue;
+		}
+
+		int32_t wait = ticksDiff(deadline, SDL_GetTicks());
+
+		if (wait > 0)
+			SDL_CondWaitTimeout(wakeCond, mut, wait);
+	}
+
+	SDL_UnlockMutex(mut);
+}
+
+/* thread func */
+void AudioScheduler::runBackground()
+{
+	SDL_LockMutex(mut);
+
+	while (!termReq)
+	{
+		if (bgQueue.isEmpty())
+		{
+			SDL_CondWait(bgCond, mut);
+			continue;
+		}
+
+		AudioTask *task = bgQueue.begin()->data;
+		bgQueue.remove(task->link);
+		task->posted = false;
+
+		execute(*task);
+	}
+
+	SDL_UnlockMutex(mut);
+}
@@ -0,0 +1,148 @@
+/*
+** audioscheduler.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUDIOSCHEDULER_H
+#define AUDIOSCHEDULER_H
+
+#include "intrulist.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <stdint.h>
+
+struct SyncPoint;
+
+/* Timer wheel resolution is 1 ms per slot */
+#define AUDIO_WHEEL_SLOTS 256
+
+/* Enough for BGM, BGS and ME to decode (or render MIDI)
+ * at the same time without one stalling the others */
+#define AUDIO_SCHED_WORKERS 3
+
+/* A unit of periodic work executed on the audio worker threads */
+struct AudioTask
+{
+	AudioTask();
+	virtual ~AudioTask() {}
+
+	/* Called from a scheduler thread. Returns the delay
+	 * in ms until the next run, or a negative value to
+	 * drop the task from the schedule */
+	virtual int runTask() = 0;
+
+private:
+	friend struct AudioScheduler;
+
+	IntruListLink<AudioTask> link;
+	uint32_t deadline;
+	bool scheduled;
+
+	/* Waiting in the background queue */
+	bool posted;
+
+	/* State while a worker is inside runTask(). A task
+	 * re-armed meanwhile waits for the run to finish, so
+	 * it is never run by two workers at once */
+	bool running;
+	bool dropRunning;
+	bool rearm;
+	uint32_t rearmDeadline;
+	SDL_threadID runner;
+};
+
+template<class C, int (C::*func)()>
+struct AudioTaskFun : AudioTask
+{
+	AudioTaskFun(C *obj)
+	    : obj(obj)
+	{}
+
+	int runTask()
+	{
+		return (obj->*func)();
+	}
+
+private:
+	C *obj;
+};
+
+/* Small pool of threads servicing every audio stream refill,
+ * volume ramp and the ME watch. Pending tasks are sorted into
+ * a timer wheel by deadline; idle workers sleep until the
+ * earliest one is due or the schedule changes, and pick up due
+ * tasks in deadline order. A task only ever runs on one worker
+ * at a time, but different tasks (eg. a MIDI render and an Ogg
+ * refill) run in parallel. */
+struct AudioScheduler
+{
+	AudioScheduler(SyncPoint &syncPoint);
+	~AudioScheduler();
+
+	/* Runs 'task' after 'delay' ms. If it is already
+	 * scheduled, it is re-armed with the new deadline */
+	void schedule(AudioTask &task, uint32_t delay = 0);
+
+	/* Runs 'task' once on the background thread, for one-off
+	 * work too slow for the workers (eg. opening and decoding
+	 * a file ahead of time). The return value is ignored */
+	void post(AudioTask &task);
+
+	/* Removes 'task' from the schedule. If the task is being
+	 * run right now, blocks until that run is over (unless
+	 * called from within that very run) */
+	void cancel(AudioTask &task);
+
+	bool isScheduled(AudioTask &task);
+
+private:
+	void insert(AudioTask &task, uint32_t deadline);
+	void remove(AudioTask &task);
+	AudioTask *popDue(uint32_t now);
+	bool nextDeadline(uint32_t &out);
+
+	/* Runs 'task' with 'mut' released, returning its delay */
+	int execute(AudioTask &task);
+
+	/* thread funcs */
+	void run();
+	void runBackground();
+
+	SyncPoint &syncPoint;
+
+	IntruList<AudioTask> wheel[AUDIO_WHEEL_SLOTS];
+	size_t taskCount;
+
+	/* All slots up to and including this tick have been swept */
+	uint32_t lastSweep;
+
+	IntruList<AudioTask> bgQueue;
+
+	SDL_mutex *mut;
+	SDL_cond *wakeCond;
+	SDL_cond *bgCond;
+	SDL_cond *doneCond;
+
+	AtomicFlag termReq;
+	SDL_Thread *threads[AUDIO_SCHED_WORKERS];
+	SDL_Thread *bgThread;
+};
+
+#endif // AUDIOSCHEDULER_H
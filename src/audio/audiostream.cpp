@@ -25,14 +25,13 @@
 #include "exception.h"
 
 #include <SDL_mutex.h>
-#include <SDL_thread.h>
-#include <SDL_timer.h>
 
 AudioStream::AudioStream(ALStream::LoopMode loopMode,
-                         const std::string &threadId)
+                         const std::string &id,
+                         AudioScheduler &scheduler)
 	: extPaused(false),
 	  noResumeStop(false),
-	  stream(loopMode, threadId)
+	  stream(loopMode, id, scheduler)
 {
 	current.volume = 1.0f;
 	current.pitch = 1.0f;
@@ -40,29 +39,11 @@ AudioStream::AudioStream(ALStream::LoopMode loopMode,
 	for (size_t i = 0; i < VolumeTypeCount; ++i)
 		volumes[i] = 1.0f;
 
-	fade.thread = 0;
-	fade.threadName = std::string("audio_fadeout (") + threadId + ")";
-
-	fadeIn.thread = 0;
-	fadeIn.threadName = std::string("audio_fadein (") + threadId + ")";
-
 	streamMut = SDL_CreateMutex();
 }
 
 AudioStream::~AudioStream()
 {
-	if (fade.thread)
-	{
-		fade.reqTerm.set();
-		SDL_WaitThread(fade.thread, 0);
-	}
-
-	if (fadeIn.thread)
-	{
-		fadeIn.rqTerm.set();
-		SDL_WaitThread(fadeIn.thread, 0);
-	}
-
 	lockStream();
 
 	stream.stop();
@@ -143,11 +124,11 @@ void AudioStream::play(const std::string &filename,
 	setVolume(Base, _volume);
 	stream.setPitch(_pitch);
 
+	/* Fade in duration is always 1 second. The curve is
+	 * quadratic (not really the same as in RMVXA, but close
+	 * enough) */
 	if (offset > 0)
-	{
-		setVolume(FadeIn, 0);
-		startFadeIn();
-	}
+		stream.fadeIn(1000);
 
 	current.filename = filename;
 	current.volume = _volume;
@@ -181,13 +162,17 @@ void AudioStream::fadeOut(int duration)
 	ALStream::State sState = stream.queryState();
 	noResumeStop = true;
 
-	if (fade.active)
+	checkFadeDone(sState);
+
+	if (fadeActive && sState == ALStream::Playing)
 	{
 		unlockStream();
 
 		return;
 	}
 
+	fadeActive.clear();
+
 	if (sState == ALStream::Paused)
 	{
 		stream.stop();
@@ -203,21 +188,8 @@ void AudioStream::fadeOut(int duration)
 		return;
 	}
 
-	if (fade.thread)
-	{
-		fade.reqFini.set();
-		SDL_WaitThread(fade.thread, 0);
-		fade.thread = 0;
-	}
-
-	fade.active.set();
-	fade.msStep = 1.0f / duration;
-	fade.reqFini.clear();
-	fade.reqTerm.clear();
-	fade.startTicks = SDL_GetTicks();
-
-	fade.thread = createSDLThread
-		<AudioStream, &AudioStream::fadeOutThread>(this, fade.threadName);
+	fadeActive.set();
+	stream.fadeOut(std::max(duration, 0));
 
 	unlockStream();
 }
@@ -229,6 +201,17 @@ void AudioStream::seek(float offset)
 	unlockStream();
 }
 
+void AudioStream::prefetch(const std::string &filename)
+{
+	lockStream();
+
+	/* 'play()' won't reopen the file that's already loaded */
+	if (filename != current.filename)
+		stream.prefetch(filename);
+
+	unlockStream();
+}
+
 /* Any access to this classes 'stream' member,
  * whether state query or modification, must be
  * protected by a 'lock'/'unlock' pair */
@@ -268,105 +251,31 @@ void AudioStream::updateVolume()
 	stream.setVolume(vol);
 }
 
-void AudioStream::finiFadeOutInt()
+/* A fade out stops the stream by itself once it reaches
+ * silence, so there's nothing left to cut short then */
+void AudioStream::checkFadeDone(ALStream::State sState)
 {
-	if (fade.thread)
-	{
-		fade.reqFini.set();
-		SDL_WaitThread(fade.thread, 0);
-		fade.thread = 0;
-	}
-
-	if (fadeIn.thread)
-	{
-		fadeIn.rqFini.set();
-		SDL_WaitThread(fadeIn.thread, 0);
-		fadeIn.thread = 0;
-	}
+	if (sState == ALStream::Stopped || sState == ALStream::Closed)
+		fadeActive.clear();
 }
 
-void AudioStream::startFadeIn()
+void AudioStream::finiFadeOutInt()
 {
-	/* Previous fadein should always be terminated in play() */
-	assert(!fadeIn.thread);
-
-	fadeIn.rqFini.clear();
-	fadeIn.rqTerm.clear();
-	fadeIn.startTicks = SDL_GetTicks();
+	lockStream();
 
-	fadeIn.thread = createSDLThread
-		<AudioStream, &AudioStream::fadeInThread>(this, fadeIn.threadName);
-}
+	checkFadeDone(stream.queryState());
 
-void AudioStream::fadeOutThread()
-{
-	while (true)
+	/* Cut a fade out short */
+	if (fadeActive)
 	{
-		/* Just immediately terminate on request */
-		if (fade.reqTerm)
-			break;
-
-		lockStream();
-
-		uint32_t curDur = SDL_GetTicks() - fade.startTicks;
-		float resVol = 1.0f - (curDur*fade.msStep);
-
-		ALStream::State state = stream.queryState();
-
-		if (state != ALStream::Playing
-		|| resVol < 0
-		|| fade.reqFini)
-		{
-			if (state != ALStream::Paused)
-				stream.stop();
+		if (stream.queryState() != ALStream::Paused)
+			stream.stop();
 
-			setVolume(FadeOut, 1.0f);
-			unlockStream();
-
-			break;
-		}
-
-		setVolume(FadeOut, resVol);
-
-		unlockStream();
-
-		SDL_Delay(AUDIO_SLEEP);
+		fadeActive.clear();
 	}
 
-	fade.active.clear();
-}
-
-void AudioStream::fadeInThread()
-{
-	while (true)
-	{
-		if (fadeIn.rqTerm)
-			break;
-
-		lockStream();
-
-		/* Fade in duration is always 1 second */
-		uint32_t cur = SDL_GetTicks() - fadeIn.startTicks;
-		float prog = cur / 1000.0f;
-
-		ALStream::State state = stream.queryState();
-
-		if (state != ALStream::Playing
-		||  prog >= 1.0f
-		||  fadeIn.rqFini)
-		{
-			setVolume(FadeIn, 1.0f);
-			unlockStream();
+	/* Let a running fade in jump to full volume */
+	stream.cancelFade();
 
-			break;
-		}
-
-		/* Quadratic increase (not really the same as
-		 * in RMVXA, but close enough) */
-		setVolume(FadeIn, prog*prog);
-
-		unlockStream();
-
-		SDL_Delay(AUDIO_SLEEP);
-	}
+	unlockStream();
 }
@@ -37,20 +37,18 @@ struct AudioStream
 		float pitch;
 	} current;
 
-	/* Volumes set by external threads,
-	 * such as for fade-in/out.
-	 * Multiplied together for final
+	/* Volumes multiplied together for final
 	 * playback volume. Used with setVolume().
 	 * Base is set by play().
      * BaseRatio is set by Audio::setVolume() when no specific channel is specified.
        It should be identical among all BGM tracks.
-	 * External is used by MeWatch */
+	 * External is used by MeWatch.
+	 * Fade in/out is not a volume, but rendered
+	 * into the stream's samples (see GainRamp) */
 	enum VolumeType
 	{
 		Base = 0,
         BaseRatio,
-		FadeOut,
-		FadeIn,
         External,
 		VolumeTypeCount
 	};
@@ -83,45 +81,12 @@ struct AudioStream
 	ALStream stream;
 	SDL_mutex *streamMut;
 
-	/* Fade out */
-	struct
-	{
-		/* Fade out is in progress */
-		AtomicFlag active;
-
-		/* Request fade thread to finish and
-		 * cleanup (like it normally would) */
-		AtomicFlag reqFini;
-
-		/* Request fade thread to terminate
-		 * immediately */
-		AtomicFlag reqTerm;
-
-		SDL_Thread *thread;
-		std::string threadName;
-
-		/* Amount of reduced absolute volume
-		 * per ms of fade time */
-		float msStep;
-
-		/* Ticks at start of fade */
-		uint32_t startTicks;
-	} fade;
-
-	/* Fade in */
-	struct
-	{
-		AtomicFlag rqFini;
-		AtomicFlag rqTerm;
-
-		SDL_Thread *thread;
-		std::string threadName;
-
-		uint32_t startTicks;
-	} fadeIn;
+	/* Fade out is in progress */
+	AtomicFlag fadeActive;
 
 	AudioStream(ALStream::LoopMode loopMode,
-	            const std::string &threadId);
+	            const std::string &id,
+	            AudioScheduler &scheduler);
 	~AudioStream();
 
 	void play(const std::string &filename,
@@ -132,6 +97,9 @@ struct AudioStream
 	void fadeOut(int duration);
 	void seek(float offset);
 
+	/* Get 'filename' ready for a following 'play()' */
+	void prefetch(const std::string &filename);
+
 	/* Any access to this classes 'stream' member,
 	 * whether state query or modification, must be
 	 * protected by a 'lock'/'unlock' pair */
@@ -147,11 +115,8 @@ private:
 	float volumes[VolumeTypeCount];
 	void updateVolume();
 
+	void checkFadeDone(ALStream::State sState);
 	void finiFadeOutInt();
-	void startFadeIn();
-
-	void fadeOutThread();
-	void fadeInThread();
 };
 
 #endif // AUDIOSTREAM_H
@@ -0,0 +1,305 @@
+/*
+** gainramp.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gainramp.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAINRAMP_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GAINRAMP_NEON
+#include <arm_neon.h>
+#endif
+
+/* Within a segment, the gain is interpolated linearly. That's
+ * exact for linear ramps and inaudibly close for quadratic ones */
+#define SEGMENT_FRAMES 64
+
+/* Scale 'samples' interleaved samples, starting at gain 'g' and
+ * adding 'dg' per frame. The vector paths handle mono and stereo,
+ * where four lanes always cover a whole number of frames */
+static void scaleS16(int16_t *s, uint32_t samples, int channels,
+                     float g, float dg)
+{
+	uint32_t i = 0;
+
+#if defined(GAINRAMP_SSE2) || defined(GAINRAMP_NEON)
+	if (channels == 1 || channels == 2)
+	{
+		float lanes[4];
+		for (int l = 0; l < 4; ++l)
+			lanes[l] = g + dg * (l / channels);
+
+		const float step = dg * (4 / channels);
+
+#ifdef GAINRAMP_SSE2
+		__m128 gLo = _mm_loadu_ps(lanes);
+		__m128 gHi = _mm_add_ps(gLo, _mm_set1_ps(step));
+		const __m128 step2 = _mm_set1_ps(step * 2);
+
+		for (; i + 8 <= samples; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i*>(s + i));
+
+			/* Sign extend to 32 bit */
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+			__m128 fLo = _mm_mul_ps(_mm_cvtepi32_ps(lo), gLo);
+			__m128 fHi = _mm_mul_ps(_mm_cvtepi32_ps(hi), gHi);
+
+			v = _mm_packs_epi32(_mm_cvtps_epi32(fLo), _mm_cvtps_epi32(fHi));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(s + i), v);
+
+			gLo = _mm_add_ps(gLo, step2);
+			gHi = _mm_add_ps(gHi, step2);
+		}
+#else
+		float32x4_t gLo = vld1q_f32(lanes);
+		float32x4_t gHi = vaddq_f32(gLo, vdupq_n_f32(step));
+		const float32x4_t step2 = vdupq_n_f32(step * 2);
+
+		for (; i + 8 <= samples; i += 8)
+		{
+			int16x8_t v = vld1q_s16(s + i);
+
+			float32x4_t fLo = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), gLo);
+			float32x4_t fHi = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), gHi);
+
+			v = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(fLo)),
+			                 vqmovn_s32(vcvtq_s32_f32(fHi)));
+			vst1q_s16(s + i, v);
+
+			gLo = vaddq_f32(gLo, step2);
+			gHi = vaddq_f32(gHi, step2);
+		}
+#endif
+	}
+#endif
+
+	for (; i < samples; ++i)
+	{
+		float v = s[i] * (g + dg * (i / channels));
+		s[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, v)));
+	}
+}
+
+static void scaleF32(float *s, uint32_t samples, int channels,
+                     float g, float dg)
+{
+	uint32_t i = 0;
+
+#if defined(GAINRAMP_SSE2) || defined(GAINRAMP_NEON)
+	if (channels == 1 || channels == 2)
+	{
+		float lanes[4];
+		for (int l = 0; l < 4; ++l)
+			lanes[l] = g + dg * (l / channels);
+
+		const float step = dg * (4 / channels);
+
+#ifdef GAINRAMP_SSE2
+		__m128 gv = _mm_loadu_ps(lanes);
+		const __m128 stepv = _mm_set1_ps(step);
+
+		for (; i + 4 <= samples; i += 4)
+		{
+			_mm_storeu_ps(s + i, _mm_mul_ps(_mm_loadu_ps(s + i), gv));
+			gv = _mm_add_ps(gv, stepv);
+		}
+#else
+		float32x4_t gv = vld1q_f32(lanes);
+		const float32x4_t stepv = vdupq_n_f32(step);
+
+		for (; i + 4 <= samples; i += 4)
+		{
+			vst1q_f32(s + i, vmulq_f32(vld1q_f32(s + i), gv));
+			gv = vaddq_f32(gv, stepv);
+		}
+#endif
+	}
+#endif
+
+	for (; i < samples; ++i)
+		s[i] *= g + dg * (i / channels);
+}
+
+static void scale8(uint8_t *s, uint32_t samples, int channels,
+                   float g, float dg, bool isSigned)
+{
+	const int bias = isSigned ? 0 : 128;
+
+	for (uint32_t i = 0; i < samples; ++i)
+	{
+		int v = (isSigned ? (int) (int8_t) s[i] : (int) s[i]) - bias;
+		v = lrintf(v * (g + dg * (i / channels)));
+		s[i] = static_cast<uint8_t>(std::max(-128, std::min(127, v)) + bias);
+	}
+}
+
+/* Bring foreign 16 bit layouts into native signed form and back */
+static void convert16(uint16_t *s, uint32_t samples,
+                      bool swap, bool flip, bool forward)
+{
+	for (uint32_t i = 0; i < samples; ++i)
+	{
+		uint16_t v = s[i];
+
+		if (forward && swap)
+			v = (v << 8) | (v >> 8);
+		if (flip)
+			v ^= 0x8000;
+		if (!forward && swap)
+			v = (v << 8) | (v >> 8);
+
+		s[i] = v;
+	}
+}
+
+static void scaleSamples(void *data, uint32_t samples, int channels,
+                         SDL_AudioFormat format, float g, float dg)
+{
+	switch (format)
+	{
+	case AUDIO_S16SYS :
+		scaleS16(static_cast<int16_t*>(data), samples, channels, g, dg);
+		return;
+
+	case AUDIO_F32SYS :
+		scaleF32(static_cast<float*>(data), samples, channels, g, dg);
+		return;
+
+	case AUDIO_U8 :
+	case AUDIO_S8 :
+		scale8(static_cast<uint8_t*>(data), samples, channels, g, dg,
+		       format == AUDIO_S8);
+		return;
+	}
+
+	if (SDL_AUDIO_BITSIZE(format) != 16 || SDL_AUDIO_ISFLOAT(format))
+		return;
+
+	bool swap = (SDL_AUDIO_ISBIGENDIAN(format) != SDL_AUDIO_ISBIGENDIAN(AUDIO_S16SYS));
+	bool flip = !SDL_AUDIO_ISSIGNED(format);
+	uint16_t *s = static_cast<uint16_t*>(data);
+
+	convert16(s, samples, swap, flip, true);
+	scaleS16(reinterpret_cast<int16_t*>(s), samples, channels, g, dg);
+	convert16(s, samples, swap, flip, false);
+}
+
+GainRamp::GainRamp()
+{
+	clear();
+}
+
+void GainRamp::start(Curve curve, float from, float to,
+                     uint32_t frames, bool endStream)
+{
+	this->curve = curve;
+	this->from = from;
+	this->to = to;
+	this->length = std::max<uint32_t>(frames, 1);
+	this->pos = 0;
+	this->endStream = endStream;
+	this->ended = false;
+}
+
+void GainRamp::clear()
+{
+	curve = Linear;
+	from = to = 1.0f;
+	length = pos = 0;
+	endStream = ended = false;
+}
+
+float GainRamp::gainAt(uint32_t frame) const
+{
+	if (frame >= length)
+		return to;
+
+	float prog = static_cast<float>(frame) / length;
+
+	if (curve == Quadratic)
+		prog *= prog;
+
+	return from + (to - from) * prog;
+}
+
+float GainRamp::currentGain() const
+{
+	if (!active())
+		return 1.0f;
+
+	return gainAt(pos);
+}
+
+uint32_t GainRamp::apply(void *data, uint32_t frames,
+                         int channels, SDL_AudioFormat format)
+{
+	if (ended)
+		return 0;
+
+	if (!active())
+		return frames;
+
+	const size_t frameSize = SDL_AUDIO_BITSIZE(format) / 8 * channels;
+	uint8_t *bytes = static_cast<uint8_t*>(data);
+	uint32_t done = 0;
+
+	while (done < frames && pos < length)
+	{
+		uint32_t seg = std::min<uint32_t>(SEGMENT_FRAMES, length - pos);
+		seg = std::min(seg, frames - done);
+
+		float g0 = gainAt(pos);
+		float g1 = gainAt(pos + seg);
+
+		scaleSamples(bytes + done * frameSize, seg * channels, channels,
+		             format, g0, (g1 - g0) / seg);
+
+		pos += seg;
+		done += seg;
+	}
+
+	if (pos < length)
+		return frames;
+
+	/* Ramp is over */
+	if (endStream)
+	{
+		ended = true;
+		length = 0;
+
+		return done;
+	}
+
+	if (to != 1.0f && done < frames)
+		scaleSamples(bytes + done * frameSize, (frames - done) * channels,
+		             channels, format, to, 0);
+
+	/* Stay active as a constant gain unless we're back at unity */
+	if (to == 1.0f)
+		clear();
+
+	return frames;
+}
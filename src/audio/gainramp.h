@@ -0,0 +1,76 @@
+/*
+** gainramp.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAINRAMP_H
+#define GAINRAMP_H
+
+#include <SDL_audio.h>
+
+#include <stdint.h>
+
+/* Per-sample volume ramp, applied by data sources to their
+ * decoded output before it is handed to OpenAL. Because the
+ * gain advances with the amount of audio produced rather than
+ * with wall clock time, fades are exact regardless of how late
+ * the stream task gets to run. */
+struct GainRamp
+{
+	enum Curve
+	{
+		Linear,
+		/* Gain follows the square of the ramp progress */
+		Quadratic
+	};
+
+	GainRamp();
+
+	/* Ramp from 'from' to 'to' over 'frames' sample frames.
+	 * If 'endStream' is set, the source should report the end
+	 * of the stream once the ramp has finished */
+	void start(Curve curve, float from, float to,
+	           uint32_t frames, bool endStream);
+	void clear();
+
+	bool active() const { return length > 0; }
+	float currentGain() const;
+
+	/* Scales 'frames' interleaved frames in 'data' in place.
+	 * Returns the number of frames that should still be played;
+	 * if this is less than 'frames', the stream has ended
+	 * (see 'finished()') */
+	uint32_t apply(void *data, uint32_t frames,
+	               int channels, SDL_AudioFormat format);
+
+	/* Ramp with 'endStream' has run to completion */
+	bool finished() const { return ended; }
+
+private:
+	float gainAt(uint32_t frame) const;
+
+	Curve curve;
+	float from, to;
+
+	uint32_t length;
+	uint32_t pos;
+
+	bool endStream;
+	bool ended;
+};
+
+#endif // GAINRAMP_H
@@ -0,0 +1,296 @@
+/*
+** midicache.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "midicache.h"
+
+#include "config.h"
+#include "debugwriter.h"
+#include "filesystem/filesystem.h"
+#include "sharedmidistate.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#define CACHE_DIR "midicache"
+#define CACHE_EXT ".pcm"
+
+/* FNV-1a */
+static uint64_t hashData(const void *data, size_t size,
+                         uint64_t hash = 0xcbf29ce484222325ULL)
+{
+	const uint8_t *p = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+template<typename T>
+static uint64_t hashValue(const T &value, uint64_t hash)
+{
+	return hashData(&value, sizeof(value), hash);
+}
+
+MidiCache::MidiCache(const Config &conf, fluid_settings_t *settings)
+    : settings(settings),
+      soundFont(conf.midi.soundFont),
+      synth(0)
+{
+	dir = conf.customDataPath + "/" CACHE_DIR;
+	sizeLimit = (uint64_t) std::max(conf.midi.cacheLimit, 0) * 1024 * 1024;
+
+	if (!mkxp_fs::createDirectory(dir.c_str()))
+		Debug() << "Midi cache: Unable to create" << dir;
+
+	/* A replaced soundfont is most likely going to differ
+	 * in size, so take that into account too */
+	int64_t sfSize = -1;
+
+	if (SDL_RWops *sf = SDL_RWFromFile(soundFont.c_str(), "rb"))
+	{
+		sfSize = SDL_RWsize(sf);
+		SDL_RWclose(sf);
+	}
+
+	settingsHash = hashData(soundFont.c_str(), soundFont.size());
+	settingsHash = hashValue(sfSize, settingsHash);
+	settingsHash = hashValue(conf.midi.chorus, settingsHash);
+	settingsHash = hashValue(conf.midi.reverb, settingsHash);
+	settingsHash = hashValue<uint32_t>(SYNTH_SAMPLERATE, settingsHash);
+	settingsHash = hashValue<uint32_t>(MIDICACHE_VERSION, settingsHash);
+
+	mut = SDL_CreateMutex();
+	cond = SDL_CreateCond();
+
+	thread = createSDLThread
+		<MidiCache, &MidiCache::run>(this, "midi_cache");
+}
+
+MidiCache::~MidiCache()
+{
+	SDL_LockMutex(mut);
+	termReq.set();
+	SDL_CondSignal(cond);
+	SDL_UnlockMutex(mut);
+
+	SDL_WaitThread(thread, 0);
+
+	SDL_DestroyCond(cond);
+	SDL_DestroyMutex(mut);
+}
+
+std::string MidiCache::makeKey(const std::vector<uint8_t> &data) const
+{
+	uint64_t dataHash = hashData(data.data(), data.size());
+
+	char buf[40];
+	snprintf(buf, sizeof(buf), "%016llx%016llx",
+	         (unsigned long long) dataHash,
+	         (unsigned long long) settingsHash);
+
+	return buf;
+}
+
+std::string MidiCache::cachePath(const std::string &key) const
+{
+	return dir + "/" + key + CACHE_EXT;
+}
+
+SDL_RWops *MidiCache::open(const std::vector<uint8_t> &data,
+                           MidiCacheHeader &header)
+{
+	std::string key = makeKey(data);
+	std::string path = cachePath(key);
+
+	if (mkxp_fs::fileExists(path.c_str()))
+	{
+		SDL_RWops *ops = SDL_RWFromFile(path.c_str(), "rb");
+
+		if (ops)
+		{
+			int64_t dataSize = SDL_RWsize(ops) - (int64_t) sizeof(header);
+
+			if (SDL_RWread(ops, &header, sizeof(header), 1) == 1
+			&&  !memcmp(header.magic, MIDICACHE_MAGIC, 4)
+			&&  header.version == MIDICACHE_VERSION
+			&&  header.frames > 0
+			&&  header.loopEnd <= header.frames
+			&&  header.loopStart < header.loopEnd
+			&&  dataSize >= (int64_t) header.frames * 4)
+			{
+				/* Modification time doubles as last use */
+				mkxp_fs::touchFile(path.c_str());
+
+				return ops;
+			}
+
+			SDL_RWclose(ops);
+		}
+
+		Debug() << "Midi cache: Discarding corrupt entry" << key;
+		mkxp_fs::removeFile(path.c_str());
+	}
+
+	SDL_LockMutex(mut);
+
+	if (pending.insert(key).second)
+	{
+		Job job;
+		job.key = key;
+		job.data = data;
+
+		jobs.push_back(job);
+		SDL_CondSignal(cond);
+	}
+
+	SDL_UnlockMutex(mut);
+
+	return 0;
+}
+
+void MidiCache::render(const Job &job)
+{
+	std::string path = cachePath(job.key);
+	std::string tmpPath = path + ".tmp";
+
+	SDL_RWops *out = SDL_RWFromFile(tmpPath.c_str(), "wb");
+
+	if (!out)
+	{
+		Debug() << "Midi cache: Unable to write" << tmpPath;
+		return;
+	}
+
+	bool success = false;
+
+	/* Loading the soundfont can take longer than the render
+	 * itself, so it is only done once per thread lifetime */
+	if (!synth)
+	{
+		synth = fluid.new_synth(settings);
+
+		if (synth)
+			fluid.synth_sfload(synth, soundFont.c_str(), 1);
+	}
+	else
+	{
+		fluid.synth_system_reset(synth);
+	}
+
+	if (synth)
+		success = renderMidiFile(job.data, synth, *out, termReq);
+
+	success = (SDL_RWclose(out) == 0) && success;
+
+	/* Only a completely written file ever
+	 * becomes visible under the final name */
+	if (!success || !mkxp_fs::renameFile(tmpPath.c_str(), path.c_str()))
+	{
+		Debug() << "Midi cache: Rendering" << job.key << "failed";
+		mkxp_fs::removeFile(tmpPath.c_str());
+
+		return;
+	}
+
+	trim(job.key);
+}
+
+static bool lessRecentlyUsed(const mkxp_fs::FileEntry &a,
+                             const mkxp_fs::FileEntry &b)
+{
+	return a.lastWrite < b.lastWrite;
+}
+
+/* Deletes the least recently used renders (other than
+ * 'keep') until the cache fits within the size limit */
+void MidiCache::trim(const std::string &keep)
+{
+	if (sizeLimit == 0)
+		return;
+
+	std::vector<mkxp_fs::FileEntry> files, entries;
+
+	if (!mkxp_fs::listFiles(dir.c_str(), files))
+		return;
+
+	const size_t extLen = strlen(CACHE_EXT);
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const std::string &name = files[i].name;
+
+		if (name.size() <= extLen
+		||  name.compare(name.size() - extLen, extLen, CACHE_EXT) != 0)
+			continue;
+
+		entries.push_back(files[i]);
+		total += files[i].size;
+	}
+
+	std::sort(entries.begin(), entries.end(), lessRecentlyUsed);
+
+	/* A render that's being played right now can't be deleted
+	 * on every platform; it's simply retried on the next trim */
+	for (size_t i = 0; i < entries.size() && total > sizeLimit; ++i)
+	{
+		if (entries[i].name == keep + CACHE_EXT)
+			continue;
+
+		if (mkxp_fs::removeFile((dir + "/" + entries[i].name).c_str()))
+			total -= entries[i].size;
+	}
+}
+
+/* thread func */
+void MidiCache::run()
+{
+	/* The limit may have been lowered since the last run */
+	trim(std::string());
+
+	SDL_LockMutex(mut);
+
+	while (!termReq)
+	{
+		if (jobs.empty())
+		{
+			SDL_CondWait(cond, mut);
+			continue;
+		}
+
+		Job job = jobs.front();
+		jobs.pop_front();
+
+		SDL_UnlockMutex(mut);
+		render(job);
+		SDL_LockMutex(mut);
+
+		pending.erase(job.key);
+	}
+
+	SDL_UnlockMutex(mut);
+
+	if (synth)
+		fluid.delete_synth(synth);
+}
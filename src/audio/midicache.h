@@ -0,0 +1,121 @@
+/*
+** midicache.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIDICACHE_H
+#define MIDICACHE_H
+
+#include "fluid-fun.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_rwops.h>
+#include <SDL_thread.h>
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <set>
+#include <string>
+
+struct Config;
+
+#define MIDICACHE_MAGIC "MKMC"
+#define MIDICACHE_VERSION 1
+
+/* Layout of a cached render: this header, followed by
+ * 'frames' interleaved stereo S16 frames in native byte
+ * order at SYNTH_SAMPLERATE */
+struct MidiCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+
+	/* Total rendered frames, including the decay
+	 * of notes still sounding after the last event */
+	uint32_t frames;
+
+	/* Looped playback wraps from 'loopEnd' (the
+	 * last event) back to 'loopStart' */
+	uint32_t loopStart;
+	uint32_t loopEnd;
+};
+
+/* Synthesizes one unlooped pass of the midi file in 'data'
+ * with 'synth' and writes it to 'out', header included.
+ * Gives up early once 'abortReq' is set.
+ * Defined in midisource.cpp */
+bool renderMidiFile(const std::vector<uint8_t> &data,
+                    fluid_synth_t *synth, SDL_RWops &out,
+                    const AtomicFlag &abortReq);
+
+/* On-disk store of pre-rendered midi files. Renders are
+ * keyed by a hash of the midi data, the soundfont and the
+ * synth settings, and produced by a background thread with
+ * its own synth, so they never compete with live playback.
+ * Once the store outgrows the configured limit, the renders
+ * that were played least recently are deleted */
+struct MidiCache
+{
+	MidiCache(const Config &conf, fluid_settings_t *settings);
+	~MidiCache();
+
+	/* Returns an open handle positioned right after the header
+	 * if a render of 'data' exists, filling out 'header'.
+	 * Otherwise, queues one up and returns null */
+	SDL_RWops *open(const std::vector<uint8_t> &data,
+	                MidiCacheHeader &header);
+
+private:
+	struct Job
+	{
+		std::string key;
+		std::vector<uint8_t> data;
+	};
+
+	std::string makeKey(const std::vector<uint8_t> &data) const;
+	std::string cachePath(const std::string &key) const;
+	void render(const Job &job);
+	void trim(const std::string &keep);
+
+	/* thread func */
+	void run();
+
+	fluid_settings_t *settings;
+	const std::string &soundFont;
+
+	/* Render thread's synth, with the soundfont loaded */
+	fluid_synth_t *synth;
+
+	std::string dir;
+	uint64_t settingsHash;
+
+	/* In bytes, 0 if unlimited */
+	uint64_t sizeLimit;
+
+	std::deque<Job> jobs;
+	std::set<std::string> pending;
+
+	SDL_mutex *mut;
+	SDL_cond *cond;
+
+	AtomicFlag termReq;
+	SDL_Thread *thread;
+};
+
+#endif // MIDICACHE_H
@@ -28,10 +28,12 @@
 #include "util.h"
 #include "debugwriter.h"
 #include "fluid-fun.h"
+#include "midicache.h"
 
 #include <SDL_rwops.h>
 
 #include <assert.h>
+#include <stdint.h>
 #include <math.h>
 #include <vector>
 #include <algorithm>
@@ -54,6 +56,7 @@
 
 #define TICK_FRAMES 32
 #define BUF_TICKS (STREAM_BUF_SIZE / TICK_FRAMES)
+#define CACHE_FRAME_SIZE (sizeof(int16_t) * 2)
 #define DEFAULT_BPM 120
 #define MAX_CHANNELS 16
 
@@ -586,6 +589,9 @@ struct MidiSource : ALDataSource, MidiReadHandler
 	const uint16_t freq;
 	fluid_synth_t *synth;
 
+	/* Render sources borrow their synth from the caller */
+	bool ownsSynth;
+
 	int16_t synthBuf[BUF_TICKS*TICK_FRAMES*2];
 
 	std::vector<Track> tracks;
@@ -610,16 +616,43 @@ struct MidiSource : ALDataSource, MidiReadHandler
 
 	float genDeltasCarry;
 
+	/* Progress since the last seek */
+	uint64_t playedTicks;
+	uint64_t playedDeltas;
+
+	/* Frame positions at which the loop marker and the end of
+	 * the longest track were passed, or -1 if not yet reached */
+	int64_t loopFrame;
+	int64_t endFrame;
+
+	/* Pre-rendered PCM of this file, if the midi cache has one */
+	SDL_RWops *cacheOps;
+	MidiCacheHeader cacheHeader;
+	uint32_t cachePos;
+
+	/* Whether the current playback streams from 'cacheOps' */
+	bool fromCache;
+
 	/* MidiReadHandler (track that's currently being read) */
 	int16_t curTrack;
 
 	MidiSource(SDL_RWops &ops,
 	           bool looped)
 	    : freq(SYNTH_SAMPLERATE),
+	      synth(0),
+	      ownsSynth(true),
 	      looped(looped),
+	      loopDelta(0),
 	      dpb(480),
 	      pitchShift(0),
 	      genDeltasCarry(0),
+	      playedTicks(0),
+	      playedDeltas(0),
+	      loopFrame(-1),
+	      endFrame(-1),
+	      cacheOps(0),
+	      cachePos(0),
+	      fromCache(false),
 	      curTrack(-1)
 	{
 		size_t dataLen = SDL_RWsize(&ops);
@@ -641,9 +674,59 @@ struct MidiSource : ALDataSource, MidiReadHandler
 			throw;
 		}
 
-		synth = shState->midiState().allocateSynth();
+		setupTracks();
+
+		/* The synth is only allocated once playback
+		 * can't be served from the cache */
+		if (MidiCache *cache = shState->midiState().cache)
+			cacheOps = cache->open(data, cacheHeader);
+
+		updatePlaybackSpeed(DEFAULT_BPM);
+
+		// FIXME: It would make the code in 'advanceTicks' a lot nicer if
+		// we could combine all tracks into one giant one on construction,
+		// instead of having to constantly iterate through all of them
+	}
+
+	/* Unlooped source for offline rendering into the midi cache */
+	MidiSource(const std::vector<uint8_t> &data,
+	           fluid_synth_t *synth)
+	    : freq(SYNTH_SAMPLERATE),
+	      synth(synth),
+	      ownsSynth(false),
+	      looped(false),
+	      loopDelta(0),
+	      dpb(480),
+	      pitchShift(0),
+	      genDeltasCarry(0),
+	      playedTicks(0),
+	      playedDeltas(0),
+	      loopFrame(-1),
+	      endFrame(-1),
+	      cacheOps(0),
+	      cachePos(0),
+	      fromCache(false),
+	      curTrack(-1)
+	{
+		readMidi(this, data);
+		setupTracks();
+
+		updatePlaybackSpeed(DEFAULT_BPM);
+	}
+
+	~MidiSource()
+	{
+		if (cacheOps)
+			SDL_RWclose(cacheOps);
+
+		if (ownsSynth && synth)
+			shState->midiState().releaseSynth(synth);
+	}
 
+	void setupTracks()
+	{
 		uint64_t longest = 0;
+		longestI = 0;
 
 		for (size_t i = 0; i < tracks.size(); ++i)
 			if (tracks[i].length > longest)
@@ -683,38 +766,34 @@ struct MidiSource : ALDataSource, MidiReadHandler
 				break;
 			}
 		}
-
-		updatePlaybackSpeed(DEFAULT_BPM);
-
-		// FIXME: It would make the code in 'fillBuffer' a lot nicer if
-		// we could combine all tracks into one giant one on construction,
-		// instead of having to constantly iterate through all of them
 	}
 
-	~MidiSource()
-	{
-		shState->midiState().releaseSynth(synth);
-	}
-
-
 	void updatePlaybackSpeed(uint32_t bpm)
 	{
 		float deltaLength = 60.0f / (dpb * bpm);
 		playbackSpeed = TICK_FRAMES / (deltaLength * freq);
 	}
 
-	void activateEvent(const MidiEvent &e)
+	/* With 'audible' unset, notes are dropped and only
+	 * the channel and tempo state is updated */
+	void activateEvent(const MidiEvent &e, bool audible)
 	{
 		int16_t key = e.e.note.key;
 
 		/* Apply pitch shift if necessary */
-		if ((e.type == NoteOn || e.type == NoteOff) && e.e.chan.chan != 9)
+		if (e.type == NoteOn || e.type == NoteOff)
 		{
-			key += pitchShift;
-
-			/* Drop events whose keys are out of bounds */
-			if (key < 0 || key > 127)
+			if (!audible)
 				return;
+
+			if (e.e.chan.chan != 9)
+			{
+				key += pitchShift;
+
+				/* Drop events whose keys are out of bounds */
+				if (key < 0 || key > 127)
+					return;
+			}
 		}
 
 		switch (e.type)
@@ -754,51 +833,20 @@ struct MidiSource : ALDataSource, MidiReadHandler
 		fluid.synth_write_s16(synth, len, buffer, 0, 2, buffer, 1, 2);
 	}
 
-	/* MidiReadHandler */
-	void onMidiHeader(uint16_t midiType, uint16_t trackCount, uint16_t division)
-	{
-		if (midiType != 0 && midiType != 1)
-			throw Exception(Exception::MKXPError, "Midi: Type 2 not supported");
-
-		tracks.resize(trackCount);
-
-		// SMTP unhandled
-		if (division & 0x8000)
-			throw Exception(Exception::MKXPError, "Midi: SMTP parameters not supported");
-		else
-			dpb = division;
-	}
-
-	void onMidiTrackBegin()
-	{
-		++curTrack;
-	}
-
-	void onMidiEvent(const MidiEvent &e, uint32_t absDelta)
-	{
-		assert(curTrack >= 0 && curTrack < (int16_t) tracks.size());
-
-		Track &track = tracks[curTrack];
-
-		track.appendEvent(e);
-		volReset.handleEvent(e, track);
-		expReset.handleEvent(e, track);
-
-		if (e.type == CC && e.e.cc.ctrl == CC_CTRL_LOOP)
-			loopDelta = absDelta;
-	}
-
-	/* ALDataSource */
-	Status fillBuffer(AL::Buffer::ID buf)
+	/* Moves the song forward by 'ticks'. If 'render' is set,
+	 * the output is synthesized into 'synthBuf' (so at most
+	 * BUF_TICKS can be advanced at once). Otherwise, the ticks
+	 * are skipped over from one event to the next, which is
+	 * what makes seeking cheap */
+	void advanceTicks(size_t ticks, bool render)
 	{
 		/* In case there is no currently scheduled one */
 		for (size_t i = 0; i < tracks.size(); ++i)
 			tracks[i].scheduleEvent(looped);
 
-		size_t remTicks = BUF_TICKS;
+		size_t remTicks = ticks;
 
-		/* Iterate until all ticks that fit into the buffer
-		 * have been rendered */
+		/* Iterate until all ticks have been processed */
 		while (remTicks > 0)
 		{
 			/* Check for events that have to be activated now, activate them,
@@ -817,7 +865,7 @@ struct MidiSource : ALDataSource, MidiReadHandler
 
 					int32_t prevOffset = track.remDeltas;
 
-					activateEvent(track.event);
+					activateEvent(track.event, render);
 
 					track.valid = false;
 					track.scheduleEvent(looped);
@@ -833,6 +881,12 @@ struct MidiSource : ALDataSource, MidiReadHandler
 				}
 			}
 
+			if (loopFrame < 0 && playedDeltas >= loopDelta)
+				loopFrame = playedTicks * TICK_FRAMES;
+
+			if (endFrame < 0 && tracks[longestI].atEnd)
+				endFrame = playedTicks * TICK_FRAMES;
+
 			size_t nextEvent = (size_t) -1;
 			bool allInvalid = true;
 
@@ -855,14 +909,17 @@ struct MidiSource : ALDataSource, MidiReadHandler
 					nextEvent = std::max<uint32_t>(remDelta, 1);
 			}
 
-			/* Calculate amount of ticks we'll render next */
+			/* Calculate amount of ticks we'll process next */
 			size_t genTicks = allInvalid ? remTicks : std::min(remTicks, nextEvent);
 
 			if (genTicks == 0)
 				continue;
 
-			renderTicks(genTicks, BUF_TICKS - remTicks);
+			if (render)
+				renderTicks(genTicks, ticks - remTicks);
+
 			remTicks -= genTicks;
+			playedTicks += genTicks;
 
 			float genDeltas = (genTicks * playbackSpeed) + genDeltasCarry;
 
@@ -874,15 +931,157 @@ struct MidiSource : ALDataSource, MidiReadHandler
 			for (size_t i = 0; i < tracks.size(); ++i)
 				if (tracks[i].valid)
 					tracks[i].remDeltas -= intDeltas;
+
+			playedDeltas += intDeltas;
 		}
+	}
 
-		/* Fill AL buffer */
-		AL::Buffer::uploadData(buf, AL_FORMAT_STEREO16, synthBuf, sizeof(synthBuf), freq);
+	/* MidiReadHandler */
+	void onMidiHeader(uint16_t midiType, uint16_t trackCount, uint16_t division)
+	{
+		if (midiType != 0 && midiType != 1)
+			throw Exception(Exception::MKXPError, "Midi: Type 2 not supported");
+
+		tracks.resize(trackCount);
 
-		if (tracks[longestI].atEnd)
-			return EndOfStream;
+		// SMTP unhandled
+		if (division & 0x8000)
+			throw Exception(Exception::MKXPError, "Midi: SMTP parameters not supported");
+		else
+			dpb = division;
+	}
+
+	void onMidiTrackBegin()
+	{
+		++curTrack;
+	}
+
+	void onMidiEvent(const MidiEvent &e, uint32_t absDelta)
+	{
+		assert(curTrack >= 0 && curTrack < (int16_t) tracks.size());
+
+		Track &track = tracks[curTrack];
+
+		track.appendEvent(e);
+		volReset.handleEvent(e, track);
+		expReset.handleEvent(e, track);
+
+		if (e.type == CC && e.e.cc.ctrl == CC_CTRL_LOOP)
+			loopDelta = absDelta;
+	}
+
+	/* Cached render playback */
+	void seekCache(uint64_t frame)
+	{
+		const MidiCacheHeader &h = cacheHeader;
+
+		if (looped && frame >= h.loopEnd)
+			frame = h.loopStart + (frame - h.loopStart) % (h.loopEnd - h.loopStart);
+		else if (!looped)
+			frame = std::min<uint64_t>(frame, h.frames);
+
+		cachePos = frame;
+		SDL_RWseek(cacheOps, sizeof(h) + (int64_t) cachePos * CACHE_FRAME_SIZE, RW_SEEK_SET);
+	}
+
+	Status fillFromCache(AL::Buffer::ID buf)
+	{
+		const uint32_t end = looped ? cacheHeader.loopEnd : cacheHeader.frames;
+		uint32_t frames = std::min<uint32_t>(BUF_TICKS * TICK_FRAMES, end - cachePos);
+
+		if (frames > 0 && SDL_RWread(cacheOps, synthBuf, CACHE_FRAME_SIZE, frames) < frames)
+			return Error;
+
+		Status status = NoError;
+		cachePos += frames;
+
+		if (cachePos >= end)
+		{
+			if (looped)
+			{
+				status = WrapAround;
+				seekCache(cacheHeader.loopStart);
+			}
+			else
+			{
+				status = EndOfStream;
+			}
+		}
+
+		/* Never hand out an empty buffer */
+		if (frames == 0)
+		{
+			synthBuf[0] = synthBuf[1] = 0;
+			frames = 1;
+		}
+
+		uint32_t size = applyGainRamp(synthBuf, frames * CACHE_FRAME_SIZE, 2, AUDIO_S16SYS, status);
+
+		AL::Buffer::uploadData(buf, AL_FORMAT_STEREO16, synthBuf, size, freq);
 
-		return NoError;
+		return status;
+	}
+
+	/* Writes one pass of the song, header included, to 'out' */
+	bool renderToFile(SDL_RWops &out, const AtomicFlag &abortReq)
+	{
+		MidiCacheHeader header;
+		memcpy(header.magic, MIDICACHE_MAGIC, 4);
+		header.version = MIDICACHE_VERSION;
+		header.frames = header.loopStart = header.loopEnd = 0;
+
+		/* Placeholder until the markers are known */
+		if (SDL_RWwrite(&out, &header, sizeof(header), 1) != 1)
+			return false;
+
+		seekToOffset(0);
+
+		uint64_t frames = 0;
+
+		/* The buffer in which the longest track ends also
+		 * captures the start of the decay after it, same
+		 * as with live playback */
+		while (endFrame < 0)
+		{
+			if (abortReq)
+				return false;
+
+			advanceTicks(BUF_TICKS, true);
+
+			if (SDL_RWwrite(&out, synthBuf, sizeof(synthBuf), 1) != 1)
+				return false;
+
+			frames += BUF_TICKS * TICK_FRAMES;
+
+			if (frames > INT32_MAX)
+				return false;
+		}
+
+		header.frames = frames;
+		header.loopEnd = (endFrame > 0) ? endFrame : frames;
+		header.loopStart = (loopFrame > 0 && loopFrame < header.loopEnd) ? loopFrame : 0;
+
+		if (SDL_RWseek(&out, 0, RW_SEEK_SET) != 0)
+			return false;
+
+		return SDL_RWwrite(&out, &header, sizeof(header), 1) == 1;
+	}
+
+	/* ALDataSource */
+	Status fillBuffer(AL::Buffer::ID buf)
+	{
+		if (fromCache)
+			return fillFromCache(buf);
+
+		advanceTicks(BUF_TICKS, true);
+
+		Status status = tracks[longestI].atEnd ? EndOfStream : NoError;
+		uint32_t size = applyGainRamp(synthBuf, sizeof(synthBuf), 2, AUDIO_S16SYS, status);
+
+		/* Fill AL buffer */
+		AL::Buffer::uploadData(buf, AL_FORMAT_STEREO16, synthBuf, size, freq);
+
+		return status;
 	}
 
 	int sampleRate()
@@ -890,22 +1089,49 @@ struct MidiSource : ALDataSource, MidiReadHandler
 		return freq;
 	}
 
-	/* Midi sources cannot seek, and so always reset to beginning */
-	void seekToOffset(float)
+	void seekToOffset(float seconds)
 	{
+		seconds = std::max(seconds, 0.0f);
+
+		/* The cached render is only valid at the original pitch */
+		fromCache = (cacheOps && pitchShift == 0);
+
+		if (fromCache)
+		{
+			seekCache(seconds * freq);
+			return;
+		}
+
+		if (!synth)
+			synth = shState->midiState().allocateSynth();
+
 		/* Reset synth */
 		fluid.synth_system_reset(synth);
 
 		/* Reset runtime variables */
 		genDeltasCarry = 0;
+		playedTicks = playedDeltas = 0;
+		loopFrame = endFrame = -1;
 		updatePlaybackSpeed(DEFAULT_BPM);
 
 		/* Reset tracks */
 		for (size_t i = 0; i < tracks.size(); ++i)
 			tracks[i].reset();
+
+		/* Replay all events up to the target without synthesizing
+		 * anything, so that programs, controllers and tempo are
+		 * exactly as they would be had we played up to here */
+		if (seconds > 0)
+			advanceTicks(seconds * freq / TICK_FRAMES, false);
 	}
 
-	uint32_t loopStartFrames() { return 0; }
+	uint32_t loopStartFrames()
+	{
+		if (fromCache && looped)
+			return cacheHeader.loopStart;
+
+		return 0;
+	}
 
 	bool setPitch(float value)
 	{
@@ -921,3 +1147,21 @@ ALDataSource *createMidiSource(SDL_RWops &ops,
 {
 	return new MidiSource(ops, looped);
 }
+
+bool renderMidiFile(const std::vector<uint8_t> &data,
+                    fluid_synth_t *synth, SDL_RWops &out,
+                    const AtomicFlag &abortReq)
+{
+	try
+	{
+		MidiSource source(data, synth);
+
+		return source.renderToFile(out, abortReq);
+	}
+	catch (const Exception &e)
+	{
+		Debug() << "Midi cache:" << e.msg;
+	}
+
+	return false;
+}
@@ -78,22 +78,27 @@ struct SDLSoundSource : ALDataSource
 		if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
 			return ALDataSource::Error;
 
-		AL::Buffer::uploadData(alBuffer, alFormat, sample->buffer, decoded, alFreq);
+		Status status = ALDataSource::NoError;
 
 		if (sample->flags & SOUND_SAMPLEFLAG_EOF)
 		{
 			if (looped)
 			{
 				Sound_Rewind(sample);
-				return ALDataSource::WrapAround;
+				status = ALDataSource::WrapAround;
 			}
 			else
 			{
-				return ALDataSource::EndOfStream;
+				status = ALDataSource::EndOfStream;
 			}
 		}
 
-		return ALDataSource::NoError;
+		decoded = applyGainRamp(sample->buffer, decoded, sample->actual.channels,
+		                        sample->actual.format, status);
+
+		AL::Buffer::uploadData(alBuffer, alFormat, sample->buffer, decoded, alFreq);
+
+		return status;
 	}
 
 	int sampleRate()
@@ -25,8 +25,14 @@
 #include "config.h"
 #include "debugwriter.h"
 #include "fluid-fun.h"
+#include "midicache.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
 
 #include <assert.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -39,6 +45,10 @@ struct Synth
 	bool inUse;
 };
 
+/* Loading a big soundfont can take seconds, so synths are
+ * created on a background loader thread. 'allocateSynth()'
+ * only blocks if a midi track is started before a free synth
+ * has become available */
 struct SharedMidiState
 {
 	bool inited;
@@ -46,18 +56,54 @@ struct SharedMidiState
 	const std::string &soundFont;
 	fluid_settings_t *flSettings;
 
+	/* Null unless enabled via 'midiCache' */
+	MidiCache *cache;
+
+	/* Guards 'synths' and 'wantSynths' */
+	SDL_mutex *mut;
+	SDL_cond *cond;
+
+	/* Number of synths the loader keeps around */
+	size_t wantSynths;
+
+	AtomicFlag termReq;
+	SDL_Thread *loader;
+
 	SharedMidiState(const Config &conf)
 	    : inited(false),
-	      soundFont(conf.midi.soundFont)
-	{}
+	      soundFont(conf.midi.soundFont),
+	      cache(0),
+	      wantSynths(SYNTH_INIT_COUNT),
+	      loader(0)
+	{
+		mut = SDL_CreateMutex();
+		cond = SDL_CreateCond();
+	}
 
 	~SharedMidiState()
 	{
+		if (loader)
+		{
+			SDL_LockMutex(mut);
+			termReq.set();
+			SDL_CondBroadcast(cond);
+			SDL_UnlockMutex(mut);
+
+			/* Waits out a synth creation in progress */
+			SDL_WaitThread(loader, 0);
+		}
+
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mut);
+
 		/* We might have initialized, but if the consecutive libfluidsynth
 		 * load failed, no resources will have been allocated */
 		if (!inited || !HAVE_FLUID)
 			return;
 
+		/* Stops the render thread, which uses our settings */
+		delete cache;
+
 		fluid.delete_settings(flSettings);
 
 		for (size_t i = 0; i < synths.size(); ++i)
@@ -67,26 +113,15 @@ struct SharedMidiState
 		}
 	}
 
+	/* Returns immediately; the soundfont is loaded in the
+	 * background. Called on setup_midi (or on startup before
+	 * RGSS3), and on the first midi file opened, which may
+	 * happen on the audio prefetch thread */
 	void initIfNeeded(const Config &conf)
 	{
-		if (inited)
-			return;
-
-		inited = true;
-
-		initFluidFunctions();
-
-		if (!HAVE_FLUID)
-			return;
-
-		flSettings = fluid.new_settings();
-		fluid.settings_setnum(flSettings, "synth.gain", 1.0f);
-		fluid.settings_setnum(flSettings, "synth.sample-rate", SYNTH_SAMPLERATE);
-		fluid.settings_setint(flSettings, "synth.chorus.active", conf.midi.chorus);
-		fluid.settings_setint(flSettings, "synth.reverb.active", conf.midi.reverb);
-
-		for (size_t i = 0; i < SYNTH_INIT_COUNT; ++i)
-			addSynth(false);
+		SDL_LockMutex(mut);
+		initLocked(conf);
+		SDL_UnlockMutex(mut);
 	}
 
 	fluid_synth_t *allocateSynth()
@@ -94,28 +129,57 @@ struct SharedMidiState
 		assert(HAVE_FLUID);
 		assert(inited);
 
+		SDL_LockMutex(mut);
+
 		size_t i;
+		bool waited = false;
 
-		for (i = 0; i < synths.size(); ++i)
-			if (!synths[i].inUse)
+		while (true)
+		{
+			for (i = 0; i < synths.size(); ++i)
+				if (!synths[i].inUse)
+					break;
+
+			if (i < synths.size())
 				break;
 
-		if (i < synths.size())
-		{
-			fluid_synth_t *syn = synths[i].synth;
-			fluid.synth_system_reset(syn);
-			synths[i].inUse = true;
+			/* Every synth is taken, or the loader hasn't
+			 * gotten around to creating one yet */
+			if (!waited)
+				Debug() << "Midi: Waiting for a synth to be loaded";
 
-			return syn;
+			waited = true;
+			wantSynths = std::max(wantSynths, synths.size() + 1);
+			SDL_CondBroadcast(cond);
+			SDL_CondWait(cond, mut);
 		}
-		else
+
+		fluid_synth_t *syn = synths[i].synth;
+		synths[i].inUse = true;
+
+		/* Warm up a spare for the next concurrent stream
+		 * if we just took the last free one */
+		size_t inUse = 0;
+		for (size_t j = 0; j < synths.size(); ++j)
+			inUse += synths[j].inUse;
+
+		if (inUse == synths.size())
 		{
-			return addSynth(true);
+			wantSynths = std::max(wantSynths, synths.size() + 1);
+			SDL_CondBroadcast(cond);
 		}
+
+		SDL_UnlockMutex(mut);
+
+		fluid.synth_system_reset(syn);
+
+		return syn;
 	}
 
 	void releaseSynth(fluid_synth_t *synth)
 	{
+		SDL_LockMutex(mut);
+
 		size_t i;
 
 		for (i = 0; i < synths.size(); ++i)
@@ -125,25 +189,80 @@ struct SharedMidiState
 		assert(i < synths.size());
 
 		synths[i].inUse = false;
+
+		SDL_CondBroadcast(cond);
+		SDL_UnlockMutex(mut);
 	}
 
 private:
-	fluid_synth_t *addSynth(bool usedNow)
+	void initLocked(const Config &conf)
+	{
+		if (inited)
+			return;
+
+		inited = true;
+
+		initFluidFunctions();
+
+		if (!HAVE_FLUID)
+			return;
+
+		flSettings = fluid.new_settings();
+		fluid.settings_setnum(flSettings, "synth.gain", 1.0f);
+		fluid.settings_setnum(flSettings, "synth.sample-rate", SYNTH_SAMPLERATE);
+		fluid.settings_setint(flSettings, "synth.chorus.active", conf.midi.chorus);
+		fluid.settings_setint(flSettings, "synth.reverb.active", conf.midi.reverb);
+
+		if (soundFont.empty())
+			Debug() << "Warning: No soundfont specified, sound might be mute";
+
+		loader = createSDLThread
+			<SharedMidiState, &SharedMidiState::loaderFun>(this, "midi_loader");
+
+		/* Without a soundfont, there's nothing worth caching */
+		if (conf.midi.cache && !soundFont.empty())
+			cache = new MidiCache(conf, flSettings);
+	}
+
+	fluid_synth_t *createSynth()
 	{
 		fluid_synth_t *syn = fluid.new_synth(flSettings);
 
 		if (!soundFont.empty())
 			fluid.synth_sfload(syn, soundFont.c_str(), 1);
-		else
-			Debug() << "Warning: No soundfont specified, sound might be mute";
-
-		Synth synth;
-		synth.inUse = usedNow;
-		synth.synth = syn;
-		synths.push_back(synth);
 
 		return syn;
 	}
+
+	/* thread func */
+	void loaderFun()
+	{
+		SDL_LockMutex(mut);
+
+		while (!termReq)
+		{
+			if (synths.size() >= wantSynths)
+			{
+				SDL_CondWait(cond, mut);
+				continue;
+			}
+
+			/* Don't hold up allocations of
+			 * already existing synths */
+			SDL_UnlockMutex(mut);
+			fluid_synth_t *syn = createSynth();
+			SDL_LockMutex(mut);
+
+			Synth synth;
+			synth.inUse = false;
+			synth.synth = syn;
+			synths.push_back(synth);
+
+			SDL_CondBroadcast(cond);
+		}
+
+		SDL_UnlockMutex(mut);
+	}
 };
 
 #endif // SHAREDMIDISTATE_H
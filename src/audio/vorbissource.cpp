@@ -262,8 +262,13 @@ struct VorbisSource : ALDataSource
 		}
 
 		if (retStatus != ALDataSource::Error)
+		{
+			uint32_t size = applyGainRamp(sampleBuf.data(), bufUsed*sizeof(int16_t),
+			                              info.channels, AUDIO_S16SYS, retStatus);
+
 			AL::Buffer::uploadData(alBuffer, info.alFormat, sampleBuf.data(),
-			                       bufUsed*sizeof(int16_t), info.rate);
+			                       size, info.rate);
+		}
 
 		return retStatus;
 	}
@@ -150,6 +150,7 @@ void Config::read(int argc, char *argv[]) {
         {"fixedFramerate", 0},
         {"frameSkip", false},
         {"syncToRefreshrate", false},
+        {"lateInputLatch", false},
         {"solidFonts", json::array({})},
 #if defined(__APPLE__) && defined(__aarch64__)
         {"preferMetalRenderer", true},
@@ -177,6 +178,8 @@ void Config::read(int argc, char *argv[]) {
         {"midiSoundFont", ""},
         {"midiChorus", false},
         {"midiReverb", false},
+        {"midiCache", false},
+        {"midiCacheLimit", 512},
         {"SESourceCount", 6},
         {"BGMTrackCount", 1},
         {"customScript", ""},
@@ -192,6 +195,10 @@ void Config::read(int argc, char *argv[]) {
         {"JITMaxCache", 100},
         {"JITMinCalls", 10000},
         {"YJITEnable", false},
+        {"gcScheduling", false},
+        {"gcSafetyLimit", 1000000},
+        {"profilerEnable", false},
+        {"profilerInterval", 10},
         {"dumpAtlas", false},
         {"bindingNames", json::object({
             {"a", "A"},
@@ -245,6 +252,10 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(jit.maxCache, JITMaxCache, integer);
     SET_OPT_CUSTOMKEY(jit.minCalls, JITMinCalls, integer);
     SET_OPT_CUSTOMKEY(yjit.enabled, YJITEnable, boolean);
+    SET_OPT_CUSTOMKEY(gcScheduler.enabled, gcScheduling, boolean);
+    SET_OPT_CUSTOMKEY(gcScheduler.safetyLimit, gcSafetyLimit, integer);
+    SET_OPT_CUSTOMKEY(profiler.enabled, profilerEnable, boolean);
+    SET_OPT_CUSTOMKEY(profiler.interval, profilerInterval, integer);
     SET_OPT(rgssVersion, integer);
     SET_OPT(defScreenW, integer);
     SET_OPT(defScreenH, integer);
@@ -283,6 +294,7 @@ try { exp } catch (...) {}
     SET_OPT(fixedFramerate, integer);
     SET_OPT(frameSkip, boolean);
     SET_OPT(syncToRefreshrate, boolean);
+    SET_OPT(lateInputLatch, boolean);
     fillStringVec(opts["solidFonts"], solidFonts);
     for (std::string & solidFont : solidFonts)
         std::transform(solidFont.begin(), solidFont.end(), solidFont.begin(),
@@ -301,6 +313,8 @@ try { exp } catch (...) {}
     SET_STRINGOPT(midi.soundFont, midiSoundFont);
     SET_OPT_CUSTOMKEY(midi.chorus, midiChorus, boolean);
     SET_OPT_CUSTOMKEY(midi.reverb, midiReverb, boolean);
+    SET_OPT_CUSTOMKEY(midi.cache, midiCache, boolean);
+    SET_OPT_CUSTOMKEY(midi.cacheLimit, midiCacheLimit, integer);
     SET_OPT_CUSTOMKEY(SE.sourceCount, SESourceCount, integer);
     SET_OPT_CUSTOMKEY(BGM.trackCount, BGMTrackCount, integer);
     SET_STRINGOPT(customScript, customScript);
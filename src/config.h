@@ -61,6 +61,7 @@ struct Config {
     int fixedFramerate;
     bool frameSkip;
     bool syncToRefreshrate;
+    bool lateInputLatch;
     
     std::vector<std::string> solidFonts;
     
@@ -93,6 +94,8 @@ struct Config {
         std::string soundFont;
         bool chorus;
         bool reverb;
+        bool cache;
+        int cacheLimit;
     } midi;
     
     struct {
@@ -140,6 +143,18 @@ struct Config {
     struct {
         bool enabled;
     } yjit;
+    
+    // GC scheduler options
+    struct {
+        bool enabled;
+        int safetyLimit;
+    } gcScheduler;
+    
+    // Script profiler options
+    struct {
+        bool enabled;
+        int interval;
+    } profiler;
 
     bool dumpAtlas;
 
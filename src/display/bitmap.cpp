@@ -632,6 +632,35 @@ Bitmap::Bitmap(const char *filename)
     initFromSurface(imgSurf, hiresBitmap, true);
 }
 
+SDL_Surface *Bitmap::decodeFile(const char *filename)
+{
+    BitmapOpenHandler handler;
+    shState->fileSystem().openRead(handler, filename);
+    
+    if (!handler.error.empty()) {
+        throw Exception(Exception::SDLError, "Error loading image '%s': %s", filename, handler.error.c_str());
+    }
+    else if (handler.gif) {
+        // Animations are uploaded frame by frame, leave them to Bitmap(filename)
+        gif_finalise(handler.gif);
+        delete handler.gif;
+        delete handler.gif_data;
+        return 0;
+    }
+    else if (!handler.surface) {
+        throw Exception(Exception::SDLError, "Error loading image '%s': %s",
+                        filename, SDL_GetError());
+    }
+    
+    BitmapPrivate::ensureFormat(handler.surface, SDL_PIXELFORMAT_ABGR8888);
+    
+    if (!handler.surface)
+        throw Exception(Exception::SDLError, "Error converting image '%s': %s",
+                        filename, SDL_GetError());
+    
+    return handler.surface;
+}
+
 Bitmap::Bitmap(int width, int height, bool isHires)
 {
     if (width <= 0 || height <= 0)
@@ -797,17 +826,17 @@ Bitmap::Bitmap(TEXFBO &other)
     p->addTaintedArea(rect());
 }
 
-Bitmap::Bitmap(SDL_Surface *imgSurf, SDL_Surface *imgSurfHires)
+Bitmap::Bitmap(SDL_Surface *imgSurf, SDL_Surface *imgSurfHires, bool freeSurface)
 {
     Bitmap *hiresBitmap = nullptr;
 
     if (imgSurfHires != nullptr) {
         // Create a high-res version as well.
-        hiresBitmap = new Bitmap(imgSurfHires, nullptr);
+        hiresBitmap = new Bitmap(imgSurfHires, nullptr, freeSurface);
         hiresBitmap->setLores(this);
     }
 
-    initFromSurface(imgSurf, hiresBitmap, false);
+    initFromSurface(imgSurf, hiresBitmap, freeSurface);
 }
 
 Bitmap::~Bitmap()
@@ -42,7 +42,8 @@ public:
 	Bitmap(int width, int height, bool isHires = false);
 	Bitmap(void *pixeldata, int width, int height);
 	Bitmap(TEXFBO &other);
-	Bitmap(SDL_Surface *imgSurf, SDL_Surface *imgSurfHires);
+	/* With 'freeSurface', the Bitmap takes ownership of the surfaces */
+	Bitmap(SDL_Surface *imgSurf, SDL_Surface *imgSurfHires, bool freeSurface = false);
 
 	/* Clone constructor */
     
@@ -169,6 +170,12 @@ public:
 	sigslot::signal<> modified;
 
 	static int maxSize();
+
+	/* Reads and decodes a still image into a surface suitable for
+	 * Bitmap(SDL_Surface*, ...). Touches no GL state, so it may be
+	 * called from any thread. Returns null for animated images,
+	 * which have to be loaded through Bitmap(filename) */
+	static SDL_Surface *decodeFile(const char *filename);
     
     bool invalid() const;
 
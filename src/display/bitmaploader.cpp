@@ -0,0 +1,201 @@
+/*
+** bitmaploader.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitmaploader.h"
+
+#include "bitmap.h"
+#include "config.h"
+#include "debugwriter.h"
+#include "sharedstate.h"
+
+#include <SDL_surface.h>
+
+#define HIRES_PREFIX "Hires/"
+
+BitmapLoader::BitmapLoader()
+    : nextId(0),
+      thread(0)
+{
+	mut = SDL_CreateMutex();
+	cond = SDL_CreateCond();
+}
+
+BitmapLoader::~BitmapLoader()
+{
+	if (thread)
+	{
+		SDL_LockMutex(mut);
+		termReq.set();
+		SDL_CondSignal(cond);
+		SDL_UnlockMutex(mut);
+
+		SDL_WaitThread(thread, 0);
+	}
+
+	for (size_t i = 0; i < finished.size(); ++i)
+		discard(finished[i]);
+
+	SDL_DestroyCond(cond);
+	SDL_DestroyMutex(mut);
+}
+
+int BitmapLoader::load(const char *filename)
+{
+	SDL_LockMutex(mut);
+
+	/* Most games never load anything in the background,
+	 * so only spin up the thread once it's needed */
+	if (!thread)
+		thread = createSDLThread
+			<BitmapLoader, &BitmapLoader::run>(this, "bitmap_loader");
+
+	Job job;
+	job.id = nextId++;
+	job.filename = filename;
+
+	jobs.push_back(job);
+	SDL_CondSignal(cond);
+
+	SDL_UnlockMutex(mut);
+
+	return job.id;
+}
+
+bool BitmapLoader::takeFinished(Result &out)
+{
+	SDL_LockMutex(mut);
+
+	bool found = !finished.empty();
+
+	if (found)
+	{
+		out = finished.front();
+		finished.pop_front();
+	}
+
+	SDL_UnlockMutex(mut);
+
+	return found;
+}
+
+Bitmap *BitmapLoader::createBitmap(Result &result)
+{
+	if (!result.error.empty())
+		throw Exception(result.errorType, "%s", result.error.c_str());
+
+	if (!result.surface)
+		return new Bitmap(result.filename.c_str());
+
+	SDL_Surface *surf = result.surface;
+	SDL_Surface *hires = result.hires;
+	result.surface = result.hires = 0;
+
+	return new Bitmap(surf, hires, true);
+}
+
+void BitmapLoader::discard(Result &result)
+{
+	if (result.surface)
+		SDL_FreeSurface(result.surface);
+	if (result.hires)
+		SDL_FreeSurface(result.hires);
+
+	result.surface = result.hires = 0;
+}
+
+void BitmapLoader::clear()
+{
+	SDL_LockMutex(mut);
+
+	jobs.clear();
+
+	for (size_t i = 0; i < finished.size(); ++i)
+		discard(finished[i]);
+
+	finished.clear();
+
+	SDL_UnlockMutex(mut);
+}
+
+void BitmapLoader::decode(const Job &job, Result &result)
+{
+	result.id = job.id;
+	result.filename = job.filename;
+	result.surface = 0;
+	result.hires = 0;
+	result.errorType = Exception::MKXPError;
+
+	try
+	{
+		result.surface = Bitmap::decodeFile(job.filename.c_str());
+	}
+	catch (const Exception &e)
+	{
+		result.errorType = e.type;
+		result.error = e.msg.c_str();
+		return;
+	}
+
+	if (!result.surface)
+		return;
+
+	if (!shState->config().enableHires
+	||  job.filename.compare(0, sizeof(HIRES_PREFIX)-1, HIRES_PREFIX) == 0)
+		return;
+
+	std::string hiresFilename = HIRES_PREFIX + job.filename;
+
+	try
+	{
+		result.hires = Bitmap::decodeFile(hiresFilename.c_str());
+	}
+	catch (const Exception &e)
+	{
+		Debug() << "No high-res Bitmap found at" << hiresFilename;
+	}
+}
+
+/* thread func */
+void BitmapLoader::run()
+{
+	SDL_LockMutex(mut);
+
+	while (!termReq)
+	{
+		if (jobs.empty())
+		{
+			SDL_CondWait(cond, mut);
+			continue;
+		}
+
+		Job job = jobs.front();
+		jobs.pop_front();
+
+		SDL_UnlockMutex(mut);
+
+		Result result;
+		decode(job, result);
+
+		SDL_LockMutex(mut);
+
+		finished.push_back(result);
+	}
+
+	SDL_UnlockMutex(mut);
+}
@@ -0,0 +1,102 @@
+/*
+** bitmaploader.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITMAPLOADER_H
+#define BITMAPLOADER_H
+
+#include "exception.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <deque>
+#include <string>
+
+struct SDL_Surface;
+class Bitmap;
+
+/* Reads and decodes image files on a background thread.
+ * Only the texture upload, which needs the GL context, is
+ * left to the RGSS thread when the result is collected */
+struct BitmapLoader
+{
+	struct Result
+	{
+		int id;
+		std::string filename;
+
+		/* Decoded image and its Hires counterpart, if any.
+		 * A null 'surface' with an empty 'error' means the
+		 * file is animated and has to be loaded in full */
+		SDL_Surface *surface;
+		SDL_Surface *hires;
+
+		Exception::Type errorType;
+		std::string error;
+	};
+
+	BitmapLoader();
+	~BitmapLoader();
+
+	/* Queues 'filename' and returns the id
+	 * its result will be reported under */
+	int load(const char *filename);
+
+	/* Moves the oldest finished load into 'out'. The caller
+	 * takes ownership of its surfaces. Returns false if
+	 * nothing has finished */
+	bool takeFinished(Result &out);
+
+	/* Creates the Bitmap for a finished load, freeing
+	 * its surfaces. Must be called on the RGSS thread,
+	 * throws on error */
+	static Bitmap *createBitmap(Result &result);
+
+	/* Frees the surfaces of a load that won't be used */
+	static void discard(Result &result);
+
+	/* Drops all pending and finished loads. A load
+	 * that is already being decoded still finishes */
+	void clear();
+
+private:
+	struct Job
+	{
+		int id;
+		std::string filename;
+	};
+
+	void decode(const Job &job, Result &result);
+
+	/* thread func */
+	void run();
+
+	std::deque<Job> jobs;
+	std::deque<Result> finished;
+	int nextId;
+
+	SDL_mutex *mut;
+	SDL_cond *cond;
+
+	AtomicFlag termReq;
+	SDL_Thread *thread;
+};
+
+#endif // BITMAPLOADER_H
@@ -204,4 +204,8 @@ void initGLFunctions()
     
     if (!gles || glMajor >= 3 || HAVE_EXT(OES_texture_npot))
         gl.npot_repeat = true;
+    
+    /* Core since GL 2.1, which we can't tell apart from 2.0 here */
+    if ((!gles && HAVE_EXT(ARB_pixel_buffer_object)) || glMajor >= 3)
+        gl.pixel_buffer = true;
 }
@@ -224,6 +224,7 @@ struct GLFunctions
 	bool glsles;
 	bool unpack_subimage;
 	bool npot_repeat;
+	bool pixel_buffer;
 
 #undef GL_FUN
 };
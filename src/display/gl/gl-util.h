@@ -196,6 +196,13 @@ typedef struct GenericBO<GL_ARRAY_BUFFER> VBO;
 /* Index Buffer Object */
 typedef struct GenericBO<GL_ELEMENT_ARRAY_BUFFER> IBO;
 
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+
+/* Pixel Buffer Object (texture uploads), see 'gl.pixel_buffer' */
+typedef struct GenericBO<GL_PIXEL_UNPACK_BUFFER> PBO;
+
 #undef DEF_GL_ID
 
 /* Convenience struct wrapping a framebuffer
@@ -39,11 +39,13 @@
 #include "bitmapBlit.frag.xxd"
 #include "plane.frag.xxd"
 #include "gray.frag.xxd"
+#include "yuv.frag.xxd"
 #include "flatColor.frag.xxd"
 #include "simple.frag.xxd"
 #include "simpleColor.frag.xxd"
 #include "simpleAlpha.frag.xxd"
 #include "simpleAlphaUni.frag.xxd"
+#include "particle.frag.xxd"
 #include "tilemap.frag.xxd"
 #include "flashMap.frag.xxd"
 #include "bicubic.frag.xxd"
@@ -371,6 +373,14 @@ SimpleAlphaShader::SimpleAlphaShader()
 }
 
 
+ParticleShader::ParticleShader()
+{
+	INIT_SHADER(simpleColor, particle, ParticleShader);
+
+	ShaderBase::init();
+}
+
+
 SimpleSpriteShader::SimpleSpriteShader()
 {
 	INIT_SHADER(sprite, simple, SimpleSpriteShader);
@@ -623,6 +633,27 @@ void GrayShader::setGray(float value)
 }
 
 
+YUVShader::YUVShader()
+{
+	INIT_SHADER(simple, yuv, YUVShader);
+
+	ShaderBase::init();
+
+	GET_U(texU);
+	GET_U(texV);
+}
+
+void YUVShader::setTexU(TEX::ID tex)
+{
+	setTexUniform(u_texU, 1, tex);
+}
+
+void YUVShader::setTexV(TEX::ID tex)
+{
+	setTexUniform(u_texV, 2, tex);
+}
+
+
 TilemapShader::TilemapShader()
 {
 	INIT_SHADER(tilemap, tilemap, TilemapShader);
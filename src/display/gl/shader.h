@@ -130,6 +130,13 @@ public:
 	SimpleAlphaShader();
 };
 
+/* Texture modulated by vertex color */
+class ParticleShader : public ShaderBase
+{
+public:
+	ParticleShader();
+};
+
 class SimpleSpriteShader : public ShaderBase
 {
 public:
@@ -234,6 +241,19 @@ private:
 	GLint u_gray;
 };
 
+/* Planar YCbCr (movie frames) to RGB */
+class YUVShader : public ShaderBase
+{
+public:
+	YUVShader();
+
+	void setTexU(TEX::ID tex);
+	void setTexV(TEX::ID tex);
+
+private:
+	GLint u_texU, u_texV;
+};
+
 class TilemapShader : public ShaderBase
 {
 public:
@@ -372,11 +392,13 @@ struct ShaderSet
 	SimpleShader simple;
 	SimpleColorShader simpleColor;
 	SimpleAlphaShader simpleAlpha;
+	ParticleShader particle;
 	SimpleSpriteShader simpleSprite;
 	AlphaSpriteShader alphaSprite;
 	SpriteShader sprite;
 	PlaneShader plane;
 	GrayShader gray;
+	YUVShader yuv;
 	TilemapShader tilemap;
 	FlashMapShader flashMap;
 	TransShader trans;
@@ -40,6 +40,7 @@
 #include "scene.h"
 #include "shader.h"
 #include "sharedstate.h"
+#include "tween.h"
 #include "texpool.h"
 #include "theoraplay/theoraplay.h"
 #include "util.h"
@@ -76,12 +77,19 @@
 #define MOVIE_AUDIO_BUFFER_SIZE 2048
 #define AUDIO_BUFFER_LEN_MS 2000
 
-typedef struct AudioQueue
+/* Must be a power of two. At around 20-50ms per Vorbis packet,
+ * this comfortably holds AUDIO_BUFFER_LEN_MS worth of audio */
+#define MOVIE_AUDIO_RING_SIZE 256
+
+/* Frame N+1 is uploaded while frame N is still being displayed,
+ * so two buffers keep the transfers from waiting on each other */
+#define MOVIE_PBO_COUNT 2
+
+struct AudioRingEntry
 {
     const THEORAPLAY_AudioPacket *audio;
     int offset;
-    struct AudioQueue *next;
-} AudioQueue;
+};
 
 
 static long readMovie(THEORAPLAY_Io *io, void *buf, long buflen)
@@ -108,20 +116,71 @@ struct Movie
     bool hasAudio;
     bool skippable;
     Bitmap *videoBitmap;
+    /* Y, U and V planes of the current frame */
+    TEX::ID planes[3];
+    /* Staging buffers for plane uploads, if supported */
+    PBO::ID pbos[MOVIE_PBO_COUNT];
+    int pboIndex;
+    /* 'video' has already been uploaded into 'planes' */
+    bool videoStaged;
     SDL_RWops srcOps;
     SDL_Thread *audioThread;
     AtomicFlag audioThreadTermReq;
-    volatile AudioQueue *audioQueueHead;
-    volatile AudioQueue *audioQueueTail;
+    /* Packets in [audioRingRead, audioRingWrite) are queued,
+     * both indices only ever increase. Guarded by 'audioMutex' */
+    AudioRingEntry audioRing[MOVIE_AUDIO_RING_SIZE];
+    unsigned int audioRingRead;
+    unsigned int audioRingWrite;
     ALuint audioSource;
     ALuint alBuffers[STREAM_BUFS];
     ALshort audioBuffer[MOVIE_AUDIO_BUFFER_SIZE];
     SDL_mutex *audioMutex;
+    /* Signalled by the decoder thread whenever it made progress;
+     * 'decodeSeq' counts the notifications so none get lost */
+    SDL_mutex *decodeMutex;
+    SDL_cond *decodeCond;
+    unsigned int decodeSeq;
     
     Movie(bool skippable_)
-    : decoder(0), audio(0), video(0), skippable(skippable_), videoBitmap(0), audioThread(0)
+    : decoder(0), audio(0), video(0), hasVideo(false), hasAudio(false), skippable(skippable_),
+      videoBitmap(0), pboIndex(0), videoStaged(false), audioThread(0),
+      audioRingRead(0), audioRingWrite(0), audioMutex(0), decodeSeq(0)
+    {
+        decodeMutex = SDL_CreateMutex();
+        decodeCond = SDL_CreateCond();
+    }
+    
+    static void decoderNotify(void *userdata)
+    {
+        Movie *self = static_cast<Movie*>(userdata);
+        
+        SDL_LockMutex(self->decodeMutex);
+        ++self->decodeSeq;
+        SDL_CondBroadcast(self->decodeCond);
+        SDL_UnlockMutex(self->decodeMutex);
+    }
+    
+    // Take this before polling the decoder, and pass it to
+    // waitDecoder() if there was nothing there yet
+    unsigned int decodeProgress()
+    {
+        SDL_LockMutex(decodeMutex);
+        unsigned int seq = decodeSeq;
+        SDL_UnlockMutex(decodeMutex);
+        
+        return seq;
+    }
+    
+    // Sleeps until the decoder made progress since 'seq' was taken,
+    // or 'timeout' ms have passed
+    void waitDecoder(unsigned int seq, Uint32 timeout)
     {
+        SDL_LockMutex(decodeMutex);
+        if (decodeSeq == seq)
+            SDL_CondWaitTimeout(decodeCond, decodeMutex, timeout);
+        SDL_UnlockMutex(decodeMutex);
     }
+    
     bool preparePlayback()
     {
         
@@ -136,15 +195,19 @@ struct Movie
         io->read = readMovie;
         io->close = closeMovie;
         io->userdata = &srcOps;
-        decoder = THEORAPLAY_startDecode(io, DEF_MAX_VIDEO_FRAMES, THEORAPLAY_VIDFMT_RGBA);
+        // Frames stay planar; colour conversion happens on the GPU
+        decoder = THEORAPLAY_startDecode(io, DEF_MAX_VIDEO_FRAMES, THEORAPLAY_VIDFMT_IYUV);
         if (!decoder) {
             SDL_RWclose(&srcOps);
             return false;
         }
+        THEORAPLAY_setNotify(decoder, decoderNotify, this);
         
         // Wait until the decoder has parsed out some basic truths from the file.
+        unsigned int seq = decodeProgress();
         while (!THEORAPLAY_isInitialized(decoder)) {
-            SDL_Delay(VIDEO_DELAY);
+            waitDecoder(seq, VIDEO_DELAY);
+            seq = decodeProgress();
         }
         
         // Once we're initialized, we can tell if this file has audio and/or video.
@@ -153,73 +216,172 @@ struct Movie
         
         // Queue up the audio
         if (hasAudio) {
+            seq = decodeProgress();
             while ((audio = THEORAPLAY_getAudio(decoder)) == NULL) {
                 if ((THEORAPLAY_availableVideo(decoder) >= DEF_MAX_VIDEO_FRAMES)) {
                     break;  // we'll never progress, there's no audio yet but we've prebuffered as much as we plan to.
                 }
-                SDL_Delay(VIDEO_DELAY);
+                waitDecoder(seq, VIDEO_DELAY);
+                seq = decodeProgress();
             }
         }
         
         // No video, so no point in doing anything else
         if (!hasVideo) {
             THEORAPLAY_stopDecode(decoder);
+            decoder = NULL;
             return false;
         }
         
         // Wait until we have video
+        seq = decodeProgress();
         while ((video = THEORAPLAY_getVideo(decoder)) == NULL) {
-            SDL_Delay(VIDEO_DELAY);
+            waitDecoder(seq, VIDEO_DELAY);
+            seq = decodeProgress();
         }
         
         // Wait until we have audio, if applicable
         audio = NULL;
         if (hasAudio) {
+            seq = decodeProgress();
             while ((audio = THEORAPLAY_getAudio(decoder)) == NULL && THEORAPLAY_availableVideo(decoder) < DEF_MAX_VIDEO_FRAMES) {
-                SDL_Delay(VIDEO_DELAY);
+                waitDecoder(seq, VIDEO_DELAY);
+                seq = decodeProgress();
             }
         }
         // Create this Bitmap without a hires replacement, because we don't
         // support hires replacement for Movies yet.
         videoBitmap = new Bitmap(video->width, video->height, true);
-        audioQueueHead = NULL;
-        audioQueueTail = NULL;
+        allocPlanes(video->width, video->height);
         
         return true;
     }
     
-    void queueAudioPacket(const THEORAPLAY_AudioPacket *audio) {
-        AudioQueue *item = NULL;
+    static void planeSize(int plane, int width, int height, int &w, int &h)
+    {
+        // 4:2:0, the chroma planes are subsampled in both directions
+        w = plane ? width / 2 : width;
+        h = plane ? height / 2 : height;
+    }
+    
+    void allocPlanes(int width, int height)
+    {
+        for (int i = 0; i < 3; ++i) {
+            int w, h;
+            planeSize(i, width, height, w, h);
+            
+            planes[i] = TEX::gen();
+            TEX::bind(planes[i]);
+            TEX::setRepeat(false);
+            TEX::setSmooth(true);
+            gl.TexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, 0);
+        }
+        TEX::unbind();
         
-        if (!audio) {
-            return;
+        if (gl.pixel_buffer) {
+            for (int i = 0; i < MOVIE_PBO_COUNT; ++i)
+                pbos[i] = PBO::gen();
+        }
+    }
+    
+    // Starts the transfer of 'frame' into the plane textures. With
+    // pixel buffers, this returns before the GPU has the data
+    void stageFrame(const THEORAPLAY_VideoFrame *frame)
+    {
+        const int width = frame->width;
+        const int height = frame->height;
+        uintptr_t data = (uintptr_t) frame->pixels;
+        
+        if (gl.pixel_buffer) {
+            // Respecifying the whole store lets the driver hand us fresh
+            // memory instead of waiting for a transfer still in flight
+            PBO::bind(pbos[pboIndex]);
+            PBO::uploadData(width * height * 3 / 2, frame->pixels, GL_STREAM_DRAW);
+            pboIndex = (pboIndex + 1) % MOVIE_PBO_COUNT;
+            
+            // Texture uploads now read from offsets into the bound buffer
+            data = 0;
         }
         
-        item = (AudioQueue *) malloc(sizeof (AudioQueue));
-        if (!item) {
-            THEORAPLAY_freeAudio(audio);
-            return;  // oh well.
+        // Plane rows are tightly packed
+        gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int i = 0; i < 3; ++i) {
+            int w, h;
+            planeSize(i, width, height, w, h);
+            
+            TEX::bind(planes[i]);
+            gl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_LUMINANCE, GL_UNSIGNED_BYTE, (const GLvoid*) data);
+            data += w * h;
         }
+        gl.PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        
+        TEX::unbind();
+        if (gl.pixel_buffer)
+            PBO::unbind();
+        
+        videoStaged = true;
+    }
+    
+    // Converts the staged planes into 'videoBitmap'
+    void drawFrame(const THEORAPLAY_VideoFrame *frame)
+    {
+        const int width = frame->width;
+        const int height = frame->height;
+        
+        YUVShader &shader = shState->shaders().yuv;
+        shader.bind();
+        shader.setTexU(planes[1]);
+        shader.setTexV(planes[2]);
+        shader.setTexSize(Vec2i(width, height));
+        TEX::bind(planes[0]);
+        
+        const IntRect rect(0, 0, width, height);
+        Quad &quad = shState->gpQuad();
+        quad.setTexPosRect(rect, rect);
+        
+        FBO::bind(videoBitmap->getGLTypes().fbo);
+        glState.viewport.pushSet(rect);
+        shader.applyViewportProj();
+        glState.blend.pushSet(false);
         
-        item->audio = audio;
-        item->offset = 0;
-        item->next = NULL;
+        quad.draw();
+        
+        glState.blend.pop();
+        glState.viewport.pop();
+        TEX::unbind();
+        
+        videoBitmap->taintArea(rect);
+        videoBitmap->modified();
+    }
+    
+    // Returns false if the ring is full; the packet is left to the caller then
+    bool queueAudioPacket(const THEORAPLAY_AudioPacket *audio) {
+        if (!audio) {
+            return true;
+        }
         
         SDL_LockMutex(audioMutex);
-        if (audioQueueTail) {
-            audioQueueTail->next = item;
-        } else {
-            audioQueueHead = item;
+        bool full = (audioRingWrite - audioRingRead) == MOVIE_AUDIO_RING_SIZE;
+        if (!full) {
+            AudioRingEntry &entry = audioRing[audioRingWrite % MOVIE_AUDIO_RING_SIZE];
+            entry.audio = audio;
+            entry.offset = 0;
+            ++audioRingWrite;
         }
-        audioQueueTail = item;
         SDL_UnlockMutex(audioMutex);
+        
+        return !full;
     }
     
     void bufferMovieAudio(THEORAPLAY_Decoder *decoder, const Uint32 now) {
-        const THEORAPLAY_AudioPacket *audio;
-        while ((audio = THEORAPLAY_getAudio(decoder)) != NULL) {
-            queueAudioPacket(audio);
-            if (audio->playms >= now + AUDIO_BUFFER_LEN_MS) {  // don't let this get too far ahead.
+        // A packet that didn't fit into the ring last time goes first
+        while (audio || (audio = THEORAPLAY_getAudio(decoder)) != NULL) {
+            if (!queueAudioPacket(audio)) {
+                break;
+            }
+            const Uint32 playms = audio->playms;
+            audio = NULL;
+            if (playms >= now + AUDIO_BUFFER_LEN_MS) {  // don't let this get too far ahead.
                 break;
             }
         }
@@ -228,9 +390,8 @@ struct Movie
     void streamMovieAudio(){
         ALint state = 0;
         ALint procBufs = STREAM_BUFS;	    
-        volatile AudioQueue *audioPacketAndOffset;
-        int channels;
-        int sampleRate;
+        int channels = 2;
+        int sampleRate = 0;
         float *sourceSamples;
         ALuint samplesToProcess;
         ALshort *sampleBuffer;
@@ -245,12 +406,12 @@ struct Movie
                 sampleBuffer = audioBuffer;
                 SDL_LockMutex(audioMutex);
 
-                while(audioQueueHead && (remainingSamples > 0)) {
-                    audioPacketAndOffset = audioQueueHead;
-                    channels = audioPacketAndOffset->audio->channels;
-                    sampleRate = audioPacketAndOffset->audio->freq;
-                    sourceSamples = audioPacketAndOffset->audio->samples + (audioPacketAndOffset->offset * channels);
-                    samplesToProcess = (audioPacketAndOffset->audio->frames - audioPacketAndOffset->offset) * channels;
+                while((audioRingRead != audioRingWrite) && (remainingSamples > 0)) {
+                    AudioRingEntry &entry = audioRing[audioRingRead % MOVIE_AUDIO_RING_SIZE];
+                    channels = entry.audio->channels;
+                    sampleRate = entry.audio->freq;
+                    sourceSamples = entry.audio->samples + (entry.offset * channels);
+                    samplesToProcess = (entry.audio->frames - entry.offset) * channels;
 
                     if (samplesToProcess > remainingSamples) samplesToProcess = remainingSamples;
 
@@ -266,19 +427,17 @@ struct Movie
                     }
 
                     // Necessary to remember position between repeated iterations
-                    audioPacketAndOffset->offset += (samplesToProcess / channels);
+                    entry.offset += (samplesToProcess / channels);
                     remainingSamples -= samplesToProcess;
 
                     // The current audio packet has been completed
-                    if ((audioPacketAndOffset->offset) >= audioPacketAndOffset->audio->frames) {
-                        audioQueueHead = audioPacketAndOffset->next;
-                        THEORAPLAY_freeAudio(audioPacketAndOffset->audio);
-                        free((void *) audioPacketAndOffset);
+                    if (entry.offset >= entry.audio->frames) {
+                        THEORAPLAY_freeAudio(entry.audio);
+                        entry.audio = NULL;
+                        ++audioRingRead;
                     }
                 }
 
-                if(!audioQueueHead) audioQueueTail = NULL;
-
                 SDL_UnlockMutex(audioMutex);
 
                 alBufferData(alBuffers[procBufs], channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, audioBuffer,
@@ -306,8 +465,6 @@ struct Movie
 
         audioThreadTermReq.clear();
         audioMutex = SDL_CreateMutex();
-        queueAudioPacket(audio);
-        audio = NULL;
         bufferMovieAudio(decoder, 0);
         audioThread = createSDLThread <Movie, &Movie::streamMovieAudio>(this, "movieaudio");
 
@@ -330,6 +487,7 @@ struct Movie
             }
             
             const Uint32 now = SDL_GetTicks() - baseTicks;
+            const unsigned int seq = decodeProgress();
             
             if (!video) {
                 video = THEORAPLAY_getVideo(decoder);
@@ -360,6 +518,7 @@ struct Movie
                     {
                         THEORAPLAY_freeVideo(last);
                         last = video;
+                        videoStaged = false;
                         if ((now - video->playms) < frameMs)
                             break;
                     } 
@@ -375,14 +534,23 @@ struct Movie
                 }
 
                 // Got a video frame, now draw it
-                videoBitmap->replaceRaw(video->pixels, video->width * video->height * 4);
+                if (!videoStaged)
+                    stageFrame(video);
+                drawFrame(video);
                 shState->graphics().update(false);
                 THEORAPLAY_freeVideo(video);
                 video = NULL;
-
+                videoStaged = false;
+
+            } else if (video) {
+                // Get the upload going while the current frame is still up,
+                // then sleep until it's due (but keep polling input)
+                if (!videoStaged)
+                    stageFrame(video);
+                SDL_Delay(std::min<Uint32>(video->playms - now, VIDEO_DELAY));
             } else {
-                // Next video frame not yet ready, let the CPU breathe
-                SDL_Delay(VIDEO_DELAY);
+                // Next video frame not yet decoded
+                waitDecoder(seq, VIDEO_DELAY);
             }
             
             if (openedAudio) {
@@ -393,29 +561,33 @@ struct Movie
     
     ~Movie()
     {
-        if (hasAudio) {
-            if (audioQueueTail) {
-                THEORAPLAY_freeAudio(audioQueueTail->audio);
-            }
-            audioQueueTail = NULL;
-            
-            if (audioQueueHead) {
-                THEORAPLAY_freeAudio(audioQueueHead->audio);
-            }
-            audioQueueHead = NULL;
-            SDL_DestroyMutex(audioMutex);
+        if (audioThread) {
             audioThreadTermReq.set();
-            if(audioThread) {
-                SDL_WaitThread(audioThread, 0);
-                audioThread = 0;
-            }
+            SDL_WaitThread(audioThread, 0);
+            audioThread = 0;
+            
             alSourceStop(audioSource);
             alDeleteSources(1, &audioSource);
             alDeleteBuffers(STREAM_BUFS, alBuffers);
         }
+        for (; audioRingRead != audioRingWrite; ++audioRingRead) {
+            THEORAPLAY_freeAudio(audioRing[audioRingRead % MOVIE_AUDIO_RING_SIZE].audio);
+        }
+        if (audioMutex) SDL_DestroyMutex(audioMutex);
         if (video) THEORAPLAY_freeVideo(video);
         if (audio) THEORAPLAY_freeAudio(audio);
+        // Joins the decoder thread, so no more notifications after this
         if (decoder) THEORAPLAY_stopDecode(decoder);
+        SDL_DestroyCond(decodeCond);
+        SDL_DestroyMutex(decodeMutex);
+        if (videoBitmap) {
+            for (int i = 0; i < 3; ++i)
+                TEX::del(planes[i]);
+            if (gl.pixel_buffer) {
+                for (int i = 0; i < MOVIE_PBO_COUNT; ++i)
+                    PBO::del(pbos[i]);
+            }
+        }
         delete videoBitmap;
     }
 };
@@ -677,6 +849,9 @@ struct FPSLimiter {
     
     bool disabled;
     
+    /* Ticks the last delay() slept for */
+    int64_t lastDelay;
+    
     /* Data for frame timing adjustment */
     struct {
         /* Last tick count */
@@ -691,7 +866,7 @@ struct FPSLimiter {
     FPSLimiter(uint16_t desiredFPS)
     : lastTickCount(SDL_GetPerformanceCounter()),
     tickFreq(SDL_GetPerformanceFrequency()), tickFreqMS(tickFreq / 1000),
-    tickFreqNS((double)tickFreq / NS_PER_S), disabled(false) {
+    tickFreqNS((double)tickFreq / NS_PER_S), disabled(false), lastDelay(0) {
         setDesiredFPS(desiredFPS);
         
         adj.last = SDL_GetPerformanceCounter();
@@ -715,6 +890,7 @@ struct FPSLimiter {
         if (toDelay < 0)
             toDelay = 0;
         
+        lastDelay = toDelay;
         delayTicks(toDelay);
         
         uint64_t now = lastTickCount = SDL_GetPerformanceCounter();
@@ -733,6 +909,16 @@ struct FPSLimiter {
     
     void resetFrameAdjust() { adj.resetFlag = true; }
     
+    /* Ticks until the next frame is due */
+    int64_t ticksLeft() const {
+        if (disabled)
+            return 0;
+        
+        int64_t tickDelta = SDL_GetPerformanceCounter() - lastTickCount;
+        
+        return tpf - tickDelta - adj.idealDiff;
+    }
+    
     /* If we're more than a full frame's worth
      * of ticks behind the ideal timestep,
      * there's no choice but to skip frame(s)
@@ -809,6 +995,17 @@ struct GraphicsPrivate {
     // Can be set from Ruby. Takes priority over config setting.
     bool useFrameSkip;
     
+    /* Wait out the frame limit after the swap
+     * rather than before it */
+    bool lateInputLatch;
+    
+    /* Input latency of the last swapped frame, -1 if none */
+    double inputLatency;
+    
+    /* Ticks the last rendered frame took, without
+     * the frame limiter's wait */
+    int64_t renderTicks;
+    
     bool frozen;
     TEXFBO frozenScene;
     Quad screenQuad;
@@ -825,6 +1022,10 @@ struct GraphicsPrivate {
     SDL_mutex *avgFPSLock;
     
     SDL_mutex *glResourceLock;
+    /* Guards CPU side scene state (positions, z order, tweened
+     * values) against compositing. GL work like bitmap loads
+     * doesn't take it, so setters never queue behind those */
+    SDL_mutex *stateLock;
     bool multithreadedMode;
     
     /* Global list of all live Disposables
@@ -837,13 +1038,15 @@ struct GraphicsPrivate {
     screen(scRes.x, scRes.y), threadData(rtData),
     glCtx(SDL_GL_GetCurrentContext()), multithreadedMode(true),
     frameRate(DEF_FRAMERATE), frameCount(0), brightness(255),
-    fpsLimiter(frameRate), useFrameSkip(rtData->config.frameSkip), frozen(false),
+    fpsLimiter(frameRate), useFrameSkip(rtData->config.frameSkip),
+    lateInputLatch(rtData->config.lateInputLatch), inputLatency(-1), renderTicks(0), frozen(false),
     last_update(0), last_avg_update(0), backingScaleFactor(1), integerScaleFactor(0, 0),
     integerScaleActive(rtData->config.integerScaling.active),
     integerLastMileScaling(rtData->config.integerScaling.lastMileScaling) {
         avgFPSData = std::vector<double>();
         avgFPSLock = SDL_CreateMutex();
         glResourceLock = SDL_CreateMutex();
+        stateLock = SDL_CreateMutex();
         
         if (integerScaleActive) {
             integerScaleFactor = Vec2i(0, 0);
@@ -868,6 +1071,7 @@ struct GraphicsPrivate {
         TEXFBO::fini(integerScaleBuffer);
         SDL_DestroyMutex(avgFPSLock);
         SDL_DestroyMutex(glResourceLock);
+        SDL_DestroyMutex(stateLock);
     }
     
     void updateScreenResoRatio(RGSSThreadData *rtData) {
@@ -994,12 +1198,31 @@ struct GraphicsPrivate {
     }
     
     void swapGLBuffer() {
-        fpsLimiter.delay();
+        if (!lateInputLatch)
+            fpsLimiter.delay();
+        
         SDL_GL_SwapWindow(threadData->window);
+        measureInputLatency();
         
         ++frameCount;
         
         threadData->ethread->notifyFrame();
+        
+        /* The script reads input right after we return,
+         * so anything arriving during the wait still
+         * makes it into the next frame */
+        if (lateInputLatch)
+            fpsLimiter.delay();
+    }
+    
+    void measureInputLatency() {
+        uint64_t eventTime = shState->input().takeEventTime();
+        
+        if (eventTime == 0)
+            return;
+        
+        uint64_t now = SDL_GetPerformanceCounter();
+        inputLatency = (double)(now - eventTime) * 1000 / fpsLimiter.tickFreq;
     }
     
     void compositeToBuffer(TEXFBO &buffer) {
@@ -1007,7 +1230,7 @@ struct GraphicsPrivate {
     }
 
     void compositeToBufferScaled(TEXFBO &buffer, int destWidth, int destHeight) {
-        screen.composite();
+        compositeScreen();
         
         GLMeta::blitBegin(buffer);
         GLMeta::blitSource(screen.getPP().frontBuffer());
@@ -1033,7 +1256,7 @@ struct GraphicsPrivate {
     }
     
     void redrawScreen() {
-        screen.composite();
+        compositeScreen();
         
         // maybe unspaghetti this later
         if (integerScaleStepApplicable() && !integerLastMileScaling)
@@ -1132,6 +1355,24 @@ struct GraphicsPrivate {
         
         SDL_UnlockMutex(glResourceLock);
     }
+    
+    void lockState() {
+        if (multithreadedMode)
+            SDL_LockMutex(stateLock);
+    }
+    
+    void releaseState() {
+        if (multithreadedMode)
+            SDL_UnlockMutex(stateLock);
+    }
+    
+    /* The only place scene state is read off the Ruby
+     * threads, so the only one that has to exclude setters */
+    void compositeScreen() {
+        lockState();
+        screen.composite();
+        releaseState();
+    }
 };
 
 Graphics::Graphics(RGSSThreadData *data) {
@@ -1174,6 +1415,11 @@ void Graphics::update(bool checkForShutdown) {
     
     p->checkSyncLock();
     
+    /* Tweens advance once per call, even when the
+     * frame is frozen or skipped */
+    p->lockState();
+    shState->tweens().step();
+    p->releaseState();
     
 #ifdef MKXPZ_STEAM
     if (STEAMSHIM_alive())
@@ -1197,8 +1443,13 @@ void Graphics::update(bool checkForShutdown) {
         }
     }
     
+    uint64_t renderStart = SDL_GetPerformanceCounter();
+    p->fpsLimiter.lastDelay = 0;
+    
     p->checkResize();
     p->redrawScreen();
+    
+    p->renderTicks = SDL_GetPerformanceCounter() - renderStart - p->fpsLimiter.lastDelay;
 }
 
 void Graphics::freeze() {
@@ -1223,7 +1474,7 @@ void Graphics::transition(int duration, const char *filename, int vague) {
     setBrightness(255);
     
     /* Capture new scene */
-    p->screen.composite();
+    p->compositeScreen();
     
     /* The PP frontbuffer will hold the current scene after the
      * composition step. Since the backbuffer is unused during
@@ -1322,6 +1573,25 @@ void Graphics::transition(int duration, const char *filename, int vague) {
 
 void Graphics::frameReset() {p->fpsLimiter.resetFrameAdjust();}
 
+double Graphics::frameSlack() {
+    int64_t slack = p->fpsLimiter.ticksLeft() - p->renderTicks;
+    
+    if (slack <= 0)
+        return 0;
+    
+    return (double)slack * 1000 / p->fpsLimiter.tickFreq;
+}
+
+bool Graphics::takeInputLatency(double &ms) {
+    if (p->inputLatency < 0)
+        return false;
+    
+    ms = p->inputLatency;
+    p->inputLatency = -1;
+    
+    return true;
+}
+
 static void guardDisposed() {}
 
 DEF_ATTR_RD_SIMPLE(Graphics, FrameRate, int, p->frameRate)
@@ -1512,6 +1782,10 @@ void Graphics::playMovie(const char *filename, int volume_, bool skippable) {
     float volume = volume_ * 0.01f;
     
     if (movie->preparePlayback()) {        
+        // The movie paces its own frames
+        const bool limiterDisabled = p->fpsLimiter.disabled;
+        p->fpsLimiter.disabled = true;
+        
         Sprite movieSprite;
         
         // Currently this stretches to fit the screen. VX Ace behavior is to center it and let the edges run off
@@ -1531,6 +1805,9 @@ void Graphics::playMovie(const char *filename, int volume_, bool skippable) {
         movieSprite.setZ(5001);
         
         movie->play(volume);
+        
+        p->fpsLimiter.disabled = limiterDisabled;
+        p->fpsLimiter.resetFrameAdjust();
     }
     
     delete movie;
@@ -1723,6 +2000,14 @@ void Graphics::unlock(bool force) {
     p->releaseLock(force);
 }
 
+void Graphics::lockState() {
+    p->lockState();
+}
+
+void Graphics::unlockState() {
+    p->releaseState();
+}
+
 void Graphics::addDisposable(Disposable *d) { p->dispList.append(d->link); }
 
 void Graphics::remDisposable(Disposable *d) { p->dispList.remove(d->link); }
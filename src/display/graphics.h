@@ -86,6 +86,16 @@ public:
     DECL_ATTR( LastMileScaling, bool )
     DECL_ATTR( Threadsafe, bool )
     double averageFrameRate();
+    
+    /* Time from the oldest input event of the last frame
+     * to its buffer swap, in milliseconds. Returns false if
+     * no input was picked up since the previous call */
+    bool takeInputLatency(double &ms);
+    
+    /* Time the frame limiter would still sleep for if the
+     * next frame took as long to render as the last one,
+     * in milliseconds. Zero when frames aren't limited */
+    double frameSlack();
 
 	/* <internal> */
 	Scene *getScreen() const;
@@ -97,6 +107,12 @@ public:
     
     void lock(bool force = false);
     void unlock(bool force = false);
+    
+    /* For changes to CPU side state only. Excludes compositing,
+     * but not GL work like bitmap loads, and never touches
+     * the GL context */
+    void lockState();
+    void unlockState();
 
 private:
 	Graphics(RGSSThreadData *data);
@@ -114,4 +130,7 @@ private:
 #define GFX_LOCK shState->graphics().lock()
 #define GFX_UNLOCK shState->graphics().unlock()
 
+#define GFX_STATE_LOCK shState->graphics().lockState()
+#define GFX_STATE_UNLOCK shState->graphics().unlockState()
+
 #endif // GRAPHICS_H
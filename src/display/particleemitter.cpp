@@ -0,0 +1,468 @@
+/*
+** particleemitter.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particleemitter.h"
+
+#include "sharedstate.h"
+#include "bitmap.h"
+#include "etc.h"
+#include "etc-internal.h"
+#include "util.h"
+
+#include "gl-util.h"
+#include "quad.h"
+#include "quadarray.h"
+#include "shader.h"
+#include "glstate.h"
+
+#include <SDL_timer.h>
+
+#include <vector>
+
+/* Particle state is kept as one array per attribute, so
+ * the per-frame integration runs over contiguous floats
+ * and can be vectorized by the compiler */
+struct ParticleArrays
+{
+	std::vector<float> posX, posY;
+	std::vector<float> velX, velY;
+	std::vector<float> age;
+	std::vector<float> invLife;
+
+	size_t size() const { return posX.size(); }
+
+	void reserve(size_t n)
+	{
+		posX.reserve(n); posY.reserve(n);
+		velX.reserve(n); velY.reserve(n);
+		age.reserve(n);
+		invLife.reserve(n);
+	}
+
+	void push(float px, float py, float vx, float vy, float life)
+	{
+		posX.push_back(px); posY.push_back(py);
+		velX.push_back(vx); velY.push_back(vy);
+		age.push_back(0);
+		invLife.push_back(1.0f / life);
+	}
+
+	void resize(size_t n)
+	{
+		posX.resize(n); posY.resize(n);
+		velX.resize(n); velY.resize(n);
+		age.resize(n);
+		invLife.resize(n);
+	}
+
+	void moveTo(size_t dst, size_t src)
+	{
+		posX[dst] = posX[src]; posY[dst] = posY[src];
+		velX[dst] = velX[src]; velY[dst] = velY[src];
+		age[dst] = age[src];
+		invLife[dst] = invLife[src];
+	}
+};
+
+struct ParticleEmitterPrivate
+{
+	Bitmap *bitmap;
+	Rect *srcRect;
+
+	int x, y;
+	int emitWidth, emitHeight;
+
+	float rate;
+	/* Fractional particles carried over between frames */
+	float rateAcc;
+	int maxParticles;
+
+	int lifeMin, lifeMax;
+	Vec2 velocity;
+	Vec2 spread;
+	Vec2 gravity;
+
+	float zoomStart, zoomEnd;
+	Color *colorStart;
+	Color *colorEnd;
+
+	BlendType blendType;
+
+	ParticleArrays parts;
+
+	/* xorshift32 */
+	uint32_t rng;
+
+	Scene::Geometry sceneGeo;
+
+	ColorQuadArray qArray;
+	bool quadsDirty;
+
+	/* Defaults; the binding moves these to the heap on access */
+	Rect defSrcRect;
+	Color defColorStart;
+	Color defColorEnd;
+
+	sigslot::connection prepareCon;
+
+	ParticleEmitterPrivate()
+	    : bitmap(0),
+	      srcRect(&defSrcRect),
+	      x(0), y(0),
+	      emitWidth(0), emitHeight(0),
+	      rate(0), rateAcc(0),
+	      maxParticles(1000),
+	      lifeMin(60), lifeMax(60),
+	      zoomStart(1), zoomEnd(1),
+	      colorStart(&defColorStart),
+	      colorEnd(&defColorEnd),
+	      blendType(BlendNormal),
+	      quadsDirty(false),
+	      defColorStart(255, 255, 255, 255),
+	      defColorEnd(255, 255, 255, 0)
+	{
+		rng = static_cast<uint32_t>(SDL_GetPerformanceCounter()) | 1;
+
+		parts.reserve(maxParticles);
+
+		prepareCon = shState->prepareDraw.connect
+		        (&ParticleEmitterPrivate::prepare, this);
+	}
+
+	~ParticleEmitterPrivate()
+	{
+		prepareCon.disconnect();
+	}
+
+	/* Uniform in [0, 1) */
+	float random()
+	{
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+
+		return (rng >> 8) * (1.0f / 16777216.0f);
+	}
+
+	void emit(int count)
+	{
+		count = std::min(count, maxParticles - (int) parts.size());
+
+		for (int i = 0; i < count; ++i)
+		{
+			float px = x + random() * emitWidth;
+			float py = y + random() * emitHeight;
+			float vx = velocity.x + (random() * 2 - 1) * spread.x;
+			float vy = velocity.y + (random() * 2 - 1) * spread.y;
+			float life = lifeMin + (int) (random() * (lifeMax - lifeMin + 1));
+
+			parts.push(px, py, vx, vy, std::max(life, 1.0f));
+		}
+
+		if (count > 0)
+			quadsDirty = true;
+	}
+
+	void step()
+	{
+		const size_t n = parts.size();
+
+		float *px = dataPtr(parts.posX);
+		float *py = dataPtr(parts.posY);
+		float *vx = dataPtr(parts.velX);
+		float *vy = dataPtr(parts.velY);
+		float *age = dataPtr(parts.age);
+
+		const float gx = gravity.x;
+		const float gy = gravity.y;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			vx[i] += gx;
+			vy[i] += gy;
+			px[i] += vx[i];
+			py[i] += vy[i];
+			age[i] += 1;
+		}
+
+		/* Drop expired particles, keeping the survivors packed */
+		size_t live = 0;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (parts.age[i] * parts.invLife[i] >= 1.0f)
+				continue;
+
+			if (live != i)
+				parts.moveTo(live, i);
+
+			++live;
+		}
+
+		parts.resize(live);
+
+		quadsDirty = true;
+	}
+
+	void rebuildQuads()
+	{
+		const size_t n = parts.size();
+
+		qArray.resize(n);
+
+		if (n == 0)
+			return;
+
+		FloatRect tex = srcRect->toFloatRect();
+
+		if (tex.w <= 0 || tex.h <= 0)
+			tex = bitmap->rect();
+
+		const Vec4 &c0 = colorStart->norm;
+		const Vec4 &c1 = colorEnd->norm;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			float t = parts.age[i] * parts.invLife[i];
+
+			float zoom = zoomStart + (zoomEnd - zoomStart) * t;
+			float w = tex.w * zoom;
+			float h = tex.h * zoom;
+
+			FloatRect pos(parts.posX[i] - w / 2, parts.posY[i] - h / 2, w, h);
+
+			Vec4 color(c0.x + (c1.x - c0.x) * t,
+			           c0.y + (c1.y - c0.y) * t,
+			           c0.z + (c1.z - c0.z) * t,
+			           c0.w + (c1.w - c0.w) * t);
+
+			Vertex *vert = &qArray.vertices[i*4];
+
+			Quad::setTexPosRect(vert, tex, pos);
+			Quad::setColor(vert, color);
+		}
+
+		qArray.commit();
+	}
+
+	void prepare()
+	{
+		if (!quadsDirty || nullOrDisposed(bitmap))
+			return;
+
+		rebuildQuads();
+		quadsDirty = false;
+	}
+};
+
+ParticleEmitter::ParticleEmitter(Viewport *viewport)
+    : ViewportElement(viewport)
+{
+	p = new ParticleEmitterPrivate();
+
+	onGeometryChange(scene->getGeometry());
+}
+
+ParticleEmitter::~ParticleEmitter()
+{
+	dispose();
+}
+
+DEF_ATTR_RD_SIMPLE(ParticleEmitter, Bitmap,       Bitmap*, p->bitmap)
+DEF_ATTR_RD_SIMPLE(ParticleEmitter, MaxParticles, int,     p->maxParticles)
+DEF_ATTR_RD_SIMPLE(ParticleEmitter, LifeMin,      int,     p->lifeMin)
+DEF_ATTR_RD_SIMPLE(ParticleEmitter, LifeMax,      int,     p->lifeMax)
+DEF_ATTR_RD_SIMPLE(ParticleEmitter, BlendType,    int,     p->blendType)
+
+DEF_ATTR_SIMPLE(ParticleEmitter, SrcRect,    Rect&,  *p->srcRect)
+DEF_ATTR_SIMPLE(ParticleEmitter, X,          int,     p->x)
+DEF_ATTR_SIMPLE(ParticleEmitter, Y,          int,     p->y)
+DEF_ATTR_SIMPLE(ParticleEmitter, EmitWidth,  int,     p->emitWidth)
+DEF_ATTR_SIMPLE(ParticleEmitter, EmitHeight, int,     p->emitHeight)
+DEF_ATTR_SIMPLE(ParticleEmitter, Rate,       float,   p->rate)
+DEF_ATTR_SIMPLE(ParticleEmitter, VelocityX,  float,   p->velocity.x)
+DEF_ATTR_SIMPLE(ParticleEmitter, VelocityY,  float,   p->velocity.y)
+DEF_ATTR_SIMPLE(ParticleEmitter, SpreadX,    float,   p->spread.x)
+DEF_ATTR_SIMPLE(ParticleEmitter, SpreadY,    float,   p->spread.y)
+DEF_ATTR_SIMPLE(ParticleEmitter, GravityX,   float,   p->gravity.x)
+DEF_ATTR_SIMPLE(ParticleEmitter, GravityY,   float,   p->gravity.y)
+DEF_ATTR_SIMPLE(ParticleEmitter, ZoomStart,  float,   p->zoomStart)
+DEF_ATTR_SIMPLE(ParticleEmitter, ZoomEnd,    float,   p->zoomEnd)
+DEF_ATTR_SIMPLE(ParticleEmitter, ColorStart, Color&, *p->colorStart)
+DEF_ATTR_SIMPLE(ParticleEmitter, ColorEnd,   Color&, *p->colorEnd)
+
+int ParticleEmitter::getCount() const
+{
+	guardDisposed();
+
+	return p->parts.size();
+}
+
+void ParticleEmitter::setBitmap(Bitmap *value)
+{
+	guardDisposed();
+
+	p->bitmap = value;
+	p->quadsDirty = true;
+
+	if (!value)
+		return;
+
+	value->ensureNonMega();
+}
+
+void ParticleEmitter::setMaxParticles(int value)
+{
+	guardDisposed();
+
+	p->maxParticles = std::max(value, 0);
+	p->parts.reserve(p->maxParticles);
+
+	if (p->parts.size() > (size_t) p->maxParticles)
+	{
+		p->parts.resize(p->maxParticles);
+		p->quadsDirty = true;
+	}
+}
+
+void ParticleEmitter::setLifeMin(int value)
+{
+	guardDisposed();
+
+	p->lifeMin = std::max(value, 1);
+	p->lifeMax = std::max(p->lifeMax, p->lifeMin);
+}
+
+void ParticleEmitter::setLifeMax(int value)
+{
+	guardDisposed();
+
+	p->lifeMax = std::max(value, 1);
+	p->lifeMin = std::min(p->lifeMin, p->lifeMax);
+}
+
+void ParticleEmitter::setBlendType(int value)
+{
+	guardDisposed();
+
+	switch (value)
+	{
+	default :
+	case BlendNormal :
+		p->blendType = BlendNormal;
+		return;
+	case BlendAddition :
+		p->blendType = BlendAddition;
+		return;
+	case BlendSubstraction :
+		p->blendType = BlendSubstraction;
+		return;
+	}
+}
+
+void ParticleEmitter::emit(int count)
+{
+	guardDisposed();
+
+	p->emit(count);
+}
+
+void ParticleEmitter::update()
+{
+	guardDisposed();
+
+	p->step();
+
+	p->rateAcc += p->rate;
+	int count = static_cast<int>(p->rateAcc);
+	p->rateAcc -= count;
+
+	p->emit(count);
+}
+
+void ParticleEmitter::clear()
+{
+	guardDisposed();
+
+	p->parts.resize(0);
+	p->rateAcc = 0;
+	p->quadsDirty = true;
+}
+
+Rect &ParticleEmitter::initSrcRect()
+{
+	guardDisposed();
+
+	p->srcRect = new Rect(*p->srcRect);
+
+	return *p->srcRect;
+}
+
+Color &ParticleEmitter::initColorStart()
+{
+	guardDisposed();
+
+	p->colorStart = new Color(*p->colorStart);
+
+	return *p->colorStart;
+}
+
+Color &ParticleEmitter::initColorEnd()
+{
+	guardDisposed();
+
+	p->colorEnd = new Color(*p->colorEnd);
+
+	return *p->colorEnd;
+}
+
+void ParticleEmitter::draw()
+{
+	if (nullOrDisposed(p->bitmap))
+		return;
+
+	if (p->qArray.count() == 0)
+		return;
+
+	ParticleShader &shader = shState->shaders().particle;
+
+	shader.bind();
+	shader.applyViewportProj();
+	shader.setTranslation(p->sceneGeo.offset());
+
+	glState.blendMode.pushSet(p->blendType);
+
+	p->bitmap->bindTex(shader);
+
+	p->qArray.draw();
+
+	glState.blendMode.pop();
+}
+
+void ParticleEmitter::onGeometryChange(const Scene::Geometry &geo)
+{
+	p->sceneGeo = geo;
+}
+
+void ParticleEmitter::releaseResources()
+{
+	unlink();
+
+	delete p;
+}
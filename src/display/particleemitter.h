@@ -0,0 +1,97 @@
+/*
+** particleemitter.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARTICLEEMITTER_H
+#define PARTICLEEMITTER_H
+
+#include "disposable.h"
+#include "viewport.h"
+#include "util.h"
+
+class Bitmap;
+struct Color;
+struct Rect;
+
+struct ParticleEmitterPrivate;
+
+/* Spawns, simulates and draws a pool of particles that all
+ * share one bitmap region. Particles are spawned at random
+ * inside the emission area (x, y, emit_width, emit_height),
+ * move with their velocity under constant gravity and blend
+ * from the start to the end color and zoom over their life.
+ * All live particles are drawn in a single call */
+class ParticleEmitter : public ViewportElement, public Disposable
+{
+public:
+	ParticleEmitter(Viewport *viewport = 0);
+	~ParticleEmitter();
+
+	DECL_ATTR( Bitmap,       Bitmap* )
+	DECL_ATTR( SrcRect,      Rect&   )
+	DECL_ATTR( X,            int     )
+	DECL_ATTR( Y,            int     )
+	DECL_ATTR( EmitWidth,    int     )
+	DECL_ATTR( EmitHeight,   int     )
+	DECL_ATTR( Rate,         float   )
+	DECL_ATTR( MaxParticles, int     )
+	DECL_ATTR( LifeMin,      int     )
+	DECL_ATTR( LifeMax,      int     )
+	DECL_ATTR( VelocityX,    float   )
+	DECL_ATTR( VelocityY,    float   )
+	DECL_ATTR( SpreadX,      float   )
+	DECL_ATTR( SpreadY,      float   )
+	DECL_ATTR( GravityX,     float   )
+	DECL_ATTR( GravityY,     float   )
+	DECL_ATTR( ZoomStart,    float   )
+	DECL_ATTR( ZoomEnd,      float   )
+	DECL_ATTR( ColorStart,   Color&  )
+	DECL_ATTR( ColorEnd,     Color&  )
+	DECL_ATTR( BlendType,    int     )
+
+	/* Live particles */
+	int getCount() const;
+
+	/* Spawns 'count' particles right away */
+	void emit(int count);
+
+	/* Advances the simulation by one frame,
+	 * spawning 'rate' new particles */
+	void update();
+
+	/* Removes all live particles */
+	void clear();
+
+	/* See Sprite::initSrcRect() */
+	Rect  &initSrcRect();
+	Color &initColorStart();
+	Color &initColorEnd();
+
+private:
+	ParticleEmitterPrivate *p;
+
+	void draw();
+	void onGeometryChange(const Scene::Geometry &);
+
+	void releaseResources();
+	const char *klassName() const { return "particle emitter"; }
+
+	ABOUT_TO_ACCESS_DISP
+};
+
+#endif // PARTICLEEMITTER_H
@@ -35,7 +35,9 @@
 #include "glstate.h"
 #include "quadarray.h"
 
+#include <algorithm>
 #include <math.h>
+#include <string.h>
 #ifndef M_PI
 # define M_PI 3.14159265358979323846
 #endif
@@ -94,6 +96,22 @@ struct SpritePrivate
         SimpleQuadArray qArray;
     } wave;
     
+    struct
+    {
+        int frameW;
+        int frameH;
+        int frames;
+        int duration;
+        int row;
+        bool loop;
+        
+        int frame;
+        int counter;
+        
+        /* Frames are being stepped in update() */
+        bool active;
+    } anim;
+    
     EtcTemps tmp;
     
     sigslot::connection prepareCon;
@@ -131,6 +149,13 @@ struct SpritePrivate
         wave.speed = 360;
         wave.phase = 0.0f;
         wave.dirty = false;
+        
+        anim.frameW = anim.frameH = 0;
+        anim.frames = anim.duration = 1;
+        anim.row = 0;
+        anim.loop = false;
+        anim.frame = anim.counter = 0;
+        anim.active = false;
     }
     
     ~SpritePrivate()
@@ -173,6 +198,40 @@ struct SpritePrivate
         wave.dirty = true;
     }
     
+    void updateAnimRect()
+    {
+        srcRect->set(anim.frame * anim.frameW, anim.row * anim.frameH,
+                     anim.frameW, anim.frameH);
+    }
+    
+    void stepAnimation()
+    {
+        if (!anim.active || ++anim.counter < anim.duration)
+            return;
+        
+        anim.counter = 0;
+        
+        int next = anim.frame + 1;
+        
+        if (next >= anim.frames)
+        {
+            if (!anim.loop)
+            {
+                /* Hold the last frame */
+                anim.active = false;
+                return;
+            }
+            
+            next = 0;
+        }
+        
+        if (next == anim.frame)
+            return;
+        
+        anim.frame = next;
+        updateAnimRect();
+    }
+    
     void updateSrcRectCon()
     {
         /* Cut old connection */
@@ -378,6 +437,12 @@ void Sprite::setBitmap(Bitmap *bitmap)
     bitmap->ensureNonMega();
     
     *p->srcRect = bitmap->rect();
+    
+    /* Keep showing the animation frame
+     * on the new bitmap */
+    if (p->anim.frameW > 0)
+        p->updateAnimRect();
+    
     p->onSrcRectChange();
     p->quad.setPosRect(p->srcRect->toFloatRect());
     
@@ -554,13 +619,149 @@ DEF_WAVE_SETTER(Phase,  phase,  float)
 
 #undef DEF_WAVE_SETTER
 
-void Sprite::initDynAttribs()
+Rect &Sprite::initSrcRect()
 {
-    p->srcRect = new Rect;
-    p->color = new Color;
-    p->tone = new Tone;
+    guardDisposed();
     
+    p->srcRect = new Rect(*p->srcRect);
     p->updateSrcRectCon();
+    
+    return *p->srcRect;
+}
+
+void Sprite::detachSrcRect()
+{
+    guardDisposed();
+    
+    /* The wrapped rect stays owned by its Ruby object */
+    p->tmp.rect = *p->srcRect;
+    p->srcRect = &p->tmp.rect;
+    p->updateSrcRectCon();
+}
+
+Color &Sprite::initColor()
+{
+    guardDisposed();
+    
+    p->color = new Color(*p->color);
+    
+    return *p->color;
+}
+
+Tone &Sprite::initTone()
+{
+    guardDisposed();
+    
+    p->tone = new Tone(*p->tone);
+    
+    return *p->tone;
+}
+
+static const char *fieldNames[] =
+{
+    "x", "y", "z", "ox", "oy", "zoom_x", "zoom_y", "angle",
+    "opacity", "bush_depth", "wave_phase", "visible", "mirror"
+};
+
+static elementsN(fieldNames);
+
+Sprite::Field Sprite::fieldFromName(const char *name)
+{
+    for (size_t i = 0; i < fieldNamesN; ++i)
+        if (!strcmp(name, fieldNames[i]))
+            return static_cast<Field>(i);
+    
+    return FieldCount;
+}
+
+void Sprite::setFields(const Field *fields, const float *values, int count)
+{
+    guardDisposed();
+    
+    for (int i = 0; i < count; ++i)
+    {
+        const float v = values[i];
+        
+        switch (fields[i])
+        {
+        case FieldX :          setX(static_cast<int>(v));          break;
+        case FieldY :          setY(static_cast<int>(v));          break;
+        case FieldZ :          setZ(static_cast<int>(v));          break;
+        case FieldOX :         setOX(static_cast<int>(v));         break;
+        case FieldOY :         setOY(static_cast<int>(v));         break;
+        case FieldZoomX :      setZoomX(v);                        break;
+        case FieldZoomY :      setZoomY(v);                        break;
+        case FieldAngle :      setAngle(v);                        break;
+        case FieldOpacity :    setOpacity(static_cast<int>(v));    break;
+        case FieldBushDepth :  setBushDepth(static_cast<int>(v));  break;
+        case FieldWavePhase :  setWavePhase(v);                    break;
+        case FieldVisible :    setVisible(v != 0);                 break;
+        case FieldMirror :     setMirror(v != 0);                  break;
+        default :                                                  break;
+        }
+    }
+}
+
+void Sprite::animate(int frameW, int frameH, int frames, int frameDuration, bool loop)
+{
+    guardDisposed();
+    
+    p->anim.frameW = std::max(frameW, 0);
+    p->anim.frameH = std::max(frameH, 0);
+    p->anim.frames = std::max(frames, 1);
+    p->anim.duration = std::max(frameDuration, 1);
+    p->anim.loop = loop;
+    p->anim.frame = 0;
+    p->anim.counter = 0;
+    p->anim.active = true;
+    
+    p->updateAnimRect();
+}
+
+void Sprite::stopAnimation()
+{
+    guardDisposed();
+    
+    /* Forget the frame size too, so src_rect is
+     * left alone by later bitmap or row changes */
+    p->anim.frameW = p->anim.frameH = 0;
+    p->anim.active = false;
+}
+
+bool Sprite::isAnimating() const
+{
+    guardDisposed();
+    
+    return p->anim.active;
+}
+
+int Sprite::getAnimationFrame() const
+{
+    guardDisposed();
+    
+    return p->anim.frame;
+}
+
+int Sprite::getAnimationRow() const
+{
+    guardDisposed();
+    
+    return p->anim.row;
+}
+
+void Sprite::setAnimationRow(int value)
+{
+    guardDisposed();
+    
+    value = std::max(value, 0);
+    
+    if (p->anim.row == value)
+        return;
+    
+    p->anim.row = value;
+    
+    if (p->anim.frameW > 0)
+        p->updateAnimRect();
 }
 
 /* Flashable */
@@ -570,6 +771,8 @@ void Sprite::update()
     
     Flashable::update();
     
+    p->stepAnimation();
+    
     p->wave.phase += p->wave.speed / 180;
     p->wave.dirty = true;
 }
@@ -75,8 +75,57 @@ public:
 	DECL_ATTR( WaveLength,  int     )
 	DECL_ATTR( WaveSpeed,   int     )
 	DECL_ATTR( WavePhase,   float   )
+	DECL_ATTR( AnimationRow, int    )
 
-	void initDynAttribs();
+	/* Property objects start out as neutral defaults owned by
+	 * the sprite. These move one onto the heap, keeping its
+	 * value, for the binding to wrap on first access */
+	Rect  &initSrcRect();
+	Color &initColor();
+	Tone  &initTone();
+
+	/* Moves src_rect back into the sprite, leaving the wrapped
+	 * one untouched from then on. For when the binding must
+	 * not write it anymore (eg. because it has been frozen) */
+	void detachSrcRect();
+
+	/* Steps src_rect through a spritesheet row on every update(),
+	 * showing each of 'frames' frames of 'frameW' x 'frameH' pixels
+	 * for 'frameDuration' updates. The row (eg. the facing direction
+	 * of a character) is picked by 'AnimationRow'. Without 'loop',
+	 * the animation stops on its last frame */
+	void animate(int frameW, int frameH, int frames, int frameDuration, bool loop);
+	void stopAnimation();
+	bool isAnimating() const;
+	int getAnimationFrame() const;
+
+	/* Properties that can be set in bulk through 'setFields()' */
+	enum Field
+	{
+		FieldX,
+		FieldY,
+		FieldZ,
+		FieldOX,
+		FieldOY,
+		FieldZoomX,
+		FieldZoomY,
+		FieldAngle,
+		FieldOpacity,
+		FieldBushDepth,
+		FieldWavePhase,
+		FieldVisible,
+		FieldMirror,
+
+		FieldCount
+	};
+
+	/* Returns FieldCount for unknown names */
+	static Field fieldFromName(const char *name);
+
+	/* Sets 'count' properties at once, 'fields[i]' to 'values[i]'.
+	 * Integer properties are truncated, boolean ones are true
+	 * for any non-zero value */
+	void setFields(const Field *fields, const float *values, int count);
 
 private:
 	SpritePrivate *p;
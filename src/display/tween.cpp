@@ -0,0 +1,328 @@
+/*
+** tween.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tween.h"
+
+#include "disposable.h"
+#include "exception.h"
+#include "etc.h"
+#include "sprite.h"
+#include "window.h"
+#include "windowvx.h"
+#include "viewport.h"
+#include "plane.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Integer properties are rounded so that tweening
+ * towards smaller values doesn't lag a step behind */
+#define TWEEN_FIELD_I(Klass, name, Prop) \
+	{ name, \
+	  [](void *o) -> float { return static_cast<Klass*>(o)->get##Prop(); }, \
+	  [](void *o, float v) { static_cast<Klass*>(o)->set##Prop(lrintf(v)); } }
+
+#define TWEEN_FIELD_F(Klass, name, Prop) \
+	{ name, \
+	  [](void *o) -> float { return static_cast<Klass*>(o)->get##Prop(); }, \
+	  [](void *o, float v) { static_cast<Klass*>(o)->set##Prop(v); } }
+
+#define TWEEN_FIELD_END { 0, 0, 0 }
+
+static const TweenField spriteFields[] =
+{
+	TWEEN_FIELD_I(Sprite, "x",            X),
+	TWEEN_FIELD_I(Sprite, "y",            Y),
+	TWEEN_FIELD_I(Sprite, "ox",           OX),
+	TWEEN_FIELD_I(Sprite, "oy",           OY),
+	TWEEN_FIELD_F(Sprite, "zoom_x",       ZoomX),
+	TWEEN_FIELD_F(Sprite, "zoom_y",       ZoomY),
+	TWEEN_FIELD_F(Sprite, "angle",        Angle),
+	TWEEN_FIELD_I(Sprite, "opacity",      Opacity),
+	TWEEN_FIELD_I(Sprite, "bush_depth",   BushDepth),
+	TWEEN_FIELD_I(Sprite, "bush_opacity", BushOpacity),
+	TWEEN_FIELD_I(Sprite, "wave_amp",     WaveAmp),
+	TWEEN_FIELD_F(Sprite, "wave_phase",   WavePhase),
+	TWEEN_FIELD_END
+};
+
+static const TweenField windowFields[] =
+{
+	TWEEN_FIELD_I(Window, "x",                X),
+	TWEEN_FIELD_I(Window, "y",                Y),
+	TWEEN_FIELD_I(Window, "width",            Width),
+	TWEEN_FIELD_I(Window, "height",           Height),
+	TWEEN_FIELD_I(Window, "ox",               OX),
+	TWEEN_FIELD_I(Window, "oy",               OY),
+	TWEEN_FIELD_I(Window, "opacity",          Opacity),
+	TWEEN_FIELD_I(Window, "back_opacity",     BackOpacity),
+	TWEEN_FIELD_I(Window, "contents_opacity", ContentsOpacity),
+	TWEEN_FIELD_END
+};
+
+static const TweenField windowVXFields[] =
+{
+	TWEEN_FIELD_I(WindowVX, "x",                X),
+	TWEEN_FIELD_I(WindowVX, "y",                Y),
+	TWEEN_FIELD_I(WindowVX, "width",            Width),
+	TWEEN_FIELD_I(WindowVX, "height",           Height),
+	TWEEN_FIELD_I(WindowVX, "ox",               OX),
+	TWEEN_FIELD_I(WindowVX, "oy",               OY),
+	TWEEN_FIELD_I(WindowVX, "padding",          Padding),
+	TWEEN_FIELD_I(WindowVX, "padding_bottom",   PaddingBottom),
+	TWEEN_FIELD_I(WindowVX, "opacity",          Opacity),
+	TWEEN_FIELD_I(WindowVX, "back_opacity",     BackOpacity),
+	TWEEN_FIELD_I(WindowVX, "contents_opacity", ContentsOpacity),
+	TWEEN_FIELD_I(WindowVX, "openness",         Openness),
+	TWEEN_FIELD_END
+};
+
+static const TweenField viewportFields[] =
+{
+	TWEEN_FIELD_I(Viewport, "ox", OX),
+	TWEEN_FIELD_I(Viewport, "oy", OY),
+	TWEEN_FIELD_END
+};
+
+static const TweenField planeFields[] =
+{
+	TWEEN_FIELD_I(Plane, "ox",      OX),
+	TWEEN_FIELD_I(Plane, "oy",      OY),
+	TWEEN_FIELD_F(Plane, "zoom_x",  ZoomX),
+	TWEEN_FIELD_F(Plane, "zoom_y",  ZoomY),
+	TWEEN_FIELD_I(Plane, "opacity", Opacity),
+	TWEEN_FIELD_END
+};
+
+static const TweenField colorFields[] =
+{
+	TWEEN_FIELD_F(Color, "red",   Red),
+	TWEEN_FIELD_F(Color, "green", Green),
+	TWEEN_FIELD_F(Color, "blue",  Blue),
+	TWEEN_FIELD_F(Color, "alpha", Alpha),
+	TWEEN_FIELD_END
+};
+
+static const TweenField toneFields[] =
+{
+	TWEEN_FIELD_F(Tone, "red",   Red),
+	TWEEN_FIELD_F(Tone, "green", Green),
+	TWEEN_FIELD_F(Tone, "blue",  Blue),
+	TWEEN_FIELD_F(Tone, "gray",  Gray),
+	TWEEN_FIELD_END
+};
+
+static const TweenField *fieldTables[] =
+{
+	spriteFields,
+	windowFields,
+	windowVXFields,
+	viewportFields,
+	planeFields,
+	colorFields,
+	toneFields
+};
+
+static_assert(sizeof(fieldTables) / sizeof(fieldTables[0]) == TweenTargetCount,
+              "Missing tween field table");
+
+static const char *easingNames[] =
+{
+	"linear",
+	"ease_in",
+	"ease_out",
+	"ease_in_out",
+	"ease_in_cubic",
+	"ease_out_cubic",
+	"ease_in_out_cubic"
+};
+
+static_assert(sizeof(easingNames) / sizeof(easingNames[0]) == TweenScheduler::EasingCount,
+              "Missing easing name");
+
+static float ease(TweenScheduler::Easing easing, float t)
+{
+	switch (easing)
+	{
+	case TweenScheduler::EaseIn :
+		return t * t;
+	case TweenScheduler::EaseOut :
+		return t * (2 - t);
+	case TweenScheduler::EaseInOut :
+		return t < 0.5f ? 2 * t * t : -1 + (4 - 2 * t) * t;
+	case TweenScheduler::EaseInCubic :
+		return t * t * t;
+	case TweenScheduler::EaseOutCubic :
+		t -= 1;
+		return t * t * t + 1;
+	case TweenScheduler::EaseInOutCubic :
+		if (t < 0.5f)
+			return 4 * t * t * t;
+		t = 2 * t - 2;
+		return 0.5f * t * t * t + 1;
+	default :
+		return t;
+	}
+}
+
+TweenScheduler::TweenScheduler()
+    : nextId(0),
+      readOnly(0)
+{}
+
+const TweenField *TweenScheduler::findField(TweenTarget kind, const char *name)
+{
+	for (const TweenField *f = fieldTables[kind]; f->name; ++f)
+		if (!strcmp(f->name, name))
+			return f;
+
+	return 0;
+}
+
+TweenScheduler::Easing TweenScheduler::easingFromName(const char *name)
+{
+	for (int i = 0; i < EasingCount; ++i)
+		if (!strcmp(easingNames[i], name))
+			return static_cast<Easing>(i);
+
+	return EasingCount;
+}
+
+int TweenScheduler::add(void *target, uintptr_t owner, Disposable *disp,
+                        const TweenField *field, float to, int frames, Easing easing)
+{
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if (records[i].target != target || records[i].field != field)
+			continue;
+
+		finish(records[i], false);
+		records.erase(records.begin() + i);
+		break;
+	}
+
+	Record r;
+	r.target = target;
+	r.owner = owner;
+	r.disp = disp;
+	r.field = field;
+	r.from = field->get(target);
+	r.to = to;
+	r.frames = frames > 0 ? frames : 1;
+	r.elapsed = 0;
+	r.easing = easing;
+	r.id = nextId++;
+
+	records.push_back(r);
+
+	return r.id;
+}
+
+void TweenScheduler::setReadOnlyCheck(ReadOnlyCheck check)
+{
+	readOnly = check;
+}
+
+bool TweenScheduler::cancel(int id)
+{
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if (records[i].id != id)
+			continue;
+
+		finish(records[i], false);
+		records.erase(records.begin() + i);
+
+		return true;
+	}
+
+	return false;
+}
+
+void TweenScheduler::step()
+{
+	/* Ended records are compacted out in the
+	 * same pass, keeping the start order */
+	size_t live = 0;
+
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		Record &r = records[i];
+
+		if ((r.disp && r.disp->isDisposed()) ||
+		    (readOnly && readOnly(r.owner)))
+		{
+			finish(r, false);
+			continue;
+		}
+
+		++r.elapsed;
+
+		float t = ease(r.easing, (float) r.elapsed / r.frames);
+
+		try
+		{
+			r.field->set(r.target, r.from + (r.to - r.from) * t);
+		}
+		catch (const Exception &)
+		{
+			finish(r, false);
+			continue;
+		}
+
+		if (r.elapsed >= r.frames)
+		{
+			finish(r, true);
+			continue;
+		}
+
+		if (live != i)
+			records[live] = r;
+
+		++live;
+	}
+
+	records.resize(live);
+}
+
+bool TweenScheduler::takeFinished(std::vector<Finished> &out)
+{
+	if (finished.empty())
+		return false;
+
+	out.insert(out.end(), finished.begin(), finished.end());
+	finished.clear();
+
+	return true;
+}
+
+void TweenScheduler::clear()
+{
+	records.clear();
+	finished.clear();
+}
+
+void TweenScheduler::finish(const Record &r, bool completed)
+{
+	Finished f;
+	f.id = r.id;
+	f.completed = completed;
+
+	finished.push_back(f);
+}
@@ -0,0 +1,140 @@
+/*
+** tween.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TWEEN_H
+#define TWEEN_H
+
+#include <vector>
+#include <stdint.h>
+
+class Disposable;
+
+/* A numeric property that can be tweened. 'target'
+ * is the object the field table belongs to */
+struct TweenField
+{
+	const char *name;
+	float (*get)(void *target);
+	void (*set)(void *target, float value);
+};
+
+enum TweenTarget
+{
+	TweenSprite,
+	TweenWindow,
+	TweenWindowVX,
+	TweenViewport,
+	TweenPlane,
+	TweenColor,
+	TweenTone,
+
+	TweenTargetCount
+};
+
+/* Interpolates object properties over a number of frames.
+ * All running tweens are advanced in one pass per
+ * Graphics.update, and those that ended are collected
+ * so the binding can run their callbacks in one go */
+class TweenScheduler
+{
+public:
+	enum Easing
+	{
+		Linear,
+		EaseIn,
+		EaseOut,
+		EaseInOut,
+		EaseInCubic,
+		EaseOutCubic,
+		EaseInOutCubic,
+
+		EasingCount
+	};
+
+	struct Finished
+	{
+		int id;
+
+		/* False if the tween was cancelled, replaced
+		 * or its target was disposed or made read-only */
+		bool completed;
+	};
+
+	/* Reports whether the object 'owner' (as passed to add())
+	 * stands for must no longer be written, eg. because it
+	 * has been frozen. Checked before every step */
+	typedef bool (*ReadOnlyCheck)(uintptr_t owner);
+
+	TweenScheduler();
+
+	/* Returns null if 'kind' has no field called 'name' */
+	static const TweenField *findField(TweenTarget kind, const char *name);
+
+	/* Returns EasingCount for unknown names */
+	static Easing easingFromName(const char *name);
+
+	/* Starts moving 'field' of 'target' from its current value to
+	 * 'to' over 'frames' updates, replacing any running tween of
+	 * the same field. 'disp' is checked every step if non-null,
+	 * and so is 'owner' if a ReadOnlyCheck is set.
+	 * Returns the id the tween is reported under */
+	int add(void *target, uintptr_t owner, Disposable *disp,
+	        const TweenField *field, float to, int frames, Easing easing);
+
+	void setReadOnlyCheck(ReadOnlyCheck check);
+
+	/* Returns false if 'id' wasn't running */
+	bool cancel(int id);
+
+	/* Advances all tweens by one frame */
+	void step();
+
+	/* Appends the tweens that ended since the last call
+	 * to 'out'. Returns false if there were none */
+	bool takeFinished(std::vector<Finished> &out);
+
+	/* Drops all tweens without reporting them */
+	void clear();
+
+private:
+	struct Record
+	{
+		void *target;
+		uintptr_t owner;
+		Disposable *disp;
+		const TweenField *field;
+
+		float from;
+		float to;
+		int frames;
+		int elapsed;
+		Easing easing;
+
+		int id;
+	};
+
+	void finish(const Record &r, bool completed);
+
+	std::vector<Record> records;
+	std::vector<Finished> finished;
+	int nextId;
+	ReadOnlyCheck readOnly;
+};
+
+#endif // TWEEN_H
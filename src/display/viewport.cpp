@@ -173,13 +173,32 @@ void Viewport::setOY(int value)
 	notifyGeometryChange();
 }
 
-void Viewport::initDynAttribs()
+Rect &Viewport::initRect()
 {
-	p->rect = new Rect(*p->rect);
-	p->color = new Color;
-	p->tone = new Tone;
+	guardDisposed();
 
+	p->rect = new Rect(*p->rect);
 	p->updateRectCon();
+
+	return *p->rect;
+}
+
+Color &Viewport::initColor()
+{
+	guardDisposed();
+
+	p->color = new Color(*p->color);
+
+	return *p->color;
+}
+
+Tone &Viewport::initTone()
+{
+	guardDisposed();
+
+	p->tone = new Tone(*p->tone);
+
+	return *p->tone;
 }
 
 /* Scene */
@@ -45,7 +45,10 @@ public:
 	DECL_ATTR( Color, Color& )
 	DECL_ATTR( Tone,  Tone&  )
 
-	void initDynAttribs();
+	/* See Sprite::initSrcRect() */
+	Rect  &initRect();
+	Color &initColor();
+	Tone  &initTone();
 
 private:
 	void initViewport(int x, int y, int width, int height);
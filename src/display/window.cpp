@@ -855,11 +855,14 @@ void Window::setContentsOpacity(int value)
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
 }
 
-void Window::initDynAttribs()
+Rect &Window::initCursorRect()
 {
-	p->cursorRect = new Rect;
+	guardDisposed();
 
+	p->cursorRect = new Rect(*p->cursorRect);
 	p->refreshCursorRectCon();
+
+	return *p->cursorRect;
 }
 
 void Window::draw()
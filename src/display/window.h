@@ -56,7 +56,8 @@ public:
 	DECL_ATTR( BackOpacity,     int     )
 	DECL_ATTR( ContentsOpacity, int     )
 
-	void initDynAttribs();
+	/* See Sprite::initSrcRect() */
+	Rect &initCursorRect();
 
 private:
 	WindowPrivate *p;
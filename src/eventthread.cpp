@@ -88,6 +88,18 @@ EventThread::ControllerState EventThread::controllerState;
 EventThread::MouseState EventThread::mouseState;
 EventThread::TouchState EventThread::touchState;
 SDL_atomic_t EventThread::verticalScrollDistance;
+InputRing EventThread::inputRing;
+
+static void pushInputEvent(InputEvent::Type type, int code, int value = 0)
+{
+    InputEvent e;
+    e.type = type;
+    e.code = code;
+    e.value = value;
+    e.time = SDL_GetPerformanceCounter();
+    
+    EventThread::inputRing.push(e);
+}
 
 /* User event codes */
 enum
@@ -408,6 +420,9 @@ void EventThread::process(RGSSThreadData &rtData)
                 }
                 
                 keyStates[event.key.keysym.scancode] = true;
+                
+                if (!event.key.repeat)
+                    pushInputEvent(InputEvent::KeyDown, event.key.keysym.scancode);
                 break;
                 
             case SDL_KEYUP :
@@ -422,18 +437,22 @@ void EventThread::process(RGSSThreadData &rtData)
                 }
                 
                 keyStates[event.key.keysym.scancode] = false;
+                pushInputEvent(InputEvent::KeyUp, event.key.keysym.scancode);
                 break;
                 
             case SDL_CONTROLLERBUTTONDOWN:
                 controllerState.buttons[event.cbutton.button] = true;
+                pushInputEvent(InputEvent::CButtonDown, event.cbutton.button);
                 break;
                 
             case SDL_CONTROLLERBUTTONUP:
                 controllerState.buttons[event.cbutton.button] = false;
+                pushInputEvent(InputEvent::CButtonUp, event.cbutton.button);
                 break;
                 
             case SDL_CONTROLLERAXISMOTION:
                 controllerState.axes[event.caxis.axis] = event.caxis.value;
+                pushInputEvent(InputEvent::CAxis, event.caxis.axis, event.caxis.value);
                 break;
                 
             case SDL_CONTROLLERDEVICEADDED:
@@ -450,10 +469,12 @@ void EventThread::process(RGSSThreadData &rtData)
                 
             case SDL_MOUSEBUTTONDOWN :
                 mouseState.buttons[event.button.button] = true;
+                pushInputEvent(InputEvent::MButtonDown, event.button.button);
                 break;
                 
             case SDL_MOUSEBUTTONUP :
                 mouseState.buttons[event.button.button] = false;
+                pushInputEvent(InputEvent::MButtonUp, event.button.button);
                 break;
                 
             case SDL_MOUSEMOTION :
@@ -686,6 +707,10 @@ void EventThread::resetInputStates()
     memset(&controllerState, 0, sizeof(controllerState));
     memset(&mouseState.buttons, 0, sizeof(mouseState.buttons));
     memset(&touchState, 0, sizeof(touchState));
+    
+    /* Also called from the RGSS thread, so rather than queueing
+     * up releases, have the consumer take a fresh snapshot */
+    inputRing.resyncReq.set();
 }
 
 void EventThread::setFullscreen(SDL_Window *win, bool mode)
@@ -36,6 +36,7 @@
 #include "etc-internal.h"
 #include "sdl-util.h"
 #include "keybindings.h"
+#include "inputring.h"
 
 struct RGSSThreadData;
 typedef struct MKXPZ_ALCDEVICE ALCdevice;
@@ -77,6 +78,9 @@ public:
 	static TouchState touchState;
     static SDL_atomic_t verticalScrollDistance;
     
+    /* State changes of the arrays above, in order of arrival */
+    static InputRing inputRing;
+    
     std::string textInputBuffer;
     void lockText(bool lock);
     
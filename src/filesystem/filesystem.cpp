@@ -275,6 +275,11 @@ struct FileSystemPrivate {
    * To:   list of lower case filenames */
   BoostHash<std::string, std::vector<std::string>> fileLists;
 
+  /* Guards both of the above. Files are opened from the
+   * background loader threads too, while the path cache
+   * may be rebuilt on the RGSS thread */
+  SDL_mutex *cacheMut;
+
   /* This is for compatibility with games that take Windows'
    * case insensitivity for granted */
   bool havePathCache;
@@ -311,12 +316,14 @@ FileSystem::FileSystem(const char *argv0, bool allowSymlinks) {
 
   p = new FileSystemPrivate;
   p->havePathCache = false;
+  p->cacheMut = SDL_CreateMutex();
 
   if (allowSymlinks)
     PHYSFS_permitSymbolicLinks(1);
 }
 
 FileSystem::~FileSystem() {
+  SDL_DestroyMutex(p->cacheMut);
   delete p;
 
   if (PHYSFS_deinit() == 0)
@@ -439,18 +446,25 @@ static PHYSFS_EnumerateCallbackResult cacheEnumCB(void *d, const char *origdir,
 }
 
 void FileSystem::createPathCache() {
+  SDL_LockMutex(p->cacheMut);
+
   CacheEnumData data(p);
   data.fileLists.push(&p->fileLists[""]);
   PHYSFS_enumerate("", cacheEnumCB, &data);
 
+  SDL_UnlockMutex(p->cacheMut);
+
   p->havePathCache = true;
 }
 
 void FileSystem::reloadPathCache() {
     if (!p->havePathCache) return;
     
+    SDL_LockMutex(p->cacheMut);
     p->fileLists.clear();
     p->pathCache.clear();
+    SDL_UnlockMutex(p->cacheMut);
+    
     createPathCache();
 }
 
@@ -531,8 +545,9 @@ struct OpenReadEnumData {
   size_t filenameN;
 
   /* Optional hash to translate full filepaths
-   * (used with path cache) */
+   * (used with path cache), and the mutex guarding it */
   BoostHash<std::string, std::string> *pathTrans;
+  SDL_mutex *pathTransMut;
 
   /* Number of files we've attempted to read and parse */
   size_t matchCount;
@@ -544,10 +559,11 @@ struct OpenReadEnumData {
 
   OpenReadEnumData(FileSystem::OpenHandler &handler, const char *filename,
                    size_t filenameN,
-                   BoostHash<std::string, std::string> *pathTrans)
+                   BoostHash<std::string, std::string> *pathTrans,
+                   SDL_mutex *pathTransMut)
       : handler(handler), filename(filename), filenameN(filenameN),
-        pathTrans(pathTrans), matchCount(0), stopSearching(false),
-        physfsError(0) {}
+        pathTrans(pathTrans), pathTransMut(pathTransMut), matchCount(0),
+        stopSearching(false), physfsError(0) {}
 };
 
 static PHYSFS_EnumerateCallbackResult
@@ -555,6 +571,7 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
   OpenReadEnumData &data = *static_cast<OpenReadEnumData *>(d);
   char buffer[512];
   const char *fullPath;
+  std::string mixedCase;
 
   if (data.stopSearching)
     return PHYSFS_ENUM_STOP;
@@ -579,8 +596,13 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
 
   /* If the path cache is active, translate from lower case
    * to mixed case path */
-  if (data.pathTrans)
-    fullPath = (*data.pathTrans)[fullPath].c_str();
+  if (data.pathTrans) {
+    SDL_LockMutex(data.pathTransMut);
+    mixedCase = data.pathTrans->value(fullPath, fullPath);
+    SDL_UnlockMutex(data.pathTransMut);
+
+    fullPath = mixedCase.c_str();
+  }
 
   PHYSFS_File *phys = PHYSFS_openRead(fullPath);
 
@@ -632,12 +654,17 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename) {
     dir = buffer;
   }
   OpenReadEnumData data(handler, file, len + buffer - delim - !root,
-                        p->havePathCache ? &p->pathCache : 0);
+                        p->havePathCache ? &p->pathCache : 0, p->cacheMut);
 
   if (p->havePathCache) {
     /* Get the list of files contained in this directory
-     * and manually iterate over them */
-    const std::vector<std::string> &fileList = p->fileLists[dir];
+     * and manually iterate over them. It's copied, as the
+     * handler may take a while and another thread could
+     * rebuild the cache meanwhile. Looking it up mustn't
+     * insert anything for directories that don't exist */
+    SDL_LockMutex(p->cacheMut);
+    const std::vector<std::string> fileList = p->fileLists.value(dir);
+    SDL_UnlockMutex(p->cacheMut);
 
     for (size_t i = 0; i < fileList.size(); ++i)
       openReadEnumCB(&data, dir, fileList[i].c_str());
@@ -679,7 +706,12 @@ const char *FileSystem::desensitize(const char *filename) {
   std::transform(fn_lower.begin(), fn_lower.end(), fn_lower.begin(), [](unsigned char c){
       return std::tolower(c);
   });
+  const char *ret = filename;
+
+  SDL_LockMutex(p->cacheMut);
   if (p->havePathCache && p->pathCache.contains(fn_lower))
-    return p->pathCache[fn_lower].c_str();
-  return filename;
+    ret = p->pathCache[fn_lower].c_str();
+  SDL_UnlockMutex(p->cacheMut);
+
+  return ret;
 }
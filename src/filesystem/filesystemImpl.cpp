@@ -27,6 +27,57 @@ bool filesystemImpl::fileExists(const char *path) {
     return (fs::exists(stdPath) && !fs::is_directory(stdPath));
 }
 
+// Creates missing parent directories as well
+bool filesystemImpl::createDirectory(const char *path) {
+    fs::path stdPath(path);
+    try {
+        fs::create_directories(stdPath);
+    } catch (...) {
+        return false;
+    }
+    return fs::is_directory(stdPath);
+}
+
+// Replaces 'to' if it exists. Plain rename and remove
+// neither take UTF-8 paths nor replace files on Windows
+bool filesystemImpl::renameFile(const char *from, const char *to) {
+    std::error_code ec;
+    fs::rename(fs::path(from), fs::path(to), ec);
+    return !ec;
+}
+
+bool filesystemImpl::removeFile(const char *path) {
+    std::error_code ec;
+    return fs::remove(fs::path(path), ec);
+}
+
+bool filesystemImpl::listFiles(const char *path, std::vector<FileEntry> &out) {
+    std::error_code ec;
+    fs::directory_iterator iter(fs::path(path), ec);
+    if (ec)
+        return false;
+
+    for (; iter != fs::directory_iterator(); iter.increment(ec)) {
+        if (ec)
+            return false;
+
+        if (!fs::is_regular_file(iter->status(ec)))
+            continue;
+
+        FileEntry entry;
+        entry.name = iter->path().filename().u8string();
+        entry.size = fs::file_size(iter->path(), ec);
+        entry.lastWrite = fs::last_write_time(iter->path(), ec).time_since_epoch().count();
+        out.push_back(entry);
+    }
+    return true;
+}
+
+bool filesystemImpl::touchFile(const char *path) {
+    std::error_code ec;
+    fs::last_write_time(fs::path(path), fs::file_time_type::clock::now(), ec);
+    return !ec;
+}
 
 // https://stackoverflow.com/questions/2912520/read-file-contents-into-a-string-in-c
 std::string filesystemImpl::contentsOfFileAsString(const char *path) {
@@ -9,11 +9,33 @@
 #define filesystemImpl_h
 
 #include <string>
+#include <vector>
+#include <stdint.h>
 #include <SDL_video.h>
 
 namespace filesystemImpl {
+struct FileEntry {
+    std::string name;
+    uint64_t size;
+    // Only meaningful compared to other entries
+    int64_t lastWrite;
+};
+
+
 bool fileExists(const char *path);
 
+bool createDirectory(const char *path);
+
+bool renameFile(const char *from, const char *to);
+
+bool removeFile(const char *path);
+
+// Regular files directly inside 'path'
+bool listFiles(const char *path, std::vector<FileEntry> &out);
+
+// Sets the modification time to now
+bool touchFile(const char *path);
+
 std::string contentsOfFileAsString(const char *path);
 
 bool setCurrentDirectory(const char *path);
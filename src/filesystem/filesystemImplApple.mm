@@ -10,6 +10,8 @@
 
 #import <SDL_filesystem.h>
 
+#import <stdio.h>
+
 #import "filesystemImpl.h"
 #import "util/exception.h"
 
@@ -22,6 +24,43 @@ bool filesystemImpl::fileExists(const char *path) {
     return  [NSFileManager.defaultManager fileExistsAtPath:PATHTONS(path) isDirectory: &isDir] && !isDir;
 }
 
+bool filesystemImpl::createDirectory(const char *path) {
+    return [NSFileManager.defaultManager createDirectoryAtPath:PATHTONS(path) withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+// NSFileManager won't move over an existing file, rename(2) does so atomically
+bool filesystemImpl::renameFile(const char *from, const char *to) {
+    return rename(from, to) == 0;
+}
+
+bool filesystemImpl::removeFile(const char *path) {
+    return [NSFileManager.defaultManager removeItemAtPath:PATHTONS(path) error:nil];
+}
+
+bool filesystemImpl::listFiles(const char *path, std::vector<FileEntry> &out) {
+    NSString *dir = PATHTONS(path);
+    NSArray<NSString*> *names = [NSFileManager.defaultManager contentsOfDirectoryAtPath:dir error:nil];
+    if (names == nil)
+        return false;
+
+    for (NSString *name in names) {
+        NSDictionary *attrs = [NSFileManager.defaultManager attributesOfItemAtPath:[dir stringByAppendingPathComponent:name] error:nil];
+        if (attrs == nil || ![attrs.fileType isEqualToString:NSFileTypeRegular])
+            continue;
+
+        FileEntry entry;
+        entry.name = std::string(NSTOPATH(name));
+        entry.size = attrs.fileSize;
+        entry.lastWrite = (int64_t)(attrs.fileModificationDate.timeIntervalSince1970 * 1000);
+        out.push_back(entry);
+    }
+    return true;
+}
+
+bool filesystemImpl::touchFile(const char *path) {
+    return [NSFileManager.defaultManager setAttributes:@{NSFileModificationDate: [NSDate date]} ofItemAtPath:PATHTONS(path) error:nil];
+}
+
 
 
 std::string filesystemImpl::contentsOfFileAsString(const char *path) {
@@ -24,6 +24,7 @@
 #include "sharedstate.h"
 #include "eventthread.h"
 #include "input/keybindings.h"
+#include "input/inputring.h"
 #include "util/exception.h"
 #include "util/util.h"
 
@@ -489,121 +490,6 @@ struct KbBindingData
     Input::ButtonCode target;
 };
 
-struct Binding
-{
-    Binding(Input::ButtonCode target = Input::None)
-    : target(target)
-    {}
-    
-    virtual bool sourceActive() const = 0;
-    virtual bool sourceRepeatable() const = 0;
-    
-    Input::ButtonCode target;
-};
-
-/* Keyboard binding */
-struct KbBinding : public Binding
-{
-    KbBinding() {}
-    
-    KbBinding(const KbBindingData &data)
-    : Binding(data.target),
-    source(data.source)
-    {}
-    
-    bool sourceActive() const
-    {
-        /* Special case aliases */
-        if (source == SDL_SCANCODE_LSHIFT)
-            return EventThread::keyStates[source]
-            || EventThread::keyStates[SDL_SCANCODE_RSHIFT];
-        
-        if (source == SDL_SCANCODE_RETURN)
-            return EventThread::keyStates[source]
-            || EventThread::keyStates[SDL_SCANCODE_KP_ENTER];
-        
-        return EventThread::keyStates[source];
-    }
-    
-    bool sourceRepeatable() const
-    {
-        return true;
-        /*
-         return (source >= SDL_SCANCODE_A     && source <= SDL_SCANCODE_0)    ||
-         (source >= SDL_SCANCODE_RIGHT && source <= SDL_SCANCODE_UP)   ||
-         (source >= SDL_SCANCODE_F1    && source <= SDL_SCANCODE_F12);
-         */
-    }
-    
-    SDL_Scancode source;
-};
-
-struct CtrlButtonBinding : public Binding
-{
-    CtrlButtonBinding() {}
-    
-    bool sourceActive() const
-    {
-        return EventThread::controllerState.buttons[source];
-    }
-    
-    bool sourceRepeatable() const
-    {
-        return true;
-    }
-    
-    SDL_GameControllerButton source;
-};
-
-struct CtrlAxisBinding : public Binding
-{
-    CtrlAxisBinding() {}
-    
-    CtrlAxisBinding(uint8_t source, AxisDir dir, Input::ButtonCode target)
-    : Binding(target), source(source), dir(dir) {}
-    
-    bool sourceActive() const
-    {
-        float val = EventThread::controllerState.axes[source];
-        
-        if (dir == Negative)
-            return val < -JAXIS_THRESHOLD;
-        else
-            return val > JAXIS_THRESHOLD;
-    }
-    
-    bool sourceRepeatable() const {
-        return true;
-    }
-    
-    uint8_t source;
-    AxisDir dir;
-};
-
-/* Mouse button binding */
-struct MsBinding : public Binding
-{
-    MsBinding() {}
-    
-    MsBinding(int buttonIndex,
-              Input::ButtonCode target)
-    : Binding(target),
-    index(buttonIndex)
-    {}
-    
-    bool sourceActive() const
-    {
-        return EventThread::mouseState.buttons[index];
-    }
-    
-    bool sourceRepeatable() const
-    {
-        return true;
-    }
-    
-    int index;
-};
-
 /* Not rebindable */
 static const KbBindingData staticKbBindings[] =
 {
@@ -622,6 +508,23 @@ static const KbBindingData staticKbBindings[] =
 
 static elementsN(staticKbBindings);
 
+struct MsBindingData
+{
+    int index;
+    Input::ButtonCode target;
+};
+
+static const MsBindingData msBindings[] =
+{
+    { SDL_BUTTON_LEFT,   Input::MouseLeft   },
+    { SDL_BUTTON_MIDDLE, Input::MouseMiddle },
+    { SDL_BUTTON_RIGHT,  Input::MouseRight  },
+    { SDL_BUTTON_X1,     Input::MouseX1     },
+    { SDL_BUTTON_X2,     Input::MouseX2     }
+};
+
+static elementsN(msBindings);
+
 /* Maps ButtonCode enum values to indices
  * in the button state array */
 static const int mapToIndex[] =
@@ -666,33 +569,70 @@ static const Input::ButtonCode otherDirs[4][3] =
     { Input::Left, Input::Right, Input::Up    }  /* Up    */
 };
 
+/* Button, key and mouse states are kept as bitsets, one bit
+ * per button index / scancode / button number */
+#define SCANCODE_WORDS ((SDL_NUM_SCANCODES + 63) / 64)
+
+static_assert(BUTTON_CODE_COUNT <= 32, "Button states must fit into 32 bits");
+static_assert(SDL_CONTROLLER_BUTTON_MAX <= 32, "Controller buttons must fit into 32 bits");
+
+static inline int lowestBit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int i = 0;
+    while (!(value & 1)) { value >>= 1; ++i; }
+    return i;
+#endif
+}
+
+static inline uint32_t buttonBit(int code)
+{
+    if (code < 0 || (size_t) code > mapToIndexN-1)
+        return 0;
+    
+    /* Index 0 collects everything that isn't a button */
+    return (1u << mapToIndex[code]) & ~1u;
+}
+
+static inline bool testBit(const uint64_t *bits, int index)
+{
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
 struct InputPrivate
 {
-    std::vector<KbBinding> kbStatBindings;
-    std::vector<KbBinding> kbBindings;
-    std::vector<CtrlAxisBinding> ctrlABindings;
-    std::vector<CtrlButtonBinding> ctrlBBindings;
-    std::vector<MsBinding> msBindings;
+    /* Current binding set, as set up in the settings menu */
+    BDescVec bindingDescs;
     
-    /* Collective binding array */
-    std::vector<Binding*> bindings;
+    /* Precomputed binding resolution: which buttons each
+     * source drives, as a mask of button bits */
+    uint32_t keyTargets[SDL_NUM_SCANCODES];
+    uint32_t cButtonTargets[SDL_CONTROLLER_BUTTON_MAX];
+    uint32_t cAxisTargets[SDL_CONTROLLER_AXIS_MAX][2];
+    uint32_t mouseTargets[32];
     
-    ButtonState stateArray[BUTTON_CODE_COUNT*2];
+    /* Map button index back to ButtonCode */
+    Input::ButtonCode indexToCode[BUTTON_CODE_COUNT];
     
-    ButtonState *states;
-    ButtonState *statesOld;
+    /* Button states of this and the last frame */
+    uint32_t pressed, pressedOld;
+    uint32_t repeated;
     
     // Raw keystates
-    uint8_t rawStateArray[SDL_NUM_SCANCODES*2];
-    
-    uint8_t *rawStates;
-    uint8_t *rawStatesOld;
+    uint64_t rawKeys[SCANCODE_WORDS];
+    uint64_t rawKeysOld[SCANCODE_WORDS];
     
     // Gamepad button states
-    uint8_t rawButtonStateArray[SDL_CONTROLLER_BUTTON_MAX*2];
+    uint32_t rawButtons, rawButtonsOld;
+    
+    // Mouse button states
+    uint32_t mouseButtons;
     
-    uint8_t *rawButtonStates;
-    uint8_t *rawButtonStatesOld;
+    // Byte per key/button copies for the raw state getters
+    uint8_t rawKeyBytes[SDL_NUM_SCANCODES];
+    uint8_t rawButtonBytes[SDL_CONTROLLER_BUTTON_MAX];
     
     // Gamepad axes & mouse coordinates
     int16_t axisStateArray[SDL_CONTROLLER_AXIS_MAX];
@@ -713,6 +653,8 @@ struct InputPrivate
     unsigned int repeatDelay;
     
     double last_update;
+    
+    uint64_t eventTime;
 
     int vScrollDistance;
     
@@ -748,9 +690,17 @@ struct InputPrivate
     InputPrivate(const RGSSThreadData &rtData)
     {
         last_update = 0;
+        eventTime = 0;
+        
+        for (size_t i = 0; i < BUTTON_CODE_COUNT; ++i)
+            indexToCode[i] = Input::None;
+        
+        for (size_t i = 0; i < mapToIndexN; ++i)
+            if (mapToIndex[i])
+                indexToCode[mapToIndex[i]] = (Input::ButtonCode) i;
         
-        initStaticKbBindings();
-        initMsBindings();
+        /* Static bindings */
+        applyBindingDesc(BDescVec());
         
         /* Main thread should have these posted by now */
         checkBindingChange(rtData);
@@ -759,22 +709,23 @@ struct InputPrivate
         if (!fps) fps = (rgssVer >= 2) ? 60 : 40;
         recalcRepeatTime(fps);
         
-        states    = stateArray;
-        statesOld = stateArray + BUTTON_CODE_COUNT;
-        
-        rawStates = rawStateArray;
-        rawStatesOld = rawStateArray + SDL_NUM_SCANCODES;
-        
-        rawButtonStates = rawButtonStateArray;
-        rawButtonStatesOld = rawButtonStateArray + SDL_CONTROLLER_BUTTON_MAX;
-        
         /* Clear buffers */
-        clearBuffer();
-        swapBuffers();
-        clearBuffer();
+        pressed = pressedOld = repeated = 0;
+        memset(rawKeys, 0, sizeof(rawKeys));
+        memset(rawKeysOld, 0, sizeof(rawKeysOld));
+        rawButtons = rawButtonsOld = 0;
+        mouseButtons = 0;
+        memset(axisStateArray, 0, sizeof(axisStateArray));
+        
+        /* Events before this point have no queue consumer yet */
+        EventThread::inputRing.resyncReq.set();
         
         repeating = Input::None;
         repeatCount = 0;
+        rawRepeating = -1;
+        rawRepeatCount = 0;
+        buttonRepeating = -1;
+        buttonRepeatCount = 0;
         
         dir4Data.active = 0;
         dir4Data.previous = Input::None;
@@ -784,26 +735,22 @@ struct InputPrivate
         vScrollDistance = 0;
     }
     
-    inline ButtonState &getStateCheck(int code)
-    {
-        int index;
-        
-        if (code < 0 || (size_t) code > mapToIndexN-1)
-            index = 0;
-        else
-            index = mapToIndex[code];
-        
-        return states[index];
-    }
-    
-    inline ButtonState &getState(Input::ButtonCode code)
+    inline bool isDown(Input::ButtonCode code) const
     {
-        return states[mapToIndex[code]];
+        return pressed & buttonBit(code);
     }
     
-    inline ButtonState &getOldState(Input::ButtonCode code)
+    ButtonState getStateCheck(int code) const
     {
-        return statesOld[mapToIndex[code]];
+        ButtonState b;
+        const uint32_t bit = buttonBit(code);
+        
+        b.pressed = pressed & bit;
+        b.triggered = (pressed & ~pressedOld) & bit;
+        b.released = (~pressed & pressedOld) & bit;
+        b.repeated = repeated & bit;
+        
+        return b;
     }
     
     ButtonState getStateRaw(int code, bool useVKey)
@@ -815,27 +762,27 @@ struct InputPrivate
             switch (code)
             {
                 case 0x10:
-                    return getState(Input::Shift);
+                    return getStateCheck(Input::Shift);
                     break;
                     
                 case 0x11:
-                    return getState(Input::Ctrl);
+                    return getStateCheck(Input::Ctrl);
                     break;
                     
                 case 0x12:
-                    return getState(Input::Alt);
+                    return getStateCheck(Input::Alt);
                     break;
                     
                 case 0x1:
-                    return getState(Input::MouseLeft);
+                    return getStateCheck(Input::MouseLeft);
                     break;
                     
                 case 0x2:
-                    return getState(Input::MouseRight);
+                    return getStateCheck(Input::MouseRight);
                     break;
                     
                 case 0x4:
-                    return getState(Input::MouseMiddle);
+                    return getStateCheck(Input::MouseMiddle);
                     break;
                     
                 default:
@@ -850,9 +797,15 @@ struct InputPrivate
             }
         }
         
-        b.pressed = rawStates[scancode];
-        b.triggered = (rawStates[scancode] && !rawStatesOld[scancode]);
-        b.released = (!rawStates[scancode] && rawStatesOld[scancode]);
+        if (scancode < 0 || scancode >= SDL_NUM_SCANCODES)
+            return b;
+        
+        const bool now = testBit(rawKeys, scancode);
+        const bool old = testBit(rawKeysOld, scancode);
+        
+        b.pressed = now;
+        b.triggered = (now && !old);
+        b.released = (!now && old);
         
         b.repeated = (rawRepeating == scancode) && (rawRepeatCount >= repeatStart && ((rawRepeatCount+1) % repeatDelay) == 0);
         
@@ -862,9 +815,14 @@ struct InputPrivate
     ButtonState getControllerButtonState(int button) {
         ButtonState b;
         
-        b.pressed = rawButtonStates[button];
-        b.triggered = (rawButtonStates[button] && !rawButtonStatesOld[button]);
-        b.released = (!rawButtonStates[button] && rawButtonStatesOld[button]);
+        if (button < 0 || button >= SDL_CONTROLLER_BUTTON_MAX)
+            return b;
+        
+        const uint32_t bit = 1u << button;
+        
+        b.pressed = rawButtons & bit;
+        b.triggered = (rawButtons & ~rawButtonsOld) & bit;
+        b.released = (~rawButtons & rawButtonsOld) & bit;
         
         b.repeated = (buttonRepeating == button) && (buttonRepeatCount >= repeatStart && ((buttonRepeatCount+1) % repeatDelay) == 0);
         
@@ -873,27 +831,94 @@ struct InputPrivate
     
     void swapBuffers()
     {
-        ButtonState *tmp = states;
-        states = statesOld;
-        statesOld = tmp;
+        pressedOld = pressed;
+        memcpy(rawKeysOld, rawKeys, sizeof(rawKeys));
+        rawButtonsOld = rawButtons;
+    }
+    
+    /* Takes over the event thread's state wholesale */
+    void resyncRaw()
+    {
+        memset(rawKeys, 0, sizeof(rawKeys));
+        for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+            if (EventThread::keyStates[i])
+                rawKeys[i / 64] |= (uint64_t) 1 << (i % 64);
         
-        uint8_t *tmpr = rawStates;
-        rawStates = rawStatesOld;
-        rawStatesOld = tmpr;
+        rawButtons = 0;
+        for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i)
+            if (EventThread::controllerState.buttons[i])
+                rawButtons |= 1u << i;
         
-        uint8_t *tmpb = rawButtonStates;
-        rawButtonStates = rawButtonStatesOld;
-        rawButtonStatesOld = tmpb;
+        for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; ++i)
+            axisStateArray[i] = EventThread::controllerState.axes[i];
+        
+        mouseButtons = 0;
+        for (int i = 0; i < 32; ++i)
+            if (EventThread::mouseState.buttons[i])
+                mouseButtons |= 1u << i;
+    }
+    
+    void applyEvent(const InputEvent &e)
+    {
+        switch (e.type)
+        {
+            case InputEvent::KeyDown :
+            case InputEvent::KeyUp :
+            {
+                if (e.code >= SDL_NUM_SCANCODES)
+                    break;
+                
+                const uint64_t bit = (uint64_t) 1 << (e.code % 64);
+                if (e.type == InputEvent::KeyDown)
+                    rawKeys[e.code / 64] |= bit;
+                else
+                    rawKeys[e.code / 64] &= ~bit;
+                break;
+            }
+            case InputEvent::CButtonDown :
+                if (e.code < SDL_CONTROLLER_BUTTON_MAX)
+                    rawButtons |= 1u << e.code;
+                break;
+            case InputEvent::CButtonUp :
+                if (e.code < SDL_CONTROLLER_BUTTON_MAX)
+                    rawButtons &= ~(1u << e.code);
+                break;
+            case InputEvent::CAxis :
+                if (e.code < SDL_CONTROLLER_AXIS_MAX)
+                    axisStateArray[e.code] = e.value;
+                break;
+            case InputEvent::MButtonDown :
+                if (e.code < 32)
+                    mouseButtons |= 1u << e.code;
+                break;
+            case InputEvent::MButtonUp :
+                if (e.code < 32)
+                    mouseButtons &= ~(1u << e.code);
+                break;
+        }
     }
     
-    void clearBuffer()
+    /* Applies everything the event thread queued up since the last frame */
+    void drainEvents()
     {
-        const size_t size = sizeof(ButtonState) * BUTTON_CODE_COUNT;
-        memset(states, 0, size);
+        InputRing &ring = EventThread::inputRing;
+        InputEvent e;
         
-        memset(rawStates, 0, SDL_NUM_SCANCODES);
+        if (ring.resyncReq)
+        {
+            ring.resyncReq.clear();
+            
+            while (ring.pop(e)) {}
+            resyncRaw();
+        }
         
-        memset(rawButtonStates, 0, SDL_CONTROLLER_BUTTON_MAX);
+        while (ring.pop(e))
+        {
+            if (eventTime == 0)
+                eventTime = e.time;
+            
+            applyEvent(e);
+        }
     }
     
     void checkBindingChange(const RGSSThreadData &rtData)
@@ -906,18 +931,34 @@ struct InputPrivate
         applyBindingDesc(d);
     }
     
-    template<class B>
-    void appendBindings(std::vector<B> &bind)
+    void addKeyTarget(SDL_Scancode source, Input::ButtonCode target)
     {
-        for (size_t i = 0; i < bind.size(); ++i)
-            bindings.push_back(&bind[i]);
+        const uint32_t bit = buttonBit(target);
+        
+        keyTargets[source] |= bit;
+        
+        /* Special case aliases */
+        if (source == SDL_SCANCODE_LSHIFT)
+            keyTargets[SDL_SCANCODE_RSHIFT] |= bit;
+        
+        if (source == SDL_SCANCODE_RETURN)
+            keyTargets[SDL_SCANCODE_KP_ENTER] |= bit;
     }
     
     void applyBindingDesc(const BDescVec &d)
     {
-        kbBindings.clear();
-        ctrlABindings.clear();
-        ctrlBBindings.clear();
+        bindingDescs = d;
+        
+        memset(keyTargets, 0, sizeof(keyTargets));
+        memset(cButtonTargets, 0, sizeof(cButtonTargets));
+        memset(cAxisTargets, 0, sizeof(cAxisTargets));
+        memset(mouseTargets, 0, sizeof(mouseTargets));
+        
+        for (size_t i = 0; i < staticKbBindingsN; ++i)
+            addKeyTarget(staticKbBindings[i].source, staticKbBindings[i].target);
+        
+        for (size_t i = 0; i < msBindingsN; ++i)
+            mouseTargets[msBindings[i].index] |= buttonBit(msBindings[i].target);
         
         for (size_t i = 0; i < d.size(); ++i)
         {
@@ -932,143 +973,85 @@ struct InputPrivate
                 case Invalid :
                     break;
                 case Key :
-                {
-                    KbBinding bind;
-                    bind.source = src.d.scan;
-                    bind.target = desc.target;
-                    kbBindings.push_back(bind);
+                    if (src.d.scan >= 0 && src.d.scan < SDL_NUM_SCANCODES)
+                        addKeyTarget(src.d.scan, desc.target);
                     
                     break;
-                }
                 case CAxis :
-                {
-                    CtrlAxisBinding bind;
-                    bind.source = src.d.ca.axis;
-                    bind.dir = src.d.ca.dir;
-                    bind.target = desc.target;
-                    ctrlABindings.push_back(bind);
+                    if (src.d.ca.axis >= 0 && src.d.ca.axis < SDL_CONTROLLER_AXIS_MAX)
+                        cAxisTargets[src.d.ca.axis][src.d.ca.dir] |= buttonBit(desc.target);
                     
                     break;
-                }
                 case CButton :
-                {
-                    CtrlButtonBinding bind;
-                    bind.source = src.d.cb;
-                    bind.target = desc.target;
-                    ctrlBBindings.push_back(bind);
+                    if (src.d.cb >= 0 && src.d.cb < SDL_CONTROLLER_BUTTON_MAX)
+                        cButtonTargets[src.d.cb] |= buttonBit(desc.target);
                     
                     break;
-                }
                 default :
                     assert(!"unreachable");
             }
         }
-        
-        bindings.clear();
-        
-        appendBindings(kbStatBindings);
-        appendBindings(msBindings);
-        
-        appendBindings(kbBindings);
-        appendBindings(ctrlABindings);
-        appendBindings(ctrlBBindings);
-    }
-    
-    void initStaticKbBindings()
-    {
-        kbStatBindings.clear();
-        
-        for (size_t i = 0; i < staticKbBindingsN; ++i)
-            kbStatBindings.push_back(KbBinding(staticKbBindings[i]));
-    }
-    
-    void initMsBindings()
-    {
-        msBindings.resize(5);
-        
-        size_t i = 0;
-        msBindings[i++] = MsBinding(SDL_BUTTON_LEFT,   Input::MouseLeft);
-        msBindings[i++] = MsBinding(SDL_BUTTON_MIDDLE, Input::MouseMiddle);
-        msBindings[i++] = MsBinding(SDL_BUTTON_RIGHT,  Input::MouseRight);
-        msBindings[i++] = MsBinding(SDL_BUTTON_X1, Input::MouseX1);
-        msBindings[i++] = MsBinding(SDL_BUTTON_X2, Input::MouseX2);
     }
     
     void pollBindings(Input::ButtonCode &repeatCand)
     {
-        for (Binding *bind : bindings) {
-            // Get all binding states
-            pollBindingPriv(*bind, repeatCand);
-        }
+        uint32_t mask = 0;
         
-        for (Binding *bind : bindings) {
-            // Check for released buttons, now that all the bindings
-            // have been checked
-            ButtonState &state = getState(bind->target);
-            ButtonState &oldState = getOldState(bind->target);
-            if (!state.pressed && oldState.pressed)
-                state.released = true;
-        }
+        for (int w = 0; w < SCANCODE_WORDS; ++w)
+            for (uint64_t bits = rawKeys[w]; bits; bits &= bits - 1)
+                mask |= keyTargets[w * 64 + lowestBit(bits)];
         
-        updateDir4();
-        updateDir8();
-    }
-    
-    void pollBindingPriv(const Binding &b,
-                         Input::ButtonCode &repeatCand)
-    {
-        if (!b.sourceActive())
-            return;
+        for (uint32_t bits = rawButtons; bits; bits &= bits - 1)
+            mask |= cButtonTargets[lowestBit(bits)];
         
-        if (b.target == Input::None)
-            return;
+        for (uint32_t bits = mouseButtons; bits; bits &= bits - 1)
+            mask |= mouseTargets[lowestBit(bits)];
         
-        ButtonState &state = getState(b.target);
-        ButtonState &oldState = getOldState(b.target);
+        for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; ++i)
+        {
+            if (axisStateArray[i] < -JAXIS_THRESHOLD)
+                mask |= cAxisTargets[i][Negative];
+            else if (axisStateArray[i] > JAXIS_THRESHOLD)
+                mask |= cAxisTargets[i][Positive];
+        }
         
-        state.pressed = true;
+        pressed = mask;
+        repeated = 0;
         
-        /* Must have been released before to trigger */
-        if (!oldState.pressed)
-            state.triggered = true;
+        /* Any newly pressed button can start a new repeat;
+         * if several are, the lowest button code wins */
+        const uint32_t triggered = pressed & ~pressedOld;
         
-        /* Unbound keys don't create/break repeat */
-        if (repeatCand != Input::None)
-            return;
+        if (triggered)
+            repeatCand = indexToCode[lowestBit(triggered)];
         
-        if (repeating != b.target &&
-            !oldState.pressed)
-        {
-            if (b.sourceRepeatable())
-                repeatCand = b.target;
-            else
-            /* Unrepeatable keys still break current repeat */
-                repeating = Input::None;
-        }
+        updateDir4();
+        updateDir8();
     }
     
     void updateRaw()
     {
-        
-        memcpy(rawStates, shState->eThread().keyStates, SDL_NUM_SCANCODES);
-        
-        for (int i = 0; i < SDL_NUM_SCANCODES; i++)
+        for (int w = 0; w < SCANCODE_WORDS; ++w)
         {
-            if (rawStates[i] && rawStatesOld[i])
+            const uint64_t held = rawKeys[w] & rawKeysOld[w];
+            
+            if (!held)
+                continue;
+            
+            const int i = w * 64 + lowestBit(held);
+            
+            if (rawRepeating == i)
             {
-                if (rawRepeating == i)
-                {
-                    rawRepeatCount++;
-                }
-                else
-                {
-                    rawRepeatCount = 0;
-                    rawRepeatTime = shState->runTime();
-                    rawRepeating = i;
-                }
-                
-                return;
+                rawRepeatCount++;
+            }
+            else
+            {
+                rawRepeatCount = 0;
+                rawRepeatTime = shState->runTime();
+                rawRepeating = i;
             }
+            
+            return;
         }
         
         rawRepeating = -1;
@@ -1077,26 +1060,22 @@ struct InputPrivate
     
     void updateControllerRaw()
     {
-        for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; i++)
-            axisStateArray[i] = shState->eThread().controllerState.axes[i];
-        
-        memcpy(rawButtonStates, shState->eThread().controllerState.buttons, SDL_CONTROLLER_BUTTON_MAX);
+        const uint32_t held = rawButtons & rawButtonsOld;
         
-        for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; i++)
+        if (held)
         {
-            if (rawButtonStates[i] && rawButtonStatesOld[i])
+            const int i = lowestBit(held);
+            
+            if (buttonRepeating == i)
+                buttonRepeatCount++;
+            else
             {
-                if (buttonRepeating == i)
-                    buttonRepeatCount++;
-                else
-                {
-                    buttonRepeatCount = 0;
-                    buttonRepeatTime = shState->runTime();
-                    buttonRepeating = i;
-                }
-                
-                return;
+                buttonRepeatCount = 0;
+                buttonRepeatTime = shState->runTime();
+                buttonRepeating = i;
             }
+            
+            return;
         }
         
         buttonRepeating = -1;
@@ -1107,7 +1086,7 @@ struct InputPrivate
         int dirFlag = 0;
         
         for (size_t i = 0; i < 4; ++i)
-            dirFlag |= (getState(dirs[i]).pressed ? dirFlags[i] : 0);
+            dirFlag |= (isDown(dirs[i]) ? dirFlags[i] : 0);
         
         if (dirFlag == deadDirFlags[0] || dirFlag == deadDirFlags[1])
         {
@@ -1118,14 +1097,14 @@ struct InputPrivate
         if (dir4Data.previous != Input::None)
         {
             /* Check if prev still pressed */
-            if (getState(dir4Data.previous).pressed)
+            if (isDown(dir4Data.previous))
             {
                 for (size_t i = 0; i < 3; ++i)
                 {
                     Input::ButtonCode other =
                     otherDirs[(dir4Data.previous/2)-1][i];
                     
-                    if (!getState(other).pressed)
+                    if (!isDown(other))
                         continue;
                     
                     dir4Data.active = other;
@@ -1136,7 +1115,7 @@ struct InputPrivate
         
         for (size_t i = 0; i < 4; ++i)
         {
-            if (!getState(dirs[i]).pressed)
+            if (!isDown(dirs[i]))
                 continue;
             
             dir4Data.active = dirs[i];
@@ -1164,14 +1143,14 @@ struct InputPrivate
         {
             Input::ButtonCode one = dirs[i];
             
-            if (!getState(one).pressed)
+            if (!isDown(one))
                 continue;
             
             for (int j = 0; j < 3; ++j)
             {
                 Input::ButtonCode other = otherDirs[i][j];
                 
-                if (!getState(other).pressed)
+                if (!isDown(other))
                     continue;
                 
                 dir8Data.active = combos[(one/2)-1][(other/2)-1];
@@ -1194,6 +1173,13 @@ double Input::getDelta() {
     return shState->runTime() - p->last_update;
 }
 
+uint64_t Input::takeEventTime() {
+    uint64_t time = p->eventTime;
+    p->eventTime = 0;
+    
+    return time;
+}
+
 void Input::recalcRepeat(unsigned int fps) {
     p->recalcRepeatTime(fps);
 }
@@ -1204,14 +1190,14 @@ void Input::update()
     p->checkBindingChange(shState->rtData());
     
     p->swapBuffers();
-    p->clearBuffer();
+    p->drainEvents();
     
     ButtonCode repeatCand = None;
     
-    /* Poll all bindings */
+    /* Resolve bindings */
     p->pollBindings(repeatCand);
     
-    // Update raw keys, controller buttons and axes
+    // Update raw key and controller button repeats
     p->updateRaw();
     p->updateControllerRaw();
     
@@ -1227,14 +1213,14 @@ void Input::update()
         p->repeating = repeatCand;
         p->repeatCount = 0;
         p->repeatTime = shState->runTime();
-        p->getState(repeatCand).repeated = true;
+        p->repeated |= buttonBit(repeatCand);
         
         p->last_update = p->repeatTime;
         return;
     }
     
     /* Check if repeating key is still pressed */
-    if (p->getState(p->repeating).pressed)
+    if (p->isDown(p->repeating))
     {
         p->repeatCount++;
         
@@ -1246,7 +1232,8 @@ void Input::update()
          repeated = p->repeatCount >= 15 && ((p->repeatCount+1) % 4) == 0;
          */
         bool repeated = p->repeatCount >= p->repeatStart && ((p->repeatCount+1) % p->repeatDelay) == 0;
-        p->getState(p->repeating).repeated |= repeated;
+        if (repeated)
+            p->repeated |= buttonBit(p->repeating);
         
         p->last_update = shState->runTime();
         return;
@@ -1262,19 +1249,21 @@ void Input::update()
 
 std::vector<std::string> Input::getBindings(ButtonCode code) {
     std::vector<std::string> ret;
-    for (const auto &b : p->kbBindings) {
-        if (b.target != code) continue;
-        ret.push_back(SDL_GetScancodeName(b.source));
+    const BDescVec &d = p->bindingDescs;
+    
+    for (const auto &b : d) {
+        if (b.target != code || b.src.type != Key) continue;
+        ret.push_back(SDL_GetScancodeName(b.src.d.scan));
     }
     
-    for (const auto &b : p->ctrlBBindings) {
-        if (b.target != code) continue;
-        ret.push_back(std::string("CBUTTON") + std::to_string(b.source));
+    for (const auto &b : d) {
+        if (b.target != code || b.src.type != CButton) continue;
+        ret.push_back(std::string("CBUTTON") + std::to_string(b.src.d.cb));
     }
     
-    for (const auto &b : p->ctrlABindings) {
-        if (b.target != code) continue;
-        ret.push_back(std::string("CAXIS") + std::to_string(b.source));
+    for (const auto &b : d) {
+        if (b.target != code || b.src.type != CAxis) continue;
+        ret.push_back(std::string("CAXIS") + std::to_string(b.src.d.ca.axis));
     }
     
     return ret;
@@ -1393,19 +1382,25 @@ double Input::controllerRepeatTimeEx(int button) {
 }
 
 uint8_t *Input::rawKeyStates(){
-    return p->rawStates;
+    for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+        p->rawKeyBytes[i] = testBit(p->rawKeys, i);
+    
+    return p->rawKeyBytes;
 }
 
 unsigned int Input::rawKeyStatesLength() {
-    return sizeof(p->rawStateArray) / 2;
+    return sizeof(p->rawKeyBytes);
 }
 
 uint8_t *Input::rawButtonStates() {
-    return p->rawButtonStates;
+    for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i)
+        p->rawButtonBytes[i] = (p->rawButtons >> i) & 1;
+    
+    return p->rawButtonBytes;
 }
 
 unsigned int Input::rawButtonStatesLength() {
-    return sizeof(p->rawButtonStateArray) / 2;
+    return sizeof(p->rawButtonBytes);
 }
 
 int16_t *Input::rawAxes() {
@@ -61,6 +61,11 @@ public:
     double getDelta();
 	void update();
     
+    /* Performance counter timestamp of the oldest input event
+     * picked up by the last update(), or 0 if there was none.
+     * Resets to 0 once taken */
+    uint64_t takeEventTime();
+    
     std::vector<std::string> getBindings(ButtonCode code);
     
 	bool isPressed(int button);
@@ -0,0 +1,111 @@
+/*
+** inputring.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUTRING_H
+#define INPUTRING_H
+
+#include "sdl-util.h"
+
+#include <SDL_atomic.h>
+
+#include <stdint.h>
+
+/* Must be a power of two */
+#define INPUT_RING_SIZE 1024
+
+struct InputEvent
+{
+	enum Type
+	{
+		KeyDown,
+		KeyUp,
+		CButtonDown,
+		CButtonUp,
+		CAxis,
+		MButtonDown,
+		MButtonUp
+	};
+
+	uint8_t type;
+
+	/* Scancode, button or axis index */
+	uint16_t code;
+
+	/* Axis value */
+	int16_t value;
+
+	/* SDL_GetPerformanceCounter() at the time
+	 * the event thread received the event */
+	uint64_t time;
+};
+
+/* Single producer (event thread), single consumer (RGSS thread)
+ * queue of input state changes. Neither side ever blocks */
+struct InputRing
+{
+	InputRing()
+	{
+		SDL_AtomicSet(&head, 0);
+		SDL_AtomicSet(&tail, 0);
+	}
+
+	/* Producer side. When the consumer can't keep up, the event is
+	 * dropped and a resync is requested instead */
+	void push(const InputEvent &event)
+	{
+		int h = SDL_AtomicGet(&head);
+
+		if (h - SDL_AtomicGet(&tail) == INPUT_RING_SIZE)
+		{
+			resyncReq.set();
+			return;
+		}
+
+		events[h & (INPUT_RING_SIZE-1)] = event;
+		SDL_AtomicSet(&head, h + 1);
+	}
+
+	/* Consumer side */
+	bool pop(InputEvent &out)
+	{
+		int t = SDL_AtomicGet(&tail);
+
+		if (t == SDL_AtomicGet(&head))
+			return false;
+
+		out = events[t & (INPUT_RING_SIZE-1)];
+		SDL_AtomicSet(&tail, t + 1);
+
+		return true;
+	}
+
+	/* Set when queued events no longer add up to the current
+	 * state (overflow, or state reset outside the event loop).
+	 * The consumer should then drain the queue and take a
+	 * fresh snapshot of the event thread's state */
+	AtomicFlag resyncReq;
+
+private:
+	SDL_atomic_t head;
+	SDL_atomic_t tail;
+
+	InputEvent events[INPUT_RING_SIZE];
+};
+
+#endif // INPUTRING_H
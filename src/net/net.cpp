@@ -12,11 +12,30 @@
 #endif
 #include "httplib.h"
 
+#include "filesystem/filesystem.h"
 #include "util/exception.h"
+#include "util/sdl-util.h"
+
+#include <zlib.h>
+#ifdef MKXPZ_SSL
+#include <openssl/evp.h>
+#endif
 
 #include "LUrlParser.h"
 #include "net.h"
 
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#define HTTP_ASYNC_WORKERS 4
+// httplib holds its socket lock while connecting, so this also
+// bounds how long cancel() and shutdown can wait on a worker
+#define HTTP_ASYNC_CONNECT_TIMEOUT 5
+#define DOWNLOAD_CHUNK_SIZE (64 * 1024)
+
 const char* httpErrorNames[] = {
     "Success",
     "Unknown",
@@ -242,3 +261,575 @@ HTTPResponse HTTPRequest::post(const char *body, const char *content_type) {
     delete client;
     return ret;
 }
+
+// Lower-case hex digest of the file at 'path'. 'algorithm' is
+// checked by checkHashAlgorithm before anything is downloaded
+static std::string hashFile(const std::string &path, const std::string &algorithm) {
+    SDL_RWops *in = SDL_RWFromFile(path.c_str(), "rb");
+    if (!in)
+        throw Exception(Exception::IOError, "Failed to open %s for hashing", path.c_str());
+    
+    std::vector<unsigned char> buf(DOWNLOAD_CHUNK_SIZE);
+    size_t len;
+    std::string digest;
+    
+    if (algorithm == "crc32") {
+        uLong crc = crc32(0, Z_NULL, 0);
+        
+        while ((len = SDL_RWread(in, buf.data(), 1, buf.size())) > 0)
+            crc = crc32(crc, buf.data(), (uInt)len);
+        
+        char crcHex[9];
+        snprintf(crcHex, sizeof(crcHex), "%08lx", (unsigned long)crc);
+        digest = crcHex;
+    }
+#ifdef MKXPZ_SSL
+    else if (algorithm == "sha256") {
+        EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+        
+        while ((len = SDL_RWread(in, buf.data(), 1, buf.size())) > 0)
+            EVP_DigestUpdate(ctx, buf.data(), len);
+        
+        unsigned char md[EVP_MAX_MD_SIZE];
+        unsigned int mdLen = 0;
+        EVP_DigestFinal_ex(ctx, md, &mdLen);
+        EVP_MD_CTX_free(ctx);
+        
+        char hex[3];
+        for (unsigned int i = 0; i < mdLen; i++) {
+            snprintf(hex, sizeof(hex), "%02x", md[i]);
+            digest += hex;
+        }
+    }
+#endif
+    
+    SDL_RWclose(in);
+    return digest;
+}
+
+// Splits "algorithm:hex" and throws if the algorithm
+// isn't available in this build
+static void checkHashAlgorithm(const std::string &hash, std::string &algorithm, std::string &expected) {
+    size_t sep = hash.find(':');
+    if (sep == std::string::npos)
+        throw Exception(Exception::ArgumentError, "Invalid hash '%s' (expected algorithm:hex)", hash.c_str());
+    
+    algorithm = hash.substr(0, sep);
+    expected = hash.substr(sep + 1);
+    
+    for (auto &c : algorithm)
+        c = tolower(c);
+    for (auto &c : expected)
+        c = tolower(c);
+
+#ifdef MKXPZ_SSL
+    if (algorithm == "crc32" || algorithm == "sha256")
+        return;
+#else
+    if (algorithm == "crc32")
+        return;
+#endif
+    
+    throw Exception(Exception::ArgumentError, "Unsupported hash algorithm '%s'", algorithm.c_str());
+}
+
+static uint64_t partialSize(const std::string &path) {
+    SDL_RWops *in = SDL_RWFromFile(path.c_str(), "rb");
+    if (!in)
+        return 0;
+    
+    Sint64 size = SDL_RWsize(in);
+    SDL_RWclose(in);
+    
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+HTTPResponse HTTPRequest::download(const char *path, const char *hash, DownloadProgress progress) {
+    HTTPResponse ret;
+    auto target = readURL(destination.c_str());
+    
+    std::string algorithm, expected;
+    if (hash)
+        checkHashAlgorithm(hash, algorithm, expected);
+    
+    std::string partPath = std::string(path) + ".part";
+    uint64_t existing = partialSize(partPath);
+    
+    httplib::Client *client = nullptr;
+    try {
+        client = new httplib::Client(getHost(target).c_str());
+    }
+    catch (std::exception &e) {
+        delete client;
+        throw Exception(Exception::MKXPError, "Failed to create HTTP client (%s)", e.what());
+    }
+    
+    httplib::Headers head;
+    
+    // Seems to need to be disabled for now, at least on macOS
+#ifdef MKXPZ_SSL
+    client->enable_server_certificate_verification(false);
+#endif
+    client->set_follow_location(follow_location);
+    
+    for (auto const &h : _headers)
+        head.emplace(h.first, h.second);
+    
+    if (existing > 0)
+        head.emplace("Range", "bytes=" + std::to_string(existing) + "-");
+    
+    SDL_RWops *out = nullptr;
+    uint64_t current = 0, total = 0;
+    std::string contentRange;
+    bool writeFailed = false, aborted = false;
+    
+    auto onResponse = [&](const httplib::Response &response) {
+        ret._status = response.status;
+        
+        for (auto const &h : response.headers)
+            ret._headers.emplace(h.first, h.second);
+        
+        contentRange = response.get_header_value("Content-Range");
+        
+        // Anything but a success leaves the partial file alone
+        if (response.status < 200 || response.status >= 300)
+            return true;
+        
+        // A server that ignores the Range header sends everything
+        if (response.status == 206) {
+            current = existing;
+            out = SDL_RWFromFile(partPath.c_str(), "ab");
+        }
+        else {
+            current = 0;
+            out = SDL_RWFromFile(partPath.c_str(), "wb");
+        }
+        
+        if (!out) {
+            writeFailed = true;
+            return false;
+        }
+        
+        std::string length = response.get_header_value("Content-Length");
+        if (!length.empty())
+            total = current + strtoull(length.c_str(), nullptr, 10);
+        
+        return true;
+    };
+    
+    auto onContent = [&](const char *data, size_t len) {
+        if (!out)
+            return true;
+        
+        if (SDL_RWwrite(out, data, 1, len) != len) {
+            writeFailed = true;
+            return false;
+        }
+        
+        current += len;
+        
+        if (progress && !progress(current, total)) {
+            aborted = true;
+            return false;
+        }
+        
+        return true;
+    };
+    
+    auto result = client->Get(getPath(target).c_str(), head, onResponse, onContent);
+    
+    if (out && SDL_RWclose(out) != 0)
+        writeFailed = true;
+    
+    delete client;
+    
+    if (writeFailed)
+        throw Exception(Exception::IOError, "Failed to write %s", partPath.c_str());
+    
+    if (aborted)
+        throw Exception(Exception::MKXPError, "Download of %s aborted", destination.c_str());
+    
+    if (!result) {
+        auto err = result.error();
+        std::string errname = httplib::to_string(err);
+        throw Exception(Exception::MKXPError, "Failed to GET %s (%i: %s)", destination.c_str(), err, errname.c_str());
+    }
+    
+    // The partial file already held everything there is, as long as
+    // the server's "bytes */<size>" says the file is that large
+    bool complete = false;
+    if (ret._status == 416 && existing > 0) {
+        size_t sep = contentRange.rfind('/');
+        uint64_t size = 0;
+        
+        if (sep != std::string::npos)
+            size = strtoull(contentRange.c_str() + sep + 1, nullptr, 10);
+        
+        if (size != existing) {
+            // Left over from a file that has changed since
+            if (!mkxp_fs::removeFile(partPath.c_str()))
+                throw Exception(Exception::IOError, "Failed to remove %s", partPath.c_str());
+            
+            return download(path, hash, progress);
+        }
+        
+        complete = true;
+        ret._status = 200;
+    }
+    
+    if (!out && !complete)
+        return ret;
+    
+    if (hash && hashFile(partPath, algorithm) != expected) {
+        // Starting over beats resuming a corrupt file
+        mkxp_fs::removeFile(partPath.c_str());
+        throw Exception(Exception::MKXPError, "Hash mismatch for %s", destination.c_str());
+    }
+    
+    // Only a completely verified file ever becomes visible under
+    // the final name, replacing any older one in a single step
+    if (!mkxp_fs::renameFile(partPath.c_str(), path))
+        throw Exception(Exception::IOError, "Failed to move download to %s", path);
+    
+    return ret;
+}
+
+namespace mkxp_net {
+
+struct HTTPAsyncJob {
+    enum Method {
+        Get,
+        Post,
+        PostBody
+    };
+    
+    int id;
+    Method method;
+    
+    std::string destination;
+    bool followLocation;
+    StringMap headers;
+    
+    StringMap postData;
+    std::string body;
+    std::string contentType;
+    
+    int timeout;
+};
+
+typedef std::unordered_map<std::string, std::shared_ptr<httplib::Client>> HTTPClientMap;
+
+struct HTTPAsyncPoolPrivate {
+    std::deque<HTTPAsyncJob> jobs;
+    std::deque<HTTPAsyncPool::Result> finished;
+    
+    // Requests a worker is busy with, along with the client
+    // sending them (null until it's picked), and the ids of
+    // those whose results should be thrown away
+    std::unordered_map<int, std::shared_ptr<httplib::Client>> running;
+    std::unordered_set<int> canceled;
+    
+    int nextId;
+    
+    std::vector<SDL_Thread*> workers;
+    int idleWorkers;
+    
+    SDL_mutex *mut;
+    SDL_cond *cond;
+    
+    AtomicFlag termReq;
+    
+    HTTPAsyncPoolPrivate() :
+        nextId(0),
+        idleWorkers(0)
+    {
+        mut = SDL_CreateMutex();
+        cond = SDL_CreateCond();
+    }
+    
+    ~HTTPAsyncPoolPrivate() {
+        SDL_LockMutex(mut);
+        termReq.set();
+        SDL_CondBroadcast(cond);
+        
+        for (auto &r : running)
+            stopClient(r.second);
+        
+        SDL_UnlockMutex(mut);
+        
+        for (size_t i = 0; i < workers.size(); ++i)
+            SDL_WaitThread(workers[i], 0);
+        
+        SDL_DestroyCond(cond);
+        SDL_DestroyMutex(mut);
+    }
+    
+    int queue(HTTPAsyncJob &job) {
+        SDL_LockMutex(mut);
+        
+        // Workers are only started once every
+        // existing one already has something to do
+        if (jobs.size() >= (size_t)idleWorkers && workers.size() < HTTP_ASYNC_WORKERS)
+            workers.push_back(createSDLThread
+                <HTTPAsyncPoolPrivate, &HTTPAsyncPoolPrivate::run>(this, "http_worker"));
+        
+        job.id = nextId++;
+        jobs.push_back(job);
+        SDL_CondSignal(cond);
+        
+        SDL_UnlockMutex(mut);
+        
+        return job.id;
+    }
+    
+    // Makes a request in flight fail right away. Called with 'mut'
+    // held, so the worker can't move on to its next request meanwhile
+    static void stopClient(const std::shared_ptr<httplib::Client> &client) {
+        if (client)
+            client->stop();
+    }
+    
+    bool isCanceled(int id) {
+        SDL_LockMutex(mut);
+        bool ret = termReq || canceled.count(id);
+        SDL_UnlockMutex(mut);
+        
+        return ret;
+    }
+    
+    void perform(const HTTPAsyncJob &job, HTTPAsyncPool::Result &result, HTTPClientMap &clients) {
+        result.id = job.id;
+        
+        const char *methodName = (job.method == HTTPAsyncJob::Get) ? "GET" : "POST";
+        
+        try {
+            auto target = readURL(job.destination.c_str());
+            std::string host = getHost(target);
+            
+            std::shared_ptr<httplib::Client> &client = clients[host];
+            
+            if (!client) {
+                client.reset(new httplib::Client(host.c_str()));
+                client->set_keep_alive(true);
+                
+                // Seems to need to be disabled for now, at least on macOS
+#ifdef MKXPZ_SSL
+                client->enable_server_certificate_verification(false);
+#endif
+            }
+            
+            client->set_follow_location(job.followLocation);
+            
+            if (job.timeout > 0) {
+                client->set_connection_timeout(std::min(job.timeout, HTTP_ASYNC_CONNECT_TIMEOUT));
+                client->set_read_timeout(job.timeout);
+                client->set_write_timeout(job.timeout);
+            }
+            else {
+                client->set_connection_timeout(HTTP_ASYNC_CONNECT_TIMEOUT);
+                client->set_read_timeout(CPPHTTPLIB_READ_TIMEOUT_SECOND);
+                client->set_write_timeout(CPPHTTPLIB_WRITE_TIMEOUT_SECOND);
+            }
+            
+            httplib::Request req;
+            req.method = methodName;
+            req.path = getPath(target);
+            
+            for (auto const &h : job.headers)
+                req.headers.emplace(h.first, h.second);
+            
+            switch (job.method) {
+                case HTTPAsyncJob::Post: {
+                    httplib::Params params;
+                    for (auto const &p : job.postData)
+                        params.emplace(p.first, p.second);
+                    
+                    req.body = httplib::detail::params_to_query_str(params);
+                    req.set_header("Content-Type", "application/x-www-form-urlencoded");
+                    break;
+                }
+                case HTTPAsyncJob::PostBody:
+                    req.body = job.body;
+                    req.set_header("Content-Type", job.contentType);
+                    break;
+                    
+                case HTTPAsyncJob::Get:
+                default:
+                    break;
+            }
+            
+            // Returning false aborts the transfer
+            int id = job.id;
+            req.progress = [this, id](uint64_t, uint64_t) {
+                return !isCanceled(id);
+            };
+            
+            // From here on, cancel() can stop the client. A request
+            // canceled before that isn't sent at all
+            SDL_LockMutex(mut);
+            running[id] = client;
+            SDL_UnlockMutex(mut);
+            
+            if (isCanceled(id))
+                return;
+            
+            if (auto response = client->send(req)) {
+                result.response._status = response->status;
+                result.response._body = response->body;
+                
+                for (auto const &h : response->headers)
+                    result.response._headers.emplace(h.first, h.second);
+            }
+            else {
+                auto err = response.error();
+                std::string errname = httplib::to_string(err);
+                
+                // Don't reuse a connection that just failed
+                clients.erase(host);
+                
+                throw Exception(Exception::MKXPError, "Failed to %s %s (%i: %s)",
+                                methodName, job.destination.c_str(), err, errname.c_str());
+            }
+        }
+        catch (const Exception &e) {
+            result.error = e.msg;
+        }
+        catch (std::exception &e) {
+            result.error = std::string("Failed to create HTTP client (") + e.what() + ")";
+        }
+    }
+    
+    // thread func
+    void run() {
+        // Connections are kept per worker, as a
+        // client can only serve one request at a time
+        HTTPClientMap clients;
+        
+        SDL_LockMutex(mut);
+        
+        while (!termReq) {
+            if (jobs.empty()) {
+                idleWorkers++;
+                SDL_CondWait(cond, mut);
+                idleWorkers--;
+                continue;
+            }
+            
+            HTTPAsyncJob job = jobs.front();
+            jobs.pop_front();
+            running[job.id] = nullptr;
+            
+            SDL_UnlockMutex(mut);
+            
+            HTTPAsyncPool::Result result;
+            perform(job, result, clients);
+            
+            SDL_LockMutex(mut);
+            
+            running.erase(job.id);
+            
+            if (canceled.erase(job.id) == 0)
+                finished.push_back(result);
+        }
+        
+        SDL_UnlockMutex(mut);
+    }
+};
+
+HTTPAsyncPool::HTTPAsyncPool() {
+    p = new HTTPAsyncPoolPrivate();
+}
+
+HTTPAsyncPool::~HTTPAsyncPool() {
+    delete p;
+}
+
+static void fillAsyncJob(HTTPAsyncJob &job, HTTPAsyncJob::Method method,
+                         const std::string &destination, bool followLocation,
+                         StringMap &headers, int timeout) {
+    job.method = method;
+    job.destination = destination;
+    job.followLocation = followLocation;
+    job.headers = headers;
+    job.timeout = timeout;
+}
+
+int HTTPAsyncPool::get(HTTPRequest &req, int timeout) {
+    HTTPAsyncJob job;
+    fillAsyncJob(job, HTTPAsyncJob::Get, req.destination, req.follow_location, req.headers(), timeout);
+    
+    return p->queue(job);
+}
+
+int HTTPAsyncPool::post(HTTPRequest &req, StringMap &postData, int timeout) {
+    HTTPAsyncJob job;
+    fillAsyncJob(job, HTTPAsyncJob::Post, req.destination, req.follow_location, req.headers(), timeout);
+    job.postData = postData;
+    
+    return p->queue(job);
+}
+
+int HTTPAsyncPool::post(HTTPRequest &req, const char *body, const char *content_type, int timeout) {
+    HTTPAsyncJob job;
+    fillAsyncJob(job, HTTPAsyncJob::PostBody, req.destination, req.follow_location, req.headers(), timeout);
+    job.body = body;
+    job.contentType = content_type;
+    
+    return p->queue(job);
+}
+
+bool HTTPAsyncPool::cancel(int id) {
+    SDL_LockMutex(p->mut);
+    
+    bool found = false;
+    
+    for (auto it = p->jobs.begin(); it != p->jobs.end(); ++it) {
+        if (it->id == id) {
+            p->jobs.erase(it);
+            found = true;
+            break;
+        }
+    }
+    
+    auto run = p->running.find(id);
+    
+    if (!found && run != p->running.end()) {
+        p->canceled.insert(id);
+        HTTPAsyncPoolPrivate::stopClient(run->second);
+        found = true;
+    }
+    
+    SDL_UnlockMutex(p->mut);
+    
+    return found;
+}
+
+bool HTTPAsyncPool::takeFinished(Result &out) {
+    SDL_LockMutex(p->mut);
+    
+    bool found = !p->finished.empty();
+    
+    if (found) {
+        out = p->finished.front();
+        p->finished.pop_front();
+    }
+    
+    SDL_UnlockMutex(p->mut);
+    
+    return found;
+}
+
+void HTTPAsyncPool::clear() {
+    SDL_LockMutex(p->mut);
+    
+    p->jobs.clear();
+    p->finished.clear();
+    for (auto &r : p->running) {
+        p->canceled.insert(r.first);
+        HTTPAsyncPoolPrivate::stopClient(r.second);
+    }
+    
+    SDL_UnlockMutex(p->mut);
+}
+}
@@ -10,25 +10,32 @@
 
 #include <unordered_map>
 #include <string>
+#include <functional>
+#include <cstdint>
 
 namespace mkxp_net {
 
 typedef std::unordered_map<std::string, std::string> StringMap;
 
+// Called as the body of a download arrives. 'total' is 0
+// if the server didn't say. Returning false aborts it
+typedef std::function<bool(uint64_t current, uint64_t total)> DownloadProgress;
+
 class HTTPResponse {
 public:
     int status();
     std::string &body();
     StringMap &headers();
+    HTTPResponse();
     ~HTTPResponse();
     
 private:
     int _status;
     std::string _body;
     StringMap _headers;
-    HTTPResponse();
     
     friend class HTTPRequest;
+    friend struct HTTPAsyncPoolPrivate;
 };
 
 class HTTPRequest {
@@ -43,9 +50,62 @@ public:
     HTTPResponse get();
     HTTPResponse post(StringMap &postData);
     HTTPResponse post(const char *body, const char *content_type);
+    
+    // Streams the body into 'path' with constant memory use. It is
+    // written to 'path'.part first, which a later call resumes with
+    // a Range request, and only renamed to 'path' once complete and,
+    // if 'hash' ("crc32:<hex>" or "sha256:<hex>") is given, verified.
+    // On a non-2xx status nothing is written. The returned body is
+    // always empty
+    HTTPResponse download(const char *path, const char *hash, DownloadProgress progress);
 private:
     StringMap _headers;
     bool follow_location;
+    
+    friend class HTTPAsyncPool;
+};
+
+struct HTTPAsyncPoolPrivate;
+
+// Runs requests on a small pool of worker threads. Each worker
+// keeps a keep-alive connection per host, so repeated calls to
+// the same server skip the TCP and TLS handshakes.
+class HTTPAsyncPool {
+public:
+    struct Result {
+        int id;
+        HTTPResponse response;
+        
+        // Empty on success
+        std::string error;
+    };
+    
+    HTTPAsyncPool();
+    ~HTTPAsyncPool();
+    
+    // Each of these queues the request and returns the id its
+    // result will be reported under. 'timeout' is in seconds and
+    // applies to connecting, sending and every read; 0 keeps the
+    // httplib defaults, except that connecting never takes longer
+    // than HTTP_ASYNC_CONNECT_TIMEOUT
+    int get(HTTPRequest &req, int timeout);
+    int post(HTTPRequest &req, StringMap &postData, int timeout);
+    int post(HTTPRequest &req, const char *body, const char *content_type, int timeout);
+    
+    // Drops a queued request, or aborts a running one by shutting
+    // down its connection. Either way its result is never reported.
+    // Returns false if it was not pending
+    bool cancel(int id);
+    
+    // Moves the oldest finished request into 'out'.
+    // Returns false if nothing has finished
+    bool takeFinished(Result &out);
+    
+    // Cancels every pending request
+    void clear();
+    
+private:
+    HTTPAsyncPoolPrivate *p;
 };
 }
 
@@ -37,6 +37,9 @@
 #include "binding.h"
 #include "exception.h"
 #include "sharedmidistate.h"
+#include "bitmaploader.h"
+#include "tween.h"
+#include "net.h"
 
 #include <unistd.h>
 #include <stdio.h>
@@ -78,6 +81,10 @@ struct SharedStatePrivate
 	Input input;
 	Audio audio;
 
+	BitmapLoader bitmapLoader;
+	TweenScheduler tweens;
+	mkxp_net::HTTPAsyncPool httpPool;
+
 	GLState _glState;
 
 	ShaderSet shaders;
@@ -243,6 +250,9 @@ GSATT(TexPool&, texPool)
 GSATT(Quad&, gpQuad)
 GSATT(SharedFontState&, fontState)
 GSATT(SharedMidiState&, midiState)
+GSATT(BitmapLoader&, bitmapLoader)
+GSATT(TweenScheduler&, tweens)
+GSATT(mkxp_net::HTTPAsyncPool&, httpPool)
 
 void SharedState::setBindingData(void *data)
 {
@@ -50,6 +50,10 @@ struct GlobalIBO;
 struct Config;
 struct Vec2i;
 struct SharedMidiState;
+struct BitmapLoader;
+class TweenScheduler;
+
+namespace mkxp_net { class HTTPAsyncPool; }
 
 struct SharedState
 {
@@ -80,6 +84,9 @@ struct SharedState
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
 	SharedMidiState &midiState() const;
+	BitmapLoader &bitmapLoader() const;
+	TweenScheduler &tweens() const;
+	mkxp_net::HTTPAsyncPool &httpPool() const;
 
 	sigslot::signal<> prepareDraw;
 
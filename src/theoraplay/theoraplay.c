@@ -130,6 +130,9 @@ typedef struct TheoraDecoder
 
     AudioPacket *audiolist;
     AudioPacket *audiolisttail;
+
+    THEORAPLAY_NotifyFn notify;
+    void *notifydata;
 } TheoraDecoder;
 
 
@@ -196,6 +199,21 @@ static inline void Mutex_Unlock(THEORAPLAY_MUTEX_T mutex)
 #endif
 
 
+static void NotifyProgress(TheoraDecoder *ctx)
+{
+    THEORAPLAY_NotifyFn notify;
+    void *notifydata;
+
+    Mutex_Lock(ctx->lock);
+    notify = ctx->notify;
+    notifydata = ctx->notifydata;
+    Mutex_Unlock(ctx->lock);
+
+    if (notify)
+        notify(notifydata);
+} // NotifyProgress
+
+
 static int FeedMoreOggData(THEORAPLAY_Io *io, ogg_sync_state *sync)
 {
     long buflen = 4096;
@@ -380,6 +398,7 @@ static void WorkerThread(TheoraDecoder *ctx)
     ctx->hasvideo = (tpackets != 0);
     ctx->hasaudio = (vpackets != 0);
     Mutex_Unlock(ctx->lock);
+    NotifyProgress(ctx);
 
     while (!ctx->halt && !eos)
     {
@@ -438,6 +457,7 @@ static void WorkerThread(TheoraDecoder *ctx)
                 } // else
                 ctx->audiolisttail = item;
                 Mutex_Unlock(ctx->lock);
+                NotifyProgress(ctx);
             } // if
 
             else  // no audio available left in current packet?
@@ -508,6 +528,7 @@ static void WorkerThread(TheoraDecoder *ctx)
                         ctx->videolisttail = item;
                         ctx->videocount++;
                         Mutex_Unlock(ctx->lock);
+                        NotifyProgress(ctx);
 
                         saw_video_frame = 1;
                     } // if
@@ -564,6 +585,7 @@ cleanup:
     ogg_sync_clear(&sync);
     ctx->io->close(ctx->io);
     ctx->thread_done = 1;
+    NotifyProgress(ctx);
 } // WorkerThread
 
 
@@ -696,6 +718,20 @@ void THEORAPLAY_stopDecode(THEORAPLAY_Decoder *decoder)
 } // THEORAPLAY_stopDecode
 
 
+void THEORAPLAY_setNotify(THEORAPLAY_Decoder *decoder,
+                          THEORAPLAY_NotifyFn notify, void *userdata)
+{
+    TheoraDecoder *ctx = (TheoraDecoder *) decoder;
+    if (!ctx)
+        return;
+
+    Mutex_Lock(ctx->lock);
+    ctx->notify = notify;
+    ctx->notifydata = userdata;
+    Mutex_Unlock(ctx->lock);
+} // THEORAPLAY_setNotify
+
+
 int THEORAPLAY_isDecoding(THEORAPLAY_Decoder *decoder)
 {
     TheoraDecoder *ctx = (TheoraDecoder *) decoder;
@@ -61,6 +61,13 @@ THEORAPLAY_Decoder *THEORAPLAY_startDecode(THEORAPLAY_Io *io,
                                            THEORAPLAY_VideoFormat vidfmt);
 void THEORAPLAY_stopDecode(THEORAPLAY_Decoder *decoder);
 
+/* Called on the decoder thread whenever it made progress: finished
+ *  initializing, queued a video frame or audio packet, or stopped.
+ *  Must not call back into the decoder. */
+typedef void (*THEORAPLAY_NotifyFn)(void *userdata);
+void THEORAPLAY_setNotify(THEORAPLAY_Decoder *decoder,
+                          THEORAPLAY_NotifyFn notify, void *userdata);
+
 int THEORAPLAY_isDecoding(THEORAPLAY_Decoder *decoder);
 int THEORAPLAY_decodingError(THEORAPLAY_Decoder *decoder);
 int THEORAPLAY_isInitialized(THEORAPLAY_Decoder *decoder);
@@ -0,0 +1,72 @@
+# Microbenchmark for the overhead of calling bound methods.
+# License GPLv2+.
+#
+# Run the suite via the "customScript" field in mkxp.json.
+# Compare the numbers between builds to see how changes to the
+# argument parsing in binding/ affect per-call cost.
+#
+# The MiniFFI functions are trivial, so their numbers are dominated
+# by argument conversion and, unless nogvl: false is passed,
+# releasing and reacquiring the GVL.
+
+ITERATIONS = 1_000_000
+
+def bench(desc)
+	t0 = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	i = 0
+	while i < ITERATIONS
+		yield
+		i += 1
+	end
+	t1 = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+
+	ns = (t1 - t0) * 1_000_000_000 / ITERATIONS
+	System::puts(format("%-36s %8.1f ns/call", desc, ns))
+end
+
+src = Bitmap.new(32, 32)
+dst = Bitmap.new(64, 64)
+rect = Rect.new(0, 0, 32, 32)
+color = Color.new(255, 0, 0)
+spr = Sprite.new
+spr.bitmap = dst
+
+if System.is_windows?
+	noargs = ["kernel32", "GetTickCount", "", "L"]
+	onearg = ["user32", "GetAsyncKeyState", "I", "I"]
+elsif System.is_mac?
+	noargs = ["libSystem.B.dylib", "getpid", "", "I"]
+	onearg = ["libSystem.B.dylib", "abs", "I", "I"]
+else
+	noargs = ["libc.so.6", "getpid", "", "I"]
+	onearg = ["libc.so.6", "abs", "I", "I"]
+end
+
+noargs_release = MiniFFI.new(*noargs)
+noargs_keep    = MiniFFI.new(*noargs, nogvl: false)
+onearg_release = MiniFFI.new(*onearg)
+onearg_keep    = MiniFFI.new(*onearg, nogvl: false)
+
+# Baseline: an empty block, to subtract loop overhead
+bench("(empty loop)")                 { }
+
+bench("Sprite#x=")                    { spr.x = 10 }
+bench("Sprite#zoom_x= (float)")       { spr.zoom_x = 1.5 }
+bench("Sprite#visible=")              { spr.visible = true }
+bench("Sprite#z=")                    { spr.z = 5 }
+bench("Color#set")                    { color.set(10, 20, 30) }
+bench("Rect#set")                     { rect.set(0, 0, 32, 32) }
+bench("Rect.new")                     { Rect.new(0, 0, 1, 1) }
+bench("Bitmap#get_pixel")             { dst.get_pixel(1, 1) }
+bench("Bitmap#set_pixel")             { dst.set_pixel(1, 1, color) }
+bench("Bitmap#blt")                   { dst.blt(0, 0, src, rect) }
+bench("Bitmap#blt (opacity)")         { dst.blt(0, 0, src, rect, 128) }
+bench("Input.press?")                 { Input.press?(Input::C) }
+bench("Input.trigger?")               { Input.trigger?(Input::C) }
+bench("MiniFFI #{noargs[1]}()")       { noargs_release.call }
+bench("MiniFFI #{noargs[1]}() keep")  { noargs_keep.call }
+bench("MiniFFI #{onearg[1]}(1)")      { onearg_release.call(1) }
+bench("MiniFFI #{onearg[1]}(1) keep") { onearg_keep.call(1) }
+
+System::puts("Finished")
+exit
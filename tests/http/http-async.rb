@@ -0,0 +1,69 @@
+# Test suite for the asynchronous HTTPLite calls.
+# License GPLv2+.
+#
+# Serve this directory on the loopback interface first:
+#   python3 -m http.server 8000 --bind 127.0.0.1
+# then run the suite via the "customScript" field in mkxp.json.
+
+BASE = "http://127.0.0.1:8000"
+
+results = {}
+pending = 0
+
+def check(desc, ok)
+  System::puts((ok ? "PASS " : "FAIL ") + desc)
+end
+
+# Several requests to the same host share the pool's
+# keep-alive connections
+4.times do |i|
+  pending += 1
+  HTTPLite.get_async("#{BASE}/http-async.rb") do |res, error|
+    results["get #{i}"] = res ? res[:status] : error
+    pending -= 1
+  end
+end
+
+pending += 1
+HTTPLite.get_async("#{BASE}/does-not-exist") do |res, error|
+  results["404"] = res ? res[:status] : error
+  pending -= 1
+end
+
+pending += 1
+HTTPLite.post_body_async("#{BASE}/", "{}", "application/json") do |res, error|
+  # http.server only implements GET, so any status means the POST went out
+  results["post_body"] = res ? res[:status] : error
+  pending -= 1
+end
+
+# Unroutable address, so only the timeout can end this
+pending += 1
+t0 = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+HTTPLite.get_async("http://10.255.255.1/", timeout: 1) do |res, error|
+  results["timeout"] = error
+  results["timeout secs"] = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t0
+  pending -= 1
+end
+
+canceled_called = false
+id = HTTPLite.get_async("#{BASE}/http-async.rb") { canceled_called = true }
+check("cancel returns true while pending", HTTPLite.cancel(id))
+check("cancel returns false afterwards", !HTTPLite.cancel(id))
+
+frames = 0
+while pending > 0 && frames < 600
+  Graphics.update
+  frames += 1
+end
+
+check("all callbacks delivered within 10s", pending == 0)
+4.times { |i| check("GET #{i} is 200", results["get #{i}"] == 200) }
+check("missing file is 404", results["404"] == 404)
+check("POST got a response", results["post_body"].is_a?(Integer))
+check("timeout reports an error", results["timeout"].is_a?(String))
+check("timeout honors the limit", results["timeout secs"].to_f < 3)
+check("canceled block never called", !canceled_called)
+
+System::puts("Finished")
+exit
@@ -0,0 +1,55 @@
+# Test suite for HTTPLite.download.
+# License GPLv2+.
+#
+# Serve this directory on the loopback interface first:
+#   python3 -m http.server 8000 --bind 127.0.0.1
+# then run the suite via the "customScript" field in mkxp.json.
+
+BASE = "http://127.0.0.1:8000"
+URL = "#{BASE}/http-download.rb"
+
+def check(desc, ok)
+  System::puts((ok ? "PASS " : "FAIL ") + desc)
+end
+
+expected = HTTPLite.get(URL)[:body]
+crc = format("crc32:%08x", Zlib.crc32(expected))
+
+# Plain download with progress reports
+reports = []
+res = HTTPLite.download(URL, "download-test.rb") { |cur, total| reports << [cur, total] }
+path = res[:path]
+check("status is 200", res[:status] == 200)
+check("file matches body", File.binread(path) == expected)
+check("progress reached the total", reports.last == [expected.bytesize, expected.bytesize])
+check("no partial file left", !File.exist?(path + ".part"))
+
+# Resume from a partial file. http.server ignores Range
+# requests, so this also covers a full re-send
+File.delete(path)
+File.binwrite(path + ".part", expected[0, 100])
+res = HTTPLite.download(URL, "download-test.rb", hash: crc)
+check("resumed file matches body", File.binread(path) == expected)
+
+# A bad hash leaves nothing behind
+File.delete(path)
+begin
+  HTTPLite.download(URL, "download-test.rb", hash: "crc32:00000000")
+  check("bad hash raises", false)
+rescue MKXPError
+  check("bad hash raises", true)
+end
+check("bad hash writes no file", !File.exist?(path) && !File.exist?(path + ".part"))
+
+# Errors leave nothing behind either
+res = HTTPLite.download("#{BASE}/does-not-exist", "download-test.rb")
+check("404 is reported", res[:status] == 404)
+check("404 writes no file", !File.exist?(path) && !File.exist?(path + ".part"))
+
+# Breaking out of the progress block aborts
+HTTPLite.download(URL, "download-test.rb") { break }
+check("break keeps the partial file", !File.exist?(path))
+File.delete(path + ".part") if File.exist?(path + ".part")
+
+System::puts("Finished")
+exit